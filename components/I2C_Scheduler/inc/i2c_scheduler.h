@@ -0,0 +1,110 @@
+#ifndef I2C_SCHEDULER_H
+#define I2C_SCHEDULER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_err.h"
+#include "driver/i2c_master.h"
+
+// All I2C traffic goes through one scheduler task. Transactions wait in one queue
+// per class and the highest class with work is always served first. Transfers of
+// a lower class that are marked I2C_SCHED_FLAG_CHUNK_ROWS are sent one row per bus
+// transaction, so higher classes get the bus between rows.
+
+// Priority classes, lower value is served first
+typedef enum {
+    I2C_SCHED_CLASS_IMU = 0,    // Motion data, fall detection latency depends on it
+    I2C_SCHED_CLASS_ENV,        // Environmental sensor
+    I2C_SCHED_CLASS_DISPLAY,    // Display frames
+    I2C_SCHED_CLASS_COUNT
+} i2c_sched_class_t;
+
+// Every row is its own bus transaction with head sent again in front of it.
+// For devices that keep their own write pointer between transactions (SSD1306 GDDRAM).
+#define I2C_SCHED_FLAG_CHUNK_ROWS   (1 << 0)
+
+// Maximum rows of one transfer
+#define I2C_SCHED_MAX_ROWS          8
+
+#ifndef I2C_SCHED_QUEUE_LEN
+#define I2C_SCHED_QUEUE_LEN         8       // Pending transfers per class
+#endif
+
+#ifndef I2C_SCHED_TIMEOUT_MS
+#define I2C_SCHED_TIMEOUT_MS        100     // Timeout of one bus transaction
+#endif
+
+typedef struct i2c_sched_txn i2c_sched_txn_t;
+
+// Called from scheduler task when transfer is finished, must not block
+typedef void (*i2c_sched_done_cb_t)(i2c_sched_txn_t *txn, void *arg);
+
+// Transfer descriptor. It is owned by scheduler from submit until completion,
+// buffers must stay valid for the same time.
+//   write:       head, then rows of data
+//   write-read:  head, repeated START, rx_len bytes into rx (data must be NULL)
+struct i2c_sched_txn {
+    i2c_master_dev_handle_t dev;
+    i2c_sched_class_t cls;
+    uint32_t flags;
+
+    const uint8_t *head;        // Register address or control byte, sent first
+    size_t head_len;
+
+    const uint8_t *data;        // Payload, rows x width bytes, stride bytes apart
+    uint16_t width;
+    uint8_t rows;
+    uint16_t stride;
+
+    uint8_t *rx;
+    size_t rx_len;
+
+    i2c_sched_done_cb_t done_cb;    // Optional completion callback
+    void *done_arg;
+    TaskHandle_t notify_task;       // Optional, gets xTaskNotifyGive() on completion
+
+    // Filled in by scheduler
+    esp_err_t result;
+    int64_t submit_us;
+    uint8_t next_row;
+};
+
+// Latency statistics of one class, times in microseconds
+typedef struct {
+    uint32_t count;             // Completed transfers
+    uint32_t errors;            // Transfers which ended with error
+    uint32_t chunks;            // Bus transactions issued
+    uint32_t preemptions;       // Times a chunked transfer yielded to higher class
+    uint64_t wait_sum_us;       // Submit to first byte on bus
+    uint32_t wait_max_us;
+    uint64_t latency_sum_us;    // Submit to completion
+    uint32_t latency_max_us;
+} i2c_sched_stats_t;
+
+// Starts scheduler task
+esp_err_t i2c_sched_init(UBaseType_t priority, BaseType_t core);
+
+// Queues transfer, completion is signalled through done_cb/notify_task
+esp_err_t i2c_sched_submit(i2c_sched_txn_t *txn, TickType_t wait);
+
+// Queues transfer and blocks until it is finished, returns its result.
+// Uses its own completion signal, done_cb and notify_task of txn are overwritten.
+esp_err_t i2c_sched_transfer(i2c_sched_txn_t *txn);
+
+// Register helpers on top of i2c_sched_transfer
+esp_err_t i2c_sched_write(i2c_master_dev_handle_t dev, i2c_sched_class_t cls, const uint8_t *buf, size_t len);
+esp_err_t i2c_sched_write_read(i2c_master_dev_handle_t dev, i2c_sched_class_t cls,
+                               const uint8_t *tx, size_t tx_len, uint8_t *rx, size_t rx_len);
+
+// Copies statistics of one class
+void i2c_sched_get_stats(i2c_sched_class_t cls, i2c_sched_stats_t *out);
+
+// Clears statistics of all classes
+void i2c_sched_reset_stats(void);
+
+// Logs one line per class with average and maximum latency
+void i2c_sched_log_stats(void);
+
+#endif // I2C_SCHEDULER_H
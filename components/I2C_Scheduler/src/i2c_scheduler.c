@@ -0,0 +1,303 @@
+#include "i2c_scheduler.h"
+#include <string.h>
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "esp_pm.h"
+
+static const char *TAG = "I2C_SCHED";
+
+static const char *const s_class_names[I2C_SCHED_CLASS_COUNT] = {"imu", "env", "display"};
+
+static TaskHandle_t s_task;
+static QueueHandle_t s_queue[I2C_SCHED_CLASS_COUNT];
+static i2c_sched_txn_t *s_active[I2C_SCHED_CLASS_COUNT];   // Started but unfinished transfer per class
+
+// Held while any queue has work, so no light sleep or APB change cuts a burst
+static esp_pm_lock_handle_t s_pm_lock;
+
+static i2c_sched_stats_t s_stats[I2C_SCHED_CLASS_COUNT];
+static portMUX_TYPE s_stats_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// Highest class with work, chunked transfer that already started keeps its class slot
+static i2c_sched_txn_t *pick_next(void)
+{
+    i2c_sched_txn_t *txn;
+    int cls, lower;
+
+    for (cls = 0; cls < I2C_SCHED_CLASS_COUNT; cls++) {
+        txn = s_active[cls];
+        if (txn == NULL) {
+            if (xQueueReceive(s_queue[cls], &txn, 0) != pdTRUE) {
+                continue;
+            }
+            s_active[cls] = txn;
+        }
+
+        // Count lower class transfers that are left half sent for this one
+        for (lower = cls + 1; lower < I2C_SCHED_CLASS_COUNT; lower++) {
+            if (s_active[lower] != NULL && s_active[lower]->next_row > 0) {
+                taskENTER_CRITICAL(&s_stats_lock);
+                s_stats[lower].preemptions++;
+                taskEXIT_CRITICAL(&s_stats_lock);
+            }
+        }
+        return txn;
+    }
+    return NULL;
+}
+
+// Issues one bus transaction of txn, returns true when txn is finished
+static bool run_step(i2c_sched_txn_t *txn)
+{
+    i2c_master_transmit_multi_buffer_info_t buffers[1 + I2C_SCHED_MAX_ROWS];
+    size_t count = 0;
+    uint8_t row, last;
+
+    if (txn->rx != NULL) {
+        txn->result = i2c_master_transmit_receive(txn->dev, txn->head, txn->head_len,
+                                                  txn->rx, txn->rx_len, I2C_SCHED_TIMEOUT_MS);
+        txn->next_row = txn->rows;
+        return true;
+    }
+
+    if (txn->head_len > 0) {
+        buffers[count].write_buffer = (uint8_t *)txn->head;
+        buffers[count].buffer_size = txn->head_len;
+        count++;
+    }
+
+    // Whole payload at once, or only next row when transfer may be split
+    row = txn->next_row;
+    last = (txn->flags & I2C_SCHED_FLAG_CHUNK_ROWS) ? row + 1 : txn->rows;
+    if (txn->data == NULL || last > txn->rows) {
+        last = row;
+    }
+    for (; row < last; row++) {
+        buffers[count].write_buffer = (uint8_t *)&txn->data[row * txn->stride];
+        buffers[count].buffer_size = txn->width;
+        count++;
+    }
+
+    txn->result = i2c_master_multi_buffer_transmit(txn->dev, buffers, count, I2C_SCHED_TIMEOUT_MS);
+    txn->next_row = last;
+
+    return txn->result != ESP_OK || txn->data == NULL || txn->next_row >= txn->rows;
+}
+
+static void complete(i2c_sched_txn_t *txn, int64_t start_us)
+{
+    i2c_sched_stats_t *st = &s_stats[txn->cls];
+    uint32_t latency = (uint32_t)(esp_timer_get_time() - txn->submit_us);
+    uint32_t wait = (uint32_t)(start_us - txn->submit_us);
+    TaskHandle_t notify_task = txn->notify_task;
+    i2c_sched_done_cb_t done_cb = txn->done_cb;
+    void *done_arg = txn->done_arg;
+
+    taskENTER_CRITICAL(&s_stats_lock);
+    st->count++;
+    if (txn->result != ESP_OK) {
+        st->errors++;
+    }
+    st->wait_sum_us += wait;
+    if (wait > st->wait_max_us) {
+        st->wait_max_us = wait;
+    }
+    st->latency_sum_us += latency;
+    if (latency > st->latency_max_us) {
+        st->latency_max_us = latency;
+    }
+    taskEXIT_CRITICAL(&s_stats_lock);
+
+    // Owner may reuse txn as soon as it is signalled, do not touch it after this
+    if (notify_task != NULL) {
+        xTaskNotifyGive(notify_task);
+    }
+    if (done_cb != NULL) {
+        done_cb(txn, done_arg);
+    }
+}
+
+static void i2c_sched_task(void *arg)
+{
+    static int64_t start_us[I2C_SCHED_CLASS_COUNT];
+    i2c_sched_txn_t *txn;
+    bool awake = false;
+
+    for (;;) {
+        txn = pick_next();
+        if (txn == NULL) {
+            if (awake && s_pm_lock != NULL) {
+                esp_pm_lock_release(s_pm_lock);
+            }
+            awake = false;
+            // Every submit gives one notification, so no work is missed
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            continue;
+        }
+        if (!awake && s_pm_lock != NULL) {
+            esp_pm_lock_acquire(s_pm_lock);
+        }
+        awake = true;
+
+        if (txn->next_row == 0) {
+            start_us[txn->cls] = esp_timer_get_time();
+        }
+
+        bool done = run_step(txn);
+
+        taskENTER_CRITICAL(&s_stats_lock);
+        s_stats[txn->cls].chunks++;
+        taskEXIT_CRITICAL(&s_stats_lock);
+
+        if (done) {
+            s_active[txn->cls] = NULL;
+            complete(txn, start_us[txn->cls]);
+        }
+    }
+}
+
+esp_err_t i2c_sched_init(UBaseType_t priority, BaseType_t core)
+{
+    int cls;
+
+    if (s_task != NULL) {
+        return ESP_OK;
+    }
+
+    for (cls = 0; cls < I2C_SCHED_CLASS_COUNT; cls++) {
+        s_queue[cls] = xQueueCreate(I2C_SCHED_QUEUE_LEN, sizeof(i2c_sched_txn_t *));
+        if (s_queue[cls] == NULL) {
+            ESP_LOGE(TAG, "Failed to create %s queue", s_class_names[cls]);
+            return ESP_ERR_NO_MEM;
+        }
+    }
+
+#if CONFIG_PM_ENABLE
+    if (esp_pm_lock_create(ESP_PM_APB_FREQ_MAX, 0, "i2c_sched", &s_pm_lock) != ESP_OK) {
+        ESP_LOGW(TAG, "No PM lock, bursts may run at a lowered APB clock");
+        s_pm_lock = NULL;
+    }
+#endif
+
+    if (xTaskCreatePinnedToCore(i2c_sched_task, "i2c_sched", 3072, NULL, priority, &s_task, core) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create scheduler task");
+        s_task = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t i2c_sched_submit(i2c_sched_txn_t *txn, TickType_t wait)
+{
+    if (s_task == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (txn == NULL || txn->cls >= I2C_SCHED_CLASS_COUNT || txn->rows > I2C_SCHED_MAX_ROWS ||
+        (txn->rx != NULL && txn->data != NULL)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    txn->result = ESP_ERR_TIMEOUT;
+    txn->next_row = 0;
+    txn->submit_us = esp_timer_get_time();
+
+    if (xQueueSend(s_queue[txn->cls], &txn, wait) != pdTRUE) {
+        return ESP_ERR_TIMEOUT;
+    }
+    xTaskNotifyGive(s_task);
+
+    return ESP_OK;
+}
+
+static void transfer_done(i2c_sched_txn_t *txn, void *arg)
+{
+    xSemaphoreGive((SemaphoreHandle_t)arg);
+}
+
+esp_err_t i2c_sched_transfer(i2c_sched_txn_t *txn)
+{
+    StaticSemaphore_t done_buf;
+    SemaphoreHandle_t done = xSemaphoreCreateBinaryStatic(&done_buf);
+    esp_err_t err;
+
+    txn->notify_task = NULL;
+    txn->done_cb = transfer_done;
+    txn->done_arg = done;
+
+    err = i2c_sched_submit(txn, portMAX_DELAY);
+    if (err == ESP_OK) {
+        // Every bus transaction has its own timeout, so this always returns
+        xSemaphoreTake(done, portMAX_DELAY);
+        err = txn->result;
+    }
+
+    vSemaphoreDelete(done);
+    return err;
+}
+
+esp_err_t i2c_sched_write(i2c_master_dev_handle_t dev, i2c_sched_class_t cls, const uint8_t *buf, size_t len)
+{
+    i2c_sched_txn_t txn = {
+        .dev = dev,
+        .cls = cls,
+        .head = buf,
+        .head_len = len,
+    };
+
+    return i2c_sched_transfer(&txn);
+}
+
+esp_err_t i2c_sched_write_read(i2c_master_dev_handle_t dev, i2c_sched_class_t cls,
+                               const uint8_t *tx, size_t tx_len, uint8_t *rx, size_t rx_len)
+{
+    i2c_sched_txn_t txn = {
+        .dev = dev,
+        .cls = cls,
+        .head = tx,
+        .head_len = tx_len,
+        .rx = rx,
+        .rx_len = rx_len,
+    };
+
+    return i2c_sched_transfer(&txn);
+}
+
+void i2c_sched_get_stats(i2c_sched_class_t cls, i2c_sched_stats_t *out)
+{
+    if (cls >= I2C_SCHED_CLASS_COUNT) {
+        memset(out, 0, sizeof(*out));
+        return;
+    }
+
+    taskENTER_CRITICAL(&s_stats_lock);
+    *out = s_stats[cls];
+    taskEXIT_CRITICAL(&s_stats_lock);
+}
+
+void i2c_sched_reset_stats(void)
+{
+    taskENTER_CRITICAL(&s_stats_lock);
+    memset(s_stats, 0, sizeof(s_stats));
+    taskEXIT_CRITICAL(&s_stats_lock);
+}
+
+void i2c_sched_log_stats(void)
+{
+    i2c_sched_stats_t st;
+    int cls;
+
+    for (cls = 0; cls < I2C_SCHED_CLASS_COUNT; cls++) {
+        i2c_sched_get_stats(cls, &st);
+        if (st.count == 0) {
+            continue;
+        }
+        ESP_LOGI(TAG, "%-7s n=%lu err=%lu chunks=%lu preempt=%lu wait avg/max=%lu/%lu us latency avg/max=%lu/%lu us",
+                 s_class_names[cls], (unsigned long)st.count, (unsigned long)st.errors,
+                 (unsigned long)st.chunks, (unsigned long)st.preemptions,
+                 (unsigned long)(st.wait_sum_us / st.count), (unsigned long)st.wait_max_us,
+                 (unsigned long)(st.latency_sum_us / st.count), (unsigned long)st.latency_max_us);
+    }
+}
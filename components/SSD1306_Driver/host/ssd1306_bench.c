@@ -0,0 +1,323 @@
+/*
+ * Benchmark of SSD1306 rendering core on host.
+ *
+ * Every case is timed on its own (ns/op) and then drawn as a whole frame,
+ * clear + draw + SSD1306_UpdateScreen(), into capture backend which counts
+ * what would go over I2C (bytes/frame, transactions/frame).
+ *
+ * Capture backend also keeps a copy of LCD RAM. Every frame is checked against
+ * a full redraw of the same frame, once through SSD1306_UpdateScreen() and once
+ * through buffer swap and front flush as flush task does it. Swapped frames of
+ * cases which clear the screen must not cost more bytes than synchronous ones.
+ * Exits with 1 on any mismatch.
+ *
+ * Usage: ssd1306_bench [iterations]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "ssd1306.h"
+#include "ssd1306_internal.h"
+#include "fonts.h"
+
+/* Frames flushed per case when counting bytes on the wire */
+#define BENCH_FRAMES          64
+
+/* Bytes added to every I2C transaction, address byte and control byte */
+#define BENCH_TRANSACTION_OVERHEAD   2
+
+/* Capture backend, counts traffic instead of sending it and keeps LCD RAM */
+typedef struct {
+	uint32_t Bytes;
+	uint32_t Transactions;
+	uint8_t Column0;
+	uint8_t Page0;
+	uint8_t Lcd[SSD1306_BUFFER_SIZE];
+} Capture_t;
+
+static Capture_t Capture;
+
+/* Frames as full redraw puts them on LCD, reference for dirty tracking */
+static uint8_t Bench_Reference[BENCH_FRAMES][SSD1306_BUFFER_SIZE];
+
+static void Capture_WriteCommands(void* context, const uint8_t* commands, uint16_t count) {
+	Capture_t* capture = (Capture_t*)context;
+	
+	/* Window of following data, as flush sends it */
+	if (count == 6 && commands[0] == 0x21 && commands[3] == 0x22) {
+		capture->Column0 = commands[1];
+		capture->Page0 = commands[4];
+	}
+	capture->Bytes += BENCH_TRANSACTION_OVERHEAD + count;
+	capture->Transactions++;
+}
+
+static void Capture_WriteData(void* context, const uint8_t* data, uint16_t width, uint8_t rows, uint16_t stride) {
+	Capture_t* capture = (Capture_t*)context;
+	volatile uint8_t sink = 0;
+	uint8_t r;
+	uint16_t i;
+	
+	/* Touch every byte, like a real transport would */
+	for (r = 0; r < rows; r++) {
+		for (i = 0; i < width; i++) {
+			sink ^= data[r * stride + i];
+		}
+		if (capture->Page0 + r < SSD1306_PAGES && capture->Column0 + width <= SSD1306_WIDTH) {
+			memcpy(&capture->Lcd[(capture->Page0 + r) * SSD1306_WIDTH + capture->Column0], &data[r * stride], width);
+		}
+	}
+	(void)sink;
+	
+	capture->Bytes += BENCH_TRANSACTION_OVERHEAD + (uint32_t)width * rows;
+	capture->Transactions++;
+}
+
+static const SSD1306_Backend_t Capture_Backend = {
+	.Init = NULL,
+	.WriteCommands = Capture_WriteCommands,
+	.WriteData = Capture_WriteData,
+	.Context = &Capture
+};
+
+/* 32x32 helmet icon, 1 bit per pixel, MSB first */
+static const unsigned char Bench_Helmet[32 * 4] = {
+	0x00,0x0F,0xF0,0x00, 0x00,0x7F,0xFE,0x00, 0x01,0xFF,0xFF,0x80, 0x03,0xFF,0xFF,0xC0,
+	0x07,0xF0,0x0F,0xE0, 0x0F,0xC0,0x03,0xF0, 0x1F,0x80,0x01,0xF8, 0x1F,0x00,0x00,0xF8,
+	0x3F,0x00,0x00,0xFC, 0x3E,0x00,0x00,0x7C, 0x7E,0x00,0x00,0x7E, 0x7C,0x00,0x00,0x3E,
+	0x7C,0x00,0x00,0x3E, 0xFC,0x00,0x00,0x3F, 0xF8,0x00,0x00,0x1F, 0xF8,0x00,0x00,0x1F,
+	0xFF,0xFF,0xFF,0xFF, 0xFF,0xFF,0xFF,0xFF, 0xFF,0xFF,0xFF,0xFF, 0x00,0x00,0x00,0x00,
+	0x00,0x00,0x00,0x00, 0x00,0x00,0x00,0x00, 0x00,0x00,0x00,0x00, 0x00,0x00,0x00,0x00,
+	0x00,0x00,0x00,0x00, 0x00,0x00,0x00,0x00, 0x00,0x00,0x00,0x00, 0x00,0x00,0x00,0x00,
+	0x00,0x00,0x00,0x00, 0x00,0x00,0x00,0x00, 0x00,0x00,0x00,0x00, 0x00,0x00,0x00,0x00
+};
+
+static void Bench_Puts(uint32_t i, uint16_t y, const FontDef_t* font) {
+	char text[8];
+	
+	/* Reading which changes every frame, like sensor values on helmet */
+	snprintf(text, sizeof(text), "%02u.%uC", (unsigned)(i / 10 % 100), (unsigned)(i % 10));
+	SSD1306_GotoXY(0, y);
+	SSD1306_Puts(text, font, SSD1306_COLOR_WHITE);
+}
+
+static void Bench_Puts7x10(uint32_t i) {
+	Bench_Puts(i, 0, &Font_7x10);
+}
+
+static void Bench_Puts7x10Unaligned(uint32_t i) {
+	Bench_Puts(i, 3, &Font_7x10);
+}
+
+static void Bench_Puts11x18(uint32_t i) {
+	Bench_Puts(i, 0, &Font_11x18);
+}
+
+static void Bench_Puts16x26(uint32_t i) {
+	Bench_Puts(i, 0, &Font_16x26);
+}
+
+static void Bench_Fill(uint32_t i) {
+	SSD1306_Fill((i & 1) ? SSD1306_COLOR_WHITE : SSD1306_COLOR_BLACK);
+}
+
+static void Bench_Bar(uint32_t i) {
+	/* Gauge frame with fill level */
+	SSD1306_DrawRectangle(2, 44, 123, 12, SSD1306_COLOR_WHITE);
+	SSD1306_FillRect(4, 46, i % 120, 9, SSD1306_COLOR_WHITE);
+}
+
+static void Bench_HVLines(uint32_t i) {
+	SSD1306_DrawLine(0, i % 64, SSD1306_WIDTH - 1, i % 64, SSD1306_COLOR_WHITE);
+	SSD1306_DrawLine(i % 128, 0, i % 128, SSD1306_HEIGHT - 1, SSD1306_COLOR_WHITE);
+}
+
+static void Bench_Diagonal(uint32_t i) {
+	SSD1306_DrawLine(0, 0, SSD1306_WIDTH - 1, i % 64, SSD1306_COLOR_WHITE);
+}
+
+static void Bench_Circle(uint32_t i) {
+	SSD1306_DrawCircle(64, 32, 10 + i % 20, SSD1306_COLOR_WHITE);
+}
+
+static void Bench_FilledCircle(uint32_t i) {
+	SSD1306_DrawFilledCircle(64, 32, 10 + i % 20, SSD1306_COLOR_WHITE);
+}
+
+static void Bench_FilledTriangle(uint32_t i) {
+	SSD1306_DrawFilledTriangle(4, 60, 64, i % 40, 124, 60, SSD1306_COLOR_WHITE);
+}
+
+static void Bench_Bitmap(uint32_t i) {
+	SSD1306_DrawBitmap(i % 96, 16, Bench_Helmet, 32, 32, SSD1306_COLOR_WHITE);
+}
+
+static void Bench_Widget(uint32_t i) {
+	uint16_t x = (i & 1) ? 64 : 0;
+	
+	/* Value box alternating between two places, redrawn without clearing the screen,
+	 * so back buffer differs from LCD where previous frame was drawn */
+	SSD1306_FillRect(x, 16, 56, 10, SSD1306_COLOR_BLACK);
+	Bench_Puts(i, 16, &Font_7x10);
+	SSD1306_GotoXY(x, 16);
+	SSD1306_Puts("#", &Font_7x10, SSD1306_COLOR_WHITE);
+}
+
+static void Bench_EncodeFull(uint32_t i) {
+	(void)i;
+	SSD1306_UpdateScreenFull();
+}
+
+static void Bench_EncodeInvalid(uint32_t i) {
+	(void)i;
+	/* Whole frame through dirty tracking path */
+	SSD1306_Invalidate();
+	SSD1306_UpdateScreen();
+}
+
+typedef struct {
+	const char* Name;
+	void (*Draw)(uint32_t i);
+	uint8_t Partial;            /* Draws over previous frame instead of clearing screen */
+} Bench_t;
+
+static const Bench_t Benches[] = {
+	{"puts_7x10",           Bench_Puts7x10, 0},
+	{"puts_7x10_unaligned", Bench_Puts7x10Unaligned, 0},
+	{"puts_11x18",          Bench_Puts11x18, 0},
+	{"puts_16x26",          Bench_Puts16x26, 0},
+	{"fill",                Bench_Fill, 0},
+	{"bar_fillrect",        Bench_Bar, 0},
+	{"lines_hv",            Bench_HVLines, 0},
+	{"line_diagonal",       Bench_Diagonal, 0},
+	{"circle",              Bench_Circle, 0},
+	{"circle_filled",       Bench_FilledCircle, 0},
+	{"triangle_filled",     Bench_FilledTriangle, 0},
+	{"bitmap_32x32",        Bench_Bitmap, 0},
+	{"widget_partial",      Bench_Widget, 1},
+	{"encode_full",         Bench_EncodeFull, 0},
+	{"encode_invalidated",  Bench_EncodeInvalid, 0},
+};
+
+/* Blank LCD, and both frame buffers blank for swapped frames */
+static void Bench_Blank(void) {
+	uint8_t k;
+	
+	SSD1306_Fill(SSD1306_COLOR_BLACK);
+	SSD1306_UpdateScreen();
+	for (k = 0; k < 2; k++) {
+		SSD1306_Fill(SSD1306_COLOR_BLACK);
+		SSD1306_SwapFrames();
+		SSD1306_FlushFront();
+	}
+}
+
+static uint64_t Bench_Now(void) {
+	struct timespec ts;
+	
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+int main(int argc, char** argv) {
+	uint32_t iterations = 20000;
+	uint32_t b, i;
+	uint64_t start, elapsed;
+	uint32_t bytes, transactions, sync_bytes, sync_transactions;
+	uint8_t lcd[SSD1306_BUFFER_SIZE];
+	int failed = 0, mismatch;
+	
+	if (argc > 1) {
+		iterations = (uint32_t)strtoul(argv[1], NULL, 10);
+		if (iterations == 0) {
+			iterations = 1;
+		}
+	}
+	
+	SSD1306_SetBackend(&Capture_Backend);
+	if (!SSD1306_Init()) {
+		fprintf(stderr, "SSD1306 init failed\n");
+		return 1;
+	}
+	
+	printf("%-22s %10s %12s %12s %12s\n", "case", "ns/op", "bytes/frame", "trans/frame", "swap bytes");
+	for (b = 0; b < sizeof(Benches) / sizeof(Benches[0]); b++) {
+		mismatch = 0;
+		
+		/* Rendering cost alone */
+		SSD1306_Fill(SSD1306_COLOR_BLACK);
+		SSD1306_UpdateScreen();
+		start = Bench_Now();
+		for (i = 0; i < iterations; i++) {
+			Benches[b].Draw(i);
+		}
+		elapsed = Bench_Now() - start;
+		
+		/* Traffic of whole frames, LCD starts from blank screen */
+		Bench_Blank();
+		Capture.Bytes = 0;
+		Capture.Transactions = 0;
+		for (i = 0; i < BENCH_FRAMES; i++) {
+			if (!Benches[b].Partial) {
+				SSD1306_Fill(SSD1306_COLOR_BLACK);
+			}
+			Benches[b].Draw(i);
+			SSD1306_UpdateScreen();
+			memcpy(lcd, Capture.Lcd, sizeof(lcd));
+			
+			/* Full redraw of same frame, not counted */
+			bytes = Capture.Bytes;
+			transactions = Capture.Transactions;
+			SSD1306_UpdateScreenFull();
+			Capture.Bytes = bytes;
+			Capture.Transactions = transactions;
+			if (memcmp(lcd, Capture.Lcd, sizeof(lcd)) != 0) {
+				mismatch = 1;
+			}
+		}
+		sync_bytes = Capture.Bytes;
+		sync_transactions = Capture.Transactions;
+		
+		/* Swapped frames, invalidated so whole front buffer goes out as reference */
+		Bench_Blank();
+		for (i = 0; i < BENCH_FRAMES; i++) {
+			if (!Benches[b].Partial) {
+				SSD1306_Fill(SSD1306_COLOR_BLACK);
+			}
+			Benches[b].Draw(i);
+			SSD1306_Invalidate();
+			SSD1306_SwapFrames();
+			SSD1306_FlushFront();
+			memcpy(Bench_Reference[i], Capture.Lcd, sizeof(lcd));
+		}
+		
+		/* Same frames through dirty tracking of swap and front flush */
+		Bench_Blank();
+		Capture.Bytes = 0;
+		for (i = 0; i < BENCH_FRAMES; i++) {
+			if (!Benches[b].Partial) {
+				SSD1306_Fill(SSD1306_COLOR_BLACK);
+			}
+			Benches[b].Draw(i);
+			SSD1306_SwapFrames();
+			SSD1306_FlushFront();
+			if (memcmp(Bench_Reference[i], Capture.Lcd, sizeof(lcd)) != 0) {
+				mismatch = 1;
+			}
+		}
+		if (!Benches[b].Partial && Capture.Bytes > sync_bytes) {
+			mismatch = 1;
+		}
+		
+		printf("%-22s %10.1f %12.1f %12.2f %12.1f %s\n", Benches[b].Name,
+			(double)elapsed / iterations,
+			(double)sync_bytes / BENCH_FRAMES,
+			(double)sync_transactions / BENCH_FRAMES,
+			(double)Capture.Bytes / BENCH_FRAMES,
+			mismatch ? "FAIL" : "ok");
+		failed |= mismatch;
+	}
+	
+	return failed;
+}
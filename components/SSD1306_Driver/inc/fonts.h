@@ -27,11 +27,18 @@ extern C {
 
 /**
  * @brief  Font structure used on my LCD libraries
+ * @note   When packed is set, glyphs are drawn from it and data may be NULL.
+ *         Packed glyphs are stored one after another, each glyph page by page (8 pixel rows)
+ *         and each page as FontWidth bytes with bit 0 on top, same as SSD1306 RAM.
+ *         Packed tables are generated from data at build time by tools/fontpack.py.
  */
 typedef struct {
-	uint8_t FontWidth;    /*!< Font width in pixels */
-	uint8_t FontHeight;   /*!< Font height in pixels */
-	const uint16_t *data; /*!< Pointer to data font data array */
+	uint8_t FontWidth;      /*!< Font width in pixels */
+	uint8_t FontHeight;     /*!< Font height in pixels */
+	const uint16_t *data;   /*!< Pointer to data font data array, one row per uint16_t, MSB is leftmost pixel */
+	char FirstChar;         /*!< First character in font */
+	char LastChar;          /*!< Last character in font */
+	const uint8_t *packed;  /*!< Pointer to column-byte glyph table or NULL */
 } FontDef_t;
 
 /** 
@@ -55,17 +62,17 @@ typedef struct {
 /**
  * @brief  7 x 10 pixels font size structure 
  */
-extern FontDef_t Font_7x10;
+extern const FontDef_t Font_7x10;
 
 /**
  * @brief  11 x 18 pixels font size structure 
  */
-extern FontDef_t Font_11x18;
+extern const FontDef_t Font_11x18;
 
 /**
  * @brief  16 x 26 pixels font size structure 
  */
-extern FontDef_t Font_16x26;
+extern const FontDef_t Font_16x26;
 
 /**
  * @}
@@ -84,7 +91,7 @@ extern FontDef_t Font_16x26;
  * @param  *Font: Pointer to @ref FontDef_t font used for calculations
  * @retval Pointer to string used for length and height
  */
-char* FONTS_GetStringSize(char* str, FONTS_SIZE_t* SizeStruct, FontDef_t* Font);
+char* FONTS_GetStringSize(char* str, FONTS_SIZE_t* SizeStruct, const FontDef_t* Font);
 
 /**
  * @}
@@ -9,16 +9,7 @@ extern C {
 #include "fonts.h"
 #include "stdlib.h"
 #include "string.h"
-#include "driver/i2c.h"
-
-/* I2C address */
-#define I2C_MASTER_SDA_IO 26
-#define I2C_MASTER_SCL_IO 27
-#define I2C_MASTER_FREQ_HZ 100000
-
-#define SSD1306_I2C_ADDR         0x78
-
-//#define SSD1306_I2C_ADDR       0x7A
+#include "ssd1306_backend.h"
 
 /* SSD1306 settings */
 /* SSD1306 width in pixels */
@@ -44,7 +35,7 @@ typedef enum {
  * @brief  Initializes SSD1306 LCD
  * @param  None
  * @retval Initialization status:
- *           - 0: LCD was not detected on I2C port
+ *           - 0: No backend was set or LCD was not detected by it
  *           - > 0: LCD initialized OK and ready to use
  */
 uint8_t SSD1306_Init(void);
@@ -52,11 +43,29 @@ uint8_t SSD1306_Init(void);
 /** 
  * @brief  Updates buffer from internal RAM to LCD
  * @note   This function must be called each time you do some changes to LCD, to update buffer from RAM to LCD
+ * @note   Only pages and column ranges changed since last update are sent over I2C
+ * @note   When flush task from ssd1306_flush.h is running this is SSD1306_SwapBuffers() followed by SSD1306_WaitFlushDone()
  * @param  None
  * @retval None
  */
 void SSD1306_UpdateScreen(void);
 
+/**
+ * @brief  Sends whole buffer from internal RAM to LCD in one transaction
+ * @note   LCD runs in horizontal addressing mode, so one column/page window covers entire screen
+ * @param  None
+ * @retval None
+ */
+void SSD1306_UpdateScreenFull(void);
+
+/**
+ * @brief  Forces next @ref SSD1306_UpdateScreen() to send whole buffer
+ * @note   Use it when LCD RAM content was lost, for example after LCD power cycle
+ * @param  None
+ * @retval None
+ */
+void SSD1306_Invalidate(void);
+
 /**
  * @brief  Toggles pixels invertion inside internal RAM
  * @note   @ref SSD1306_UpdateScreen() must be called after that in order to see updated LCD screen
@@ -97,9 +106,9 @@ void SSD1306_GotoXY(uint16_t x, uint16_t y);
  * @param  ch: Character to be written
  * @param  *Font: Pointer to @ref FontDef_t structure with used font
  * @param  color: Color used for drawing. This parameter can be a value of @ref SSD1306_COLOR_t enumeration
- * @retval Character written
+ * @retval Character written, zero when character does not fit on LCD or is not in font
  */
-char SSD1306_Putc(char ch, FontDef_t* Font, SSD1306_COLOR_t color);
+char SSD1306_Putc(char ch, const FontDef_t* Font, SSD1306_COLOR_t color);
 
 /**
  * @brief  Puts string to internal RAM
@@ -109,7 +118,7 @@ char SSD1306_Putc(char ch, FontDef_t* Font, SSD1306_COLOR_t color);
  * @param  color: Color used for drawing. This parameter can be a value of @ref SSD1306_COLOR_t enumeration
  * @retval Zero on success or character value when function failed
  */
-char SSD1306_Puts(char* str, FontDef_t* Font, SSD1306_COLOR_t color);
+char SSD1306_Puts(char* str, const FontDef_t* Font, SSD1306_COLOR_t color);
 
 /**
  * @brief  Draws line on LCD
@@ -123,6 +132,43 @@ char SSD1306_Puts(char* str, FontDef_t* Font, SSD1306_COLOR_t color);
  */
 void SSD1306_DrawLine(uint16_t x0, uint16_t y0, uint16_t x1, uint16_t y1, SSD1306_COLOR_t c);
 
+/**
+ * @brief  Draws horizontal line on LCD, one masked byte per column
+ * @note   @ref SSD1306_UpdateScreen() must be called after that in order to see updated LCD screen
+ * @note   Parts outside of LCD are clipped
+ * @param  x: Left X start point
+ * @param  y: Y location
+ * @param  w: Line width in units of pixels
+ * @param  c: Color to be used. This parameter can be a value of @ref SSD1306_COLOR_t enumeration
+ * @retval None
+ */
+void SSD1306_DrawHLine(int16_t x, int16_t y, int16_t w, SSD1306_COLOR_t c);
+
+/**
+ * @brief  Draws vertical line on LCD, one masked byte per page
+ * @note   @ref SSD1306_UpdateScreen() must be called after that in order to see updated LCD screen
+ * @note   Parts outside of LCD are clipped
+ * @param  x: X location
+ * @param  y: Top Y start point
+ * @param  h: Line height in units of pixels
+ * @param  c: Color to be used. This parameter can be a value of @ref SSD1306_COLOR_t enumeration
+ * @retval None
+ */
+void SSD1306_DrawVLine(int16_t x, int16_t y, int16_t h, SSD1306_COLOR_t c);
+
+/**
+ * @brief  Fills w x h pixels on LCD, one masked byte per column and page
+ * @note   @ref SSD1306_UpdateScreen() must be called after that in order to see updated LCD screen
+ * @note   Parts outside of LCD are clipped. Cheap enough for bars and gauges redrawn every frame
+ * @param  x: Top left X start point
+ * @param  y: Top left Y start point
+ * @param  w: Rectangle width in units of pixels
+ * @param  h: Rectangle height in units of pixels
+ * @param  c: Color to be used. This parameter can be a value of @ref SSD1306_COLOR_t enumeration
+ * @retval None
+ */
+void SSD1306_FillRect(int16_t x, int16_t y, int16_t w, int16_t h, SSD1306_COLOR_t c);
+
 /**
  * @brief  Draws rectangle on LCD
  * @note   @ref SSD1306_UpdateScreen() must be called after that in order to see updated LCD screen
@@ -161,6 +207,20 @@ void SSD1306_DrawFilledRectangle(uint16_t x, uint16_t y, uint16_t w, uint16_t h,
  */
 void SSD1306_DrawTriangle(uint16_t x1, uint16_t y1, uint16_t x2, uint16_t y2, uint16_t x3, uint16_t y3, SSD1306_COLOR_t color);
 
+/**
+ * @brief  Draws filled triangle on LCD
+ * @note   @ref SSD1306_UpdateScreen() must be called after that in order to see updated LCD screen
+ * @param  x1: First coordinate X location. Valid input is 0 to SSD1306_WIDTH - 1
+ * @param  y1: First coordinate Y location. Valid input is 0 to SSD1306_HEIGHT - 1
+ * @param  x2: Second coordinate X location. Valid input is 0 to SSD1306_WIDTH - 1
+ * @param  y2: Second coordinate Y location. Valid input is 0 to SSD1306_HEIGHT - 1
+ * @param  x3: Third coordinate X location. Valid input is 0 to SSD1306_WIDTH - 1
+ * @param  y3: Third coordinate Y location. Valid input is 0 to SSD1306_HEIGHT - 1
+ * @param  c: Color to be used. This parameter can be a value of @ref SSD1306_COLOR_t enumeration
+ * @retval None
+ */
+void SSD1306_DrawFilledTriangle(uint16_t x1, uint16_t y1, uint16_t x2, uint16_t y2, uint16_t x3, uint16_t y3, SSD1306_COLOR_t color);
+
 /**
  * @brief  Draws circle to STM buffer
  * @note   @ref SSD1306_UpdateScreen() must be called after that in order to see updated LCD screen
@@ -185,39 +245,13 @@ void SSD1306_DrawFilledCircle(int16_t x0, int16_t y0, int16_t r, SSD1306_COLOR_t
 
 
 
-#ifndef ssd1306_I2C_TIMEOUT
-#define ssd1306_I2C_TIMEOUT					20000
-#endif
-
-/**
- * @brief  Initializes SSD1306 LCD
- * @param  None
- * @retval Initialization status:
- *           - 0: LCD was not detected on I2C port
- *           - > 0: LCD initialized OK and ready to use
- */
-void ssd1306_I2C_Init(void);
-
-/**
- * @brief  Writes single byte to slave
- * @param  *I2Cx: I2C used
- * @param  address: 7 bit slave address, left aligned, bits 7:1 are used, LSB bit is not used
- * @param  reg: register to write to
- * @param  data: data to be written
- * @retval None
- */
-void ssd1306_I2C_Write(uint8_t address, uint8_t reg, uint8_t data);
-
 /**
- * @brief  Writes multi bytes to slave
- * @param  *I2Cx: I2C used
- * @param  address: 7 bit slave address, left aligned, bits 7:1 are used, LSB bit is not used
- * @param  reg: register to write to
- * @param  *data: pointer to data array to write it to slave
- * @param  count: how many bytes will be written
+ * @brief  Sends command sequence to LCD in one transaction
+ * @param  *commands: Commands and their arguments
+ * @param  count: Number of bytes in sequence
  * @retval None
  */
-void ssd1306_I2C_WriteMulti(uint8_t address, uint8_t reg, uint8_t *data, uint16_t count);
+void SSD1306_WriteCommands(const uint8_t* commands, uint16_t count);
 
 /**
  * @brief  Draws the Bitmap
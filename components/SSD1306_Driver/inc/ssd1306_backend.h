@@ -0,0 +1,60 @@
+#ifndef SSD1306_BACKEND_H
+#define SSD1306_BACKEND_H 100
+
+/* C++ detection */
+#ifdef __cplusplus
+extern C {
+#endif
+
+#include "stdint.h"
+
+/**
+ * Transport used by rendering layer to reach LCD.
+ *
+ * Rendering code only produces command sequences and blocks of GDDRAM bytes,
+ * backend decides how they get on the wire (I2C on target, capture or nothing on host).
+ */
+
+/**
+ * @brief  SSD1306 backend
+ */
+typedef struct {
+	/**
+	 * @brief  Prepares transport, called from @ref SSD1306_Init(). Can be NULL
+	 * @param  *Context: Backend context
+	 * @retval 0 when LCD can not be reached, > 0 when OK
+	 */
+	uint8_t (*Init)(void* Context);
+	/**
+	 * @brief  Sends command sequence to LCD in one transaction
+	 * @param  *Context: Backend context
+	 * @param  *commands: Commands and their arguments
+	 * @param  count: Number of bytes in sequence
+	 */
+	void (*WriteCommands)(void* Context, const uint8_t* commands, uint16_t count);
+	/**
+	 * @brief  Sends rectangular block of GDDRAM bytes to LCD in one transaction
+	 * @param  *Context: Backend context
+	 * @param  *data: Pointer to first byte of first row
+	 * @param  width: How many bytes are sent from each row
+	 * @param  rows: Number of rows
+	 * @param  stride: Distance between rows in bytes
+	 */
+	void (*WriteData)(void* Context, const uint8_t* data, uint16_t width, uint8_t rows, uint16_t stride);
+	void* Context; /*!< Passed to every call */
+} SSD1306_Backend_t;
+
+/**
+ * @brief  Selects transport used by all following LCD writes
+ * @note   Must be called before @ref SSD1306_Init()
+ * @param  *backend: Backend to use, must stay valid while LCD is used
+ * @retval None
+ */
+void SSD1306_SetBackend(const SSD1306_Backend_t* backend);
+
+/* C++ detection */
+#ifdef __cplusplus
+}
+#endif
+
+#endif
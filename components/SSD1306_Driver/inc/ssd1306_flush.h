@@ -0,0 +1,61 @@
+#ifndef SSD1306_FLUSH_H
+#define SSD1306_FLUSH_H 100
+
+/* C++ detection */
+#ifdef __cplusplus
+extern C {
+#endif
+
+#include "ssd1306.h"
+#include "freertos/FreeRTOS.h"
+
+/**
+ * Background flush of SSD1306 frames on FreeRTOS.
+ *
+ * Once task is started, drawing goes to back buffer while front buffer is sent,
+ * @ref SSD1306_SwapBuffers() hands finished frame over.
+ */
+
+/**
+ * @brief  Starts background task which sends front buffer to LCD
+ * @note   After this call drawing goes to back buffer and frames are submitted with @ref SSD1306_SwapBuffers()
+ * @param  priority: Priority of flush task
+ * @param  core: Core flush task is pinned to
+ * @retval Start status:
+ *           - 0: Task or its event group could not be created
+ *           - > 0: Flush task is running
+ */
+uint8_t SSD1306_StartFlushTask(UBaseType_t priority, BaseType_t core);
+
+/**
+ * @brief  Submits back buffer for flushing and makes previous front buffer new back buffer
+ * @note   Swap itself only exchanges pointers. It waits while previous frame is still being sent.
+ * @note   New back buffer holds an older frame, so it has to be redrawn completely before next swap
+ * @param  wait: Maximum time to wait for previous flush to finish
+ * @retval Submitted frame number, 0 when previous flush did not finish in time
+ */
+uint32_t SSD1306_SwapBuffers(TickType_t wait);
+
+/**
+ * @brief  Waits until submitted frame has been sent to LCD
+ * @param  frame: Frame number returned by @ref SSD1306_SwapBuffers()
+ * @param  wait: Maximum time to wait
+ * @retval Flush status:
+ *           - 0: Frame is still being sent or flush task is not running
+ *           - > 0: Frame is on LCD
+ */
+uint8_t SSD1306_WaitFlushDone(uint32_t frame, TickType_t wait);
+
+/**
+ * @brief  Gets number of last frame which was completely sent to LCD
+ * @param  None
+ * @retval Frame number, 0 if no frame has been flushed yet
+ */
+uint32_t SSD1306_GetFlushedFrame(void);
+
+/* C++ detection */
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,19 @@
+#ifndef SSD1306_I2C_H
+#define SSD1306_I2C_H 100
+
+/*
+ * I2C parameters of LCD. Transport itself is not part of this component,
+ * application passes its own backend to @ref SSD1306_SetBackend().
+ */
+
+/* I2C address */
+#define SSD1306_I2C_ADDR         0x78
+
+//#define SSD1306_I2C_ADDR       0x7A
+
+/* Default SCL clock for LCD, device clock is independent from other devices on bus */
+#ifndef SSD1306_I2C_FREQ_HZ
+#define SSD1306_I2C_FREQ_HZ      400000
+#endif
+
+#endif
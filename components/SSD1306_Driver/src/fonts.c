@@ -295,25 +295,39 @@ const uint16_t Font16x26 [] = {
 };
 
 
-FontDef_t Font_7x10 = {
-	7,
-	10,
-	Font7x10
+/* Column-byte glyph tables, generated from tables above at build time by tools/fontpack.py */
+extern const uint8_t Font7x10_Packed[];
+extern const uint8_t Font11x18_Packed[];
+extern const uint8_t Font16x26_Packed[];
+
+const FontDef_t Font_7x10 = {
+	.FontWidth = 7,
+	.FontHeight = 10,
+	.data = Font7x10,
+	.FirstChar = ' ',
+	.LastChar = '~',
+	.packed = Font7x10_Packed
 };
 
-FontDef_t Font_11x18 = {
-	11,
-	18,
-	Font11x18
+const FontDef_t Font_11x18 = {
+	.FontWidth = 11,
+	.FontHeight = 18,
+	.data = Font11x18,
+	.FirstChar = ' ',
+	.LastChar = '~',
+	.packed = Font11x18_Packed
 };
 
-FontDef_t Font_16x26 = {
-	16,
-	26,
-	Font16x26
+const FontDef_t Font_16x26 = {
+	.FontWidth = 16,
+	.FontHeight = 26,
+	.data = Font16x26,
+	.FirstChar = ' ',
+	.LastChar = '~',
+	.packed = Font16x26_Packed
 };
 
-char* FONTS_GetStringSize(char* str, FONTS_SIZE_t* SizeStruct, FontDef_t* Font) {
+char* FONTS_GetStringSize(char* str, FONTS_SIZE_t* SizeStruct, const FontDef_t* Font) {
 	/* Fill settings */
 	SizeStruct->Height = Font->FontHeight;
 	SizeStruct->Length = Font->FontWidth * strlen(str);
@@ -1,14 +1,46 @@
 #include "ssd1306.h"
+#include "ssd1306_internal.h"
 
 /* Write command */
-#define SSD1306_WRITECOMMAND(command)      ssd1306_I2C_Write(SSD1306_I2C_ADDR, 0x00, (command))
-/* Write data */
-#define SSD1306_WRITEDATA(data)            ssd1306_I2C_Write(SSD1306_I2C_ADDR, 0x40, (data))
+#define SSD1306_WRITECOMMAND(command)      SSD1306_WriteCommands((const uint8_t[]){ (command) }, 1)
+/* Write command array in one transaction */
+#define SSD1306_WRITECOMMANDS(commands)    SSD1306_WriteCommands((commands), sizeof(commands))
 /* Absolute value */
 #define ABS(x)   ((x) > 0 ? (x) : -(x))
+/* Smaller and bigger of two values */
+#define MIN(a, b)   ((a) < (b) ? (a) : (b))
+#define MAX(a, b)   ((a) > (b) ? (a) : (b))
 
-/* SSD1306 data buffer */
-static uint8_t SSD1306_Buffer[SSD1306_WIDTH * SSD1306_HEIGHT / 8];
+/* SSD1306 frame buffers */
+static uint8_t SSD1306_Frames[2][SSD1306_BUFFER_SIZE];
+
+/* Back buffer, all drawing goes here */
+static uint8_t* SSD1306_Buffer = SSD1306_Frames[0];
+
+/* Front buffer, owned by flush task between swap and flush done */
+static uint8_t* SSD1306_Front = SSD1306_Frames[1];
+
+/* Copy of what was last sent to LCD, used to trim dirty ranges before flush */
+static uint8_t SSD1306_Shadow[SSD1306_BUFFER_SIZE];
+
+/* Dirty column range of one page, page is clean when Min > Max */
+typedef struct {
+	uint8_t Min;
+	uint8_t Max;
+} SSD1306_Dirty_t;
+
+/* Columns changed since last flush, per page, for back and front buffer */
+static SSD1306_Dirty_t SSD1306_Dirty[SSD1306_PAGES];
+static SSD1306_Dirty_t SSD1306_FrontDirty[SSD1306_PAGES];
+
+/* Columns drawn into back buffer since last swap */
+static SSD1306_Dirty_t SSD1306_Drawn[SSD1306_PAGES];
+
+/* Transport to LCD */
+static const SSD1306_Backend_t* SSD1306_Backend;
+
+/* Takes over UpdateScreen when frames are flushed in background */
+static SSD1306_Presenter_t SSD1306_Presenter;
 
 /* Private SSD1306 structure */
 typedef struct {
@@ -16,6 +48,9 @@ typedef struct {
 	uint16_t CurrentY;
 	uint8_t Inverted;
 	uint8_t Initialized;
+	uint8_t ShadowValid;
+	uint8_t Invalid;
+	uint8_t FrontInvalid;
 } SSD1306_t;
 
 /* Private variable */
@@ -33,62 +68,130 @@ static SSD1306_t SSD1306;
 #define SSD1306_NORMALDISPLAY       0xA6
 #define SSD1306_INVERTDISPLAY       0xA7
 
+#define SSD1306_SET_COLUMN_ADDRESS  0x21
+#define SSD1306_SET_PAGE_ADDRESS    0x22
+
+/* Approximate cost of opening one column/page window in bytes on the wire,
+ * command transaction plus data transaction header and START/STOP */
+#define SSD1306_WINDOW_COST         12
+
+
+static inline void SSD1306_MarkDirty(uint16_t x0, uint16_t x1, uint16_t page0, uint16_t page1) {
+	uint16_t p;
+
+	for (p = page0; p <= page1; p++) {
+		if (x0 < SSD1306_Dirty[p].Min) {
+			SSD1306_Dirty[p].Min = x0;
+		}
+		if (x1 > SSD1306_Dirty[p].Max) {
+			SSD1306_Dirty[p].Max = x1;
+		}
+		if (x0 < SSD1306_Drawn[p].Min) {
+			SSD1306_Drawn[p].Min = x0;
+		}
+		if (x1 > SSD1306_Drawn[p].Max) {
+			SSD1306_Drawn[p].Max = x1;
+		}
+	}
+}
+
+static inline void SSD1306_ClearRanges(SSD1306_Dirty_t* ranges) {
+	uint8_t m;
+	
+	for (m = 0; m < SSD1306_PAGES; m++) {
+		ranges[m].Min = 0xFF;
+		ranges[m].Max = 0;
+	}
+}
+
+static inline void SSD1306_MarkAllDirty(void) {
+	SSD1306_MarkDirty(0, SSD1306_WIDTH - 1, 0, SSD1306_PAGES - 1);
+}
+
+
+void SSD1306_SetBackend(const SSD1306_Backend_t* backend) {
+	SSD1306_Backend = backend;
+}
+
+void SSD1306_WriteCommands(const uint8_t* commands, uint16_t count) {
+	if (SSD1306_Backend == NULL) {
+		return;
+	}
+	SSD1306_Backend->WriteCommands(SSD1306_Backend->Context, commands, count);
+}
+
 
 void SSD1306_ScrollRight(uint8_t start_row, uint8_t end_row)
 {
-  SSD1306_WRITECOMMAND (SSD1306_RIGHT_HORIZONTAL_SCROLL);  // send 0x26
-  SSD1306_WRITECOMMAND (0x00);  // send dummy
-  SSD1306_WRITECOMMAND(start_row);  // start page address
-  SSD1306_WRITECOMMAND(0X00);  // time interval 5 frames
-  SSD1306_WRITECOMMAND(end_row);  // end page address
-  SSD1306_WRITECOMMAND(0X00);
-  SSD1306_WRITECOMMAND(0XFF);
-  SSD1306_WRITECOMMAND (SSD1306_ACTIVATE_SCROLL); // start scroll
+  const uint8_t commands[] = {
+    SSD1306_RIGHT_HORIZONTAL_SCROLL,  // send 0x26
+    0x00,  // send dummy
+    start_row,  // start page address
+    0X00,  // time interval 5 frames
+    end_row,  // end page address
+    0X00,
+    0XFF,
+    SSD1306_ACTIVATE_SCROLL  // start scroll
+  };
+
+  SSD1306_WRITECOMMANDS(commands);
 }
 
 
 void SSD1306_ScrollLeft(uint8_t start_row, uint8_t end_row)
 {
-  SSD1306_WRITECOMMAND (SSD1306_LEFT_HORIZONTAL_SCROLL);  // send 0x26
-  SSD1306_WRITECOMMAND (0x00);  // send dummy
-  SSD1306_WRITECOMMAND(start_row);  // start page address
-  SSD1306_WRITECOMMAND(0X00);  // time interval 5 frames
-  SSD1306_WRITECOMMAND(end_row);  // end page address
-  SSD1306_WRITECOMMAND(0X00);
-  SSD1306_WRITECOMMAND(0XFF);
-  SSD1306_WRITECOMMAND (SSD1306_ACTIVATE_SCROLL); // start scroll
+  const uint8_t commands[] = {
+    SSD1306_LEFT_HORIZONTAL_SCROLL,  // send 0x27
+    0x00,  // send dummy
+    start_row,  // start page address
+    0X00,  // time interval 5 frames
+    end_row,  // end page address
+    0X00,
+    0XFF,
+    SSD1306_ACTIVATE_SCROLL  // start scroll
+  };
+
+  SSD1306_WRITECOMMANDS(commands);
 }
 
 
 void SSD1306_Scrolldiagright(uint8_t start_row, uint8_t end_row)
 {
-  SSD1306_WRITECOMMAND(SSD1306_SET_VERTICAL_SCROLL_AREA);  // sect the area
-  SSD1306_WRITECOMMAND (0x00);   // write dummy
-  SSD1306_WRITECOMMAND(SSD1306_HEIGHT);
-
-  SSD1306_WRITECOMMAND(SSD1306_VERTICAL_AND_RIGHT_HORIZONTAL_SCROLL);
-  SSD1306_WRITECOMMAND (0x00);
-  SSD1306_WRITECOMMAND(start_row);
-  SSD1306_WRITECOMMAND(0X00);
-  SSD1306_WRITECOMMAND(end_row);
-  SSD1306_WRITECOMMAND (0x01);
-  SSD1306_WRITECOMMAND (SSD1306_ACTIVATE_SCROLL);
+  const uint8_t commands[] = {
+    SSD1306_SET_VERTICAL_SCROLL_AREA,  // sect the area
+    0x00,   // write dummy
+    SSD1306_HEIGHT,
+
+    SSD1306_VERTICAL_AND_RIGHT_HORIZONTAL_SCROLL,
+    0x00,
+    start_row,
+    0X00,
+    end_row,
+    0x01,
+    SSD1306_ACTIVATE_SCROLL
+  };
+
+  SSD1306_WRITECOMMANDS(commands);
 }
 
 
 void SSD1306_Scrolldiagleft(uint8_t start_row, uint8_t end_row)
 {
-  SSD1306_WRITECOMMAND(SSD1306_SET_VERTICAL_SCROLL_AREA);  // sect the area
-  SSD1306_WRITECOMMAND (0x00);   // write dummy
-  SSD1306_WRITECOMMAND(SSD1306_HEIGHT);
-
-  SSD1306_WRITECOMMAND(SSD1306_VERTICAL_AND_LEFT_HORIZONTAL_SCROLL);
-  SSD1306_WRITECOMMAND (0x00);
-  SSD1306_WRITECOMMAND(start_row);
-  SSD1306_WRITECOMMAND(0X00);
-  SSD1306_WRITECOMMAND(end_row);
-  SSD1306_WRITECOMMAND (0x01);
-  SSD1306_WRITECOMMAND (SSD1306_ACTIVATE_SCROLL);
+  const uint8_t commands[] = {
+    SSD1306_SET_VERTICAL_SCROLL_AREA,  // sect the area
+    0x00,   // write dummy
+    SSD1306_HEIGHT,
+
+    SSD1306_VERTICAL_AND_LEFT_HORIZONTAL_SCROLL,
+    0x00,
+    start_row,
+    0X00,
+    end_row,
+    0x01,
+    SSD1306_ACTIVATE_SCROLL
+  };
+
+  SSD1306_WRITECOMMANDS(commands);
 }
 
 
@@ -127,7 +230,7 @@ void SSD1306_DrawBitmap(int16_t x, int16_t y, const unsigned char* bitmap, int16
                byte = (*(const unsigned char *)(&bitmap[j * byteWidth + i / 8]));
             }
 			uint8_t tmp = byte&0x80;
-            if( tmp == 1) SSD1306_DrawPixel(x+i, y, (SSD1306_COLOR_t)color);
+            if( tmp ) SSD1306_DrawPixel(x+i, y, (SSD1306_COLOR_t)color);
         }
     }
 }
@@ -135,8 +238,13 @@ void SSD1306_DrawBitmap(int16_t x, int16_t y, const unsigned char* bitmap, int16
 
 uint8_t SSD1306_Init(void) {
 
-	/* Init I2C */
-	ssd1306_I2C_Init();
+	/* Init transport */
+	if (SSD1306_Backend == NULL) {
+		return 0;
+	}
+	if (SSD1306_Backend->Init != NULL && !SSD1306_Backend->Init(SSD1306_Backend->Context)) {
+		return 0;
+	}
 
 	/* A little delay */
 	uint32_t p = 2500;
@@ -144,37 +252,38 @@ uint8_t SSD1306_Init(void) {
 		p--;
 	
 	/* Init LCD */
-	SSD1306_WRITECOMMAND(0xAE); //display off
-	SSD1306_WRITECOMMAND(0x20); //Set Memory Addressing Mode   
-	SSD1306_WRITECOMMAND(0x10); //00,Horizontal Addressing Mode;01,Vertical Addressing Mode;10,Page Addressing Mode (RESET);11,Invalid
-	SSD1306_WRITECOMMAND(0xB0); //Set Page Start Address for Page Addressing Mode,0-7
-	SSD1306_WRITECOMMAND(0xC8); //Set COM Output Scan Direction
-	SSD1306_WRITECOMMAND(0x00); //---set low column address
-	SSD1306_WRITECOMMAND(0x10); //---set high column address
-	SSD1306_WRITECOMMAND(0x40); //--set start line address
-	SSD1306_WRITECOMMAND(0x81); //--set contrast control register
-	SSD1306_WRITECOMMAND(0xFF);
-	SSD1306_WRITECOMMAND(0xA1); //--set segment re-map 0 to 127
-	SSD1306_WRITECOMMAND(0xA6); //--set normal display
-	SSD1306_WRITECOMMAND(0xA8); //--set multiplex ratio(1 to 64)
-	SSD1306_WRITECOMMAND(0x3F); //
-	SSD1306_WRITECOMMAND(0xA4); //0xa4,Output follows RAM content;0xa5,Output ignores RAM content
-	SSD1306_WRITECOMMAND(0xD3); //-set display offset
-	SSD1306_WRITECOMMAND(0x00); //-not offset
-	SSD1306_WRITECOMMAND(0xD5); //--set display clock divide ratio/oscillator frequency
-	SSD1306_WRITECOMMAND(0xF0); //--set divide ratio
-	SSD1306_WRITECOMMAND(0xD9); //--set pre-charge period
-	SSD1306_WRITECOMMAND(0x22); //
-	SSD1306_WRITECOMMAND(0xDA); //--set com pins hardware configuration
-	SSD1306_WRITECOMMAND(0x12);
-	SSD1306_WRITECOMMAND(0xDB); //--set vcomh
-	SSD1306_WRITECOMMAND(0x20); //0x20,0.77xVcc
-	SSD1306_WRITECOMMAND(0x8D); //--set DC-DC enable
-	SSD1306_WRITECOMMAND(0x14); //
-	SSD1306_WRITECOMMAND(0xAF); //--turn on SSD1306 panel
-	
-
-	SSD1306_WRITECOMMAND(SSD1306_DEACTIVATE_SCROLL);
+	static const uint8_t init_commands[] = {
+		0xAE, //display off
+		0x20, //Set Memory Addressing Mode   
+		0x00, //00,Horizontal Addressing Mode;01,Vertical Addressing Mode;10,Page Addressing Mode (RESET);11,Invalid
+		0xC8, //Set COM Output Scan Direction
+		0x40, //--set start line address
+		0x81, //--set contrast control register
+		0xFF,
+		0xA1, //--set segment re-map 0 to 127
+		0xA6, //--set normal display
+		0xA8, //--set multiplex ratio(1 to 64)
+		0x3F, //
+		0xA4, //0xa4,Output follows RAM content;0xa5,Output ignores RAM content
+		0xD3, //-set display offset
+		0x00, //-not offset
+		0xD5, //--set display clock divide ratio/oscillator frequency
+		0xF0, //--set divide ratio
+		0xD9, //--set pre-charge period
+		0x22, //
+		0xDA, //--set com pins hardware configuration
+		0x12,
+		0xDB, //--set vcomh
+		0x20, //0x20,0.77xVcc
+		0x8D, //--set DC-DC enable
+		0x14, //
+		0xAF, //--turn on SSD1306 panel
+		SSD1306_DEACTIVATE_SCROLL
+	};
+	SSD1306_WRITECOMMANDS(init_commands);
+
+	/* LCD RAM content is unknown, first update has to send everything */
+	SSD1306_Invalidate();
 
 	/* Clear screen */
 	SSD1306_Fill(SSD1306_COLOR_BLACK);
@@ -193,17 +302,144 @@ uint8_t SSD1306_Init(void) {
 	return 1;
 }
 
-void SSD1306_UpdateScreen(void) {
+static void SSD1306_FlushWindow(const uint8_t* buffer, uint16_t x0, uint16_t x1, uint8_t page0, uint8_t page1) {
+	uint16_t width = x1 - x0 + 1;
 	uint8_t m;
+	const uint8_t commands[] = {
+		SSD1306_SET_COLUMN_ADDRESS, x0, x1,
+		SSD1306_SET_PAGE_ADDRESS, page0, page1
+	};
+	
+	/* Horizontal addressing wraps inside the window, so all pages go out in one transaction */
+	SSD1306_WRITECOMMANDS(commands);
+	SSD1306_Backend->WriteData(SSD1306_Backend->Context, &buffer[SSD1306_WIDTH * page0 + x0], width, page1 - page0 + 1, SSD1306_WIDTH);
+	
+	for (m = page0; m <= page1; m++) {
+		memcpy(&SSD1306_Shadow[SSD1306_WIDTH * m + x0], &buffer[SSD1306_WIDTH * m + x0], width);
+	}
+}
+
+static void SSD1306_Flush(const uint8_t* buffer, SSD1306_Dirty_t* changed, uint8_t* invalid) {
+	SSD1306_Dirty_t dirty[SSD1306_PAGES];
+	uint8_t m, page0 = 0xFF, page1 = 0;
+	uint16_t x0, x1, offset, min = 0xFF, max = 0;
+	uint32_t pages_cost = 0;
 	
-	for (m = 0; m < 8; m++) {
-		SSD1306_WRITECOMMAND(0xB0 + m);
-		SSD1306_WRITECOMMAND(0x00);
-		SSD1306_WRITECOMMAND(0x10);
+	/* LCD content is unknown, do not trim against shadow */
+	if (*invalid) {
+		SSD1306.ShadowValid = 0;
+		*invalid = 0;
+	}
+	
+	for (m = 0; m < SSD1306_PAGES; m++) {
+		x0 = changed[m].Min;
+		x1 = changed[m].Max;
+		
+		/* Mark page clean */
+		changed[m].Min = 0xFF;
+		changed[m].Max = 0;
+		
+		/* Skip columns which already hold the same data on LCD */
+		offset = SSD1306_WIDTH * m;
+		if (SSD1306.ShadowValid) {
+			while (x0 <= x1 && buffer[offset + x0] == SSD1306_Shadow[offset + x0]) {
+				x0++;
+			}
+			while (x1 > x0 && buffer[offset + x1] == SSD1306_Shadow[offset + x1]) {
+				x1--;
+			}
+		}
 		
-		/* Write multi data */
-		ssd1306_I2C_WriteMulti(SSD1306_I2C_ADDR, 0x40, &SSD1306_Buffer[SSD1306_WIDTH * m], SSD1306_WIDTH);
+		dirty[m].Min = x0;
+		dirty[m].Max = x1;
+		if (x0 > x1) {
+			continue;
+		}
+		
+		/* Bounding window of all dirty pages */
+		if (m < page0) page0 = m;
+		page1 = m;
+		if (x0 < min) min = x0;
+		if (x1 > max) max = x1;
+		pages_cost += (x1 - x0 + 1) + SSD1306_WINDOW_COST;
+	}
+	
+	if (page0 > page1) {
+		/* Nothing changed */
+		SSD1306.ShadowValid = 1;
+		return;
+	}
+	
+	/* One window covering everything is cheaper than a window per page */
+	if ((uint32_t)(max - min + 1) * (page1 - page0 + 1) + SSD1306_WINDOW_COST <= pages_cost) {
+		SSD1306_FlushWindow(buffer, min, max, page0, page1);
+	} else {
+		for (m = page0; m <= page1; m++) {
+			if (dirty[m].Min <= dirty[m].Max) {
+				SSD1306_FlushWindow(buffer, dirty[m].Min, dirty[m].Max, m, m);
+			}
+		}
+	}
+	
+	SSD1306.ShadowValid = 1;
+}
+
+void SSD1306_UpdateScreen(void) {
+	if (SSD1306_Presenter != NULL) {
+		/* Flush task owns LCD, hand frame over to it */
+		SSD1306_Presenter();
+		return;
+	}
+	
+	SSD1306_Flush(SSD1306_Buffer, SSD1306_Dirty, &SSD1306.Invalid);
+}
+
+void SSD1306_UpdateScreenFull(void) {
+	uint8_t m;
+	
+	if (SSD1306_Presenter != NULL) {
+		SSD1306_Invalidate();
+		SSD1306_Presenter();
+		return;
+	}
+	
+	for (m = 0; m < SSD1306_PAGES; m++) {
+		SSD1306_Dirty[m].Min = 0xFF;
+		SSD1306_Dirty[m].Max = 0;
 	}
+	
+	SSD1306_FlushWindow(SSD1306_Buffer, 0, SSD1306_WIDTH - 1, 0, SSD1306_PAGES - 1);
+	SSD1306.Invalid = 0;
+	SSD1306.ShadowValid = 1;
+}
+
+void SSD1306_SetPresenter(SSD1306_Presenter_t presenter) {
+	SSD1306_Presenter = presenter;
+}
+
+void SSD1306_SwapFrames(void) {
+	uint8_t* tmp;
+	
+	tmp = SSD1306_Front;
+	SSD1306_Front = SSD1306_Buffer;
+	SSD1306_Buffer = tmp;
+	
+	/* New back buffer holds previous frame. It differs from submitted frame only where
+	 * submitted frame was drawn, so only those ranges carry over into next frame. */
+	memcpy(SSD1306_FrontDirty, SSD1306_Dirty, sizeof(SSD1306_Dirty));
+	memcpy(SSD1306_Dirty, SSD1306_Drawn, sizeof(SSD1306_Drawn));
+	SSD1306_ClearRanges(SSD1306_Drawn);
+	SSD1306.FrontInvalid = SSD1306.Invalid;
+	SSD1306.Invalid = 0;
+}
+
+void SSD1306_FlushFront(void) {
+	SSD1306_Flush(SSD1306_Front, SSD1306_FrontDirty, &SSD1306.FrontInvalid);
+}
+
+void SSD1306_Invalidate(void) {
+	SSD1306.Invalid = 1;
+	SSD1306_MarkAllDirty();
 }
 
 void SSD1306_ToggleInvert(void) {
@@ -213,14 +449,16 @@ void SSD1306_ToggleInvert(void) {
 	SSD1306.Inverted = !SSD1306.Inverted;
 	
 	/* Do memory toggle */
-	for (i = 0; i < sizeof(SSD1306_Buffer); i++) {
+	for (i = 0; i < SSD1306_BUFFER_SIZE; i++) {
 		SSD1306_Buffer[i] = ~SSD1306_Buffer[i];
 	}
+	SSD1306_MarkAllDirty();
 }
 
 void SSD1306_Fill(SSD1306_COLOR_t color) {
 	/* Set memory */
-	memset(SSD1306_Buffer, (color == SSD1306_COLOR_BLACK) ? 0x00 : 0xFF, sizeof(SSD1306_Buffer));
+	memset(SSD1306_Buffer, (color == SSD1306_COLOR_BLACK) ? 0x00 : 0xFF, SSD1306_BUFFER_SIZE);
+	SSD1306_MarkAllDirty();
 }
 
 void SSD1306_DrawPixel(uint16_t x, uint16_t y, SSD1306_COLOR_t color) {
@@ -243,6 +481,9 @@ void SSD1306_DrawPixel(uint16_t x, uint16_t y, SSD1306_COLOR_t color) {
 	} else {
 		SSD1306_Buffer[x + (y / 8) * SSD1306_WIDTH] &= ~(1 << (y % 8));
 	}
+	
+	/* Track changed column */
+	SSD1306_MarkDirty(x, x, y / 8, y / 8);
 }
 
 void SSD1306_GotoXY(uint16_t x, uint16_t y) {
@@ -251,8 +492,125 @@ void SSD1306_GotoXY(uint16_t x, uint16_t y) {
 	SSD1306.CurrentY = y;
 }
 
-char SSD1306_Putc(char ch, FontDef_t* Font, SSD1306_COLOR_t color) {
-	uint32_t i, b, j;
+/* Writes w columns of h pixels at x, y. Bit i of columns[j] is pixel (x + j, y + i).
+ * Covered pixels are replaced, set bits get color and clear bits its opposite. */
+static void SSD1306_BlitColumns(uint16_t x, uint16_t y, uint8_t w, uint8_t h, const uint32_t* columns, SSD1306_COLOR_t color) {
+	uint8_t page0 = y / 8;
+	uint8_t page1 = (y + h - 1) / 8;
+	uint8_t shift = y % 8;
+	uint8_t p, j, mask, bits;
+	uint8_t* dst;
+	uint32_t col, colmask = (h < 32) ? ((1UL << h) - 1) : 0xFFFFFFFFUL;
+	uint64_t col64, mask64;
+	
+	/* Pixels are inverted */
+	if (SSD1306.Inverted) {
+		color = (SSD1306_COLOR_t)!color;
+	}
+	
+	for (j = 0; j < w; j++) {
+		col = (color == SSD1306_COLOR_WHITE) ? columns[j] : ~columns[j];
+		col &= colmask;
+		dst = &SSD1306_Buffer[SSD1306_WIDTH * page0 + x + j];
+		
+		if (shift == 0) {
+			/* Fast path, glyph rows line up with pages */
+			for (p = page0; p <= page1; p++, dst += SSD1306_WIDTH) {
+				bits = (uint8_t)col;
+				mask = (uint8_t)colmask;
+				if (mask == 0xFF) {
+					*dst = bits;
+				} else {
+					*dst = (*dst & ~mask) | bits;
+				}
+				col >>= 8;
+				colmask >>= 8;
+			}
+			colmask = (h < 32) ? ((1UL << h) - 1) : 0xFFFFFFFFUL;
+		} else {
+			col64 = (uint64_t)col << shift;
+			mask64 = (uint64_t)colmask << shift;
+			for (p = page0; p <= page1; p++, dst += SSD1306_WIDTH) {
+				mask = (uint8_t)mask64;
+				*dst = (*dst & ~mask) | (uint8_t)col64;
+				col64 >>= 8;
+				mask64 >>= 8;
+			}
+		}
+	}
+	
+	/* Track changed area once for whole block */
+	SSD1306_MarkDirty(x, x + w - 1, page0, page1);
+}
+
+/* Writes packed glyph at x, y. Glyph is stored page by page, w bytes per page, bit 0 on top. */
+static void SSD1306_BlitPacked(uint16_t x, uint16_t y, uint8_t w, uint8_t h, const uint8_t* glyph, SSD1306_COLOR_t color) {
+	uint8_t pages = (h + 7) / 8;
+	uint8_t page0 = y / 8;
+	uint8_t page1 = (y + h - 1) / 8;
+	uint8_t shift = y % 8;
+	uint8_t last = (h % 8) ? ((1 << (h % 8)) - 1) : 0xFF;
+	uint8_t invert, p, j, k, mask, bits;
+	uint16_t src_bits, src_mask;
+	const uint8_t* src;
+	uint8_t* dst;
+	
+	/* Pixels are inverted, glyph bytes are inverted when background is white */
+	if (SSD1306.Inverted) {
+		color = (SSD1306_COLOR_t)!color;
+	}
+	invert = (color == SSD1306_COLOR_WHITE) ? 0x00 : 0xFF;
+	
+	if (shift == 0) {
+		/* Fast path, glyph pages line up with LCD pages, copy them straight in */
+		for (p = 0; p < pages; p++) {
+			src = &glyph[p * w];
+			dst = &SSD1306_Buffer[SSD1306_WIDTH * (page0 + p) + x];
+			mask = (p == pages - 1) ? last : 0xFF;
+			if (mask == 0xFF && invert == 0) {
+				memcpy(dst, src, w);
+			} else if (mask == 0xFF) {
+				for (j = 0; j < w; j++) {
+					dst[j] = ~src[j];
+				}
+			} else {
+				for (j = 0; j < w; j++) {
+					dst[j] = (dst[j] & ~mask) | ((src[j] ^ invert) & mask);
+				}
+			}
+		}
+	} else {
+		/* Every LCD page takes the top of one glyph page and the bottom of the previous one */
+		for (k = 0; k <= page1 - page0; k++) {
+			dst = &SSD1306_Buffer[SSD1306_WIDTH * (page0 + k) + x];
+			for (j = 0; j < w; j++) {
+				src_bits = 0;
+				src_mask = 0;
+				if (k < pages) {
+					src_bits = glyph[k * w + j];
+					src_mask = (k == pages - 1) ? last : 0xFF;
+				}
+				src_bits <<= 8;
+				src_mask <<= 8;
+				if (k > 0) {
+					src_bits |= glyph[(k - 1) * w + j];
+					src_mask |= (k - 1 == pages - 1) ? last : 0xFF;
+				}
+				mask = (uint8_t)(src_mask >> (8 - shift));
+				bits = (uint8_t)(((src_bits ^ (invert ? 0xFFFF : 0)) & src_mask) >> (8 - shift));
+				dst[j] = (dst[j] & ~mask) | bits;
+			}
+		}
+	}
+	
+	/* Track changed area once for whole glyph */
+	SSD1306_MarkDirty(x, x + w - 1, page0, page1);
+}
+
+char SSD1306_Putc(char ch, const FontDef_t* Font, SSD1306_COLOR_t color) {
+	uint32_t columns[16];
+	uint32_t i, b, j, index;
+	const uint16_t* glyph;
 	
 	/* Check available space in LCD */
 	if (
@@ -263,16 +621,33 @@ char SSD1306_Putc(char ch, FontDef_t* Font, SSD1306_COLOR_t color) {
 		return 0;
 	}
 	
-	/* Go through font */
-	for (i = 0; i < Font->FontHeight; i++) {
-		b = Font->data[(ch - 32) * Font->FontHeight + i];
-		for (j = 0; j < Font->FontWidth; j++) {
-			if ((b << j) & 0x8000) {
-				SSD1306_DrawPixel(SSD1306.CurrentX + j, (SSD1306.CurrentY + i), (SSD1306_COLOR_t) color);
-			} else {
-				SSD1306_DrawPixel(SSD1306.CurrentX + j, (SSD1306.CurrentY + i), (SSD1306_COLOR_t)!color);
+	/* Check character is in font */
+	if ((uint8_t)ch < (uint8_t)Font->FirstChar || (uint8_t)ch > (uint8_t)Font->LastChar) {
+		/* Error */
+		return 0;
+	}
+	index = (uint8_t)ch - (uint8_t)Font->FirstChar;
+	
+	if (Font->packed != NULL) {
+		/* Glyph is already in LCD byte order */
+		SSD1306_BlitPacked(SSD1306.CurrentX, SSD1306.CurrentY, Font->FontWidth, Font->FontHeight,
+			&Font->packed[index * ((Font->FontHeight + 7) / 8) * Font->FontWidth], color);
+	} else {
+		/* Turn font rows into pixel columns, visiting only set bits */
+		memset(columns, 0, sizeof(columns));
+		glyph = &Font->data[index * Font->FontHeight];
+		for (i = 0; i < Font->FontHeight; i++) {
+			b = (uint32_t)glyph[i] << 16;
+			while (b) {
+				j = __builtin_clz(b);
+				if (j < Font->FontWidth) {
+					columns[j] |= 1UL << i;
+				}
+				b &= ~(0x80000000UL >> j);
 			}
 		}
+		
+		SSD1306_BlitColumns(SSD1306.CurrentX, SSD1306.CurrentY, Font->FontWidth, Font->FontHeight, columns, color);
 	}
 	
 	/* Increase pointer */
@@ -282,7 +657,7 @@ char SSD1306_Putc(char ch, FontDef_t* Font, SSD1306_COLOR_t color) {
 	return ch;
 }
 
-char SSD1306_Puts(char* str, FontDef_t* Font, SSD1306_COLOR_t color) {
+char SSD1306_Puts(char* str, const FontDef_t* Font, SSD1306_COLOR_t color) {
 	/* Write characters */
 	while (*str) {
 		/* Write character by character */
@@ -300,8 +675,90 @@ char SSD1306_Puts(char* str, FontDef_t* Font, SSD1306_COLOR_t color) {
 }
  
 
+/* Fills x0..x1, y0..y1 (inclusive, clipped to LCD) one masked byte per column and page */
+static void SSD1306_FillArea(int16_t x0, int16_t y0, int16_t x1, int16_t y1, SSD1306_COLOR_t color) {
+	uint8_t page0, page1, p, mask, fill;
+	uint16_t j, n;
+	uint8_t* dst;
+	
+	/* Clip to LCD */
+	if (x0 < 0) {
+		x0 = 0;
+	}
+	if (y0 < 0) {
+		y0 = 0;
+	}
+	if (x1 >= SSD1306_WIDTH) {
+		x1 = SSD1306_WIDTH - 1;
+	}
+	if (y1 >= SSD1306_HEIGHT) {
+		y1 = SSD1306_HEIGHT - 1;
+	}
+	if (x0 > x1 || y0 > y1) {
+		/* Nothing visible */
+		return;
+	}
+	
+	/* Check if pixels are inverted */
+	if (SSD1306.Inverted) {
+		color = (SSD1306_COLOR_t)!color;
+	}
+	fill = (color == SSD1306_COLOR_WHITE) ? 0xFF : 0x00;
+	
+	page0 = y0 / 8;
+	page1 = y1 / 8;
+	n = x1 - x0 + 1;
+	for (p = page0; p <= page1; p++) {
+		/* Rows of this page covered by span */
+		mask = 0xFF;
+		if (p == page0) {
+			mask &= 0xFF << (y0 % 8);
+		}
+		if (p == page1) {
+			mask &= 0xFF >> (7 - y1 % 8);
+		}
+		
+		dst = &SSD1306_Buffer[SSD1306_WIDTH * p + x0];
+		if (mask == 0xFF) {
+			memset(dst, fill, n);
+		} else if (fill) {
+			for (j = 0; j < n; j++) {
+				dst[j] |= mask;
+			}
+		} else {
+			for (j = 0; j < n; j++) {
+				dst[j] &= ~mask;
+			}
+		}
+	}
+	
+	/* Track changed area once for whole span */
+	SSD1306_MarkDirty(x0, x1, page0, page1);
+}
+
+void SSD1306_DrawHLine(int16_t x, int16_t y, int16_t w, SSD1306_COLOR_t c) {
+	if (w <= 0) {
+		return;
+	}
+	SSD1306_FillArea(x, y, x + w - 1, y, c);
+}
+
+void SSD1306_DrawVLine(int16_t x, int16_t y, int16_t h, SSD1306_COLOR_t c) {
+	if (h <= 0) {
+		return;
+	}
+	SSD1306_FillArea(x, y, x, y + h - 1, c);
+}
+
+void SSD1306_FillRect(int16_t x, int16_t y, int16_t w, int16_t h, SSD1306_COLOR_t c) {
+	if (w <= 0 || h <= 0) {
+		return;
+	}
+	SSD1306_FillArea(x, y, x + w - 1, y + h - 1, c);
+}
+
 void SSD1306_DrawLine(uint16_t x0, uint16_t y0, uint16_t x1, uint16_t y1, SSD1306_COLOR_t c) {
-	int16_t dx, dy, sx, sy, err, e2, i, tmp; 
+	int16_t dx, dy, sx, sy, err, e2, tmp; 
 	
 	/* Check for overflow */
 	if (x0 >= SSD1306_WIDTH) {
@@ -337,9 +794,7 @@ void SSD1306_DrawLine(uint16_t x0, uint16_t y0, uint16_t x1, uint16_t y1, SSD130
 		}
 		
 		/* Vertical line */
-		for (i = y0; i <= y1; i++) {
-			SSD1306_DrawPixel(x0, i, c);
-		}
+		SSD1306_FillArea(x0, y0, x0, y1, c);
 		
 		/* Return from function */
 		return;
@@ -359,9 +814,7 @@ void SSD1306_DrawLine(uint16_t x0, uint16_t y0, uint16_t x1, uint16_t y1, SSD130
 		}
 		
 		/* Horizontal line */
-		for (i = x0; i <= x1; i++) {
-			SSD1306_DrawPixel(i, y0, c);
-		}
+		SSD1306_FillArea(x0, y0, x1, y0, c);
 		
 		/* Return from function */
 		return;
@@ -410,8 +863,6 @@ void SSD1306_DrawRectangle(uint16_t x, uint16_t y, uint16_t w, uint16_t h, SSD13
 }
 
 void SSD1306_DrawFilledRectangle(uint16_t x, uint16_t y, uint16_t w, uint16_t h, SSD1306_COLOR_t c) {
-	uint8_t i;
-	
 	/* Check input parameters */
 	if (
 		x >= SSD1306_WIDTH ||
@@ -421,19 +872,16 @@ void SSD1306_DrawFilledRectangle(uint16_t x, uint16_t y, uint16_t w, uint16_t h,
 		return;
 	}
 	
-	/* Check width and height */
-	if ((x + w) >= SSD1306_WIDTH) {
-		w = SSD1306_WIDTH - x;
+	/* Check width and height, x + w must stay in int16_t range of SSD1306_FillArea */
+	if ((uint32_t)x + w >= SSD1306_WIDTH) {
+		w = SSD1306_WIDTH - 1 - x;
 	}
-	if ((y + h) >= SSD1306_HEIGHT) {
-		h = SSD1306_HEIGHT - y;
+	if ((uint32_t)y + h >= SSD1306_HEIGHT) {
+		h = SSD1306_HEIGHT - 1 - y;
 	}
 	
-	/* Draw lines */
-	for (i = 0; i <= h; i++) {
-		/* Draw lines */
-		SSD1306_DrawLine(x, y + i, x + w, y + i, c);
-	}
+	/* Corners are inclusive, same as outline from SSD1306_DrawRectangle */
+	SSD1306_FillArea(x, y, x + w, y + h, c);
 }
 
 void SSD1306_DrawTriangle(uint16_t x1, uint16_t y1, uint16_t x2, uint16_t y2, uint16_t x3, uint16_t y3, SSD1306_COLOR_t color) {
@@ -444,59 +892,60 @@ void SSD1306_DrawTriangle(uint16_t x1, uint16_t y1, uint16_t x2, uint16_t y2, ui
 }
 
 
-void SSD1306_DrawFilledTriangle(uint16_t x1, uint16_t y1, uint16_t x2, uint16_t y2, uint16_t x3, uint16_t y3, SSD1306_COLOR_t color) {
-	int16_t deltax = 0, deltay = 0, x = 0, y = 0, xinc1 = 0, xinc2 = 0, 
-	yinc1 = 0, yinc2 = 0, den = 0, num = 0, numadd = 0, numpixels = 0, 
-	curpixel = 0;
-	
-	deltax = ABS(x2 - x1);
-	deltay = ABS(y2 - y1);
-	x = x1;
-	y = y1;
-
-	if (x2 >= x1) {
-		xinc1 = 1;
-		xinc2 = 1;
-	} else {
-		xinc1 = -1;
-		xinc2 = -1;
+/* Walks edge like SSD1306_DrawLine and widens per-row span limits to cover it */
+static void SSD1306_TraceEdge(int16_t x0, int16_t y0, int16_t x1, int16_t y1, int16_t* xmin, int16_t* xmax) {
+	int16_t dx, dy, sx, sy, err, e2;
+	
+	dx = ABS(x1 - x0);
+	dy = ABS(y1 - y0);
+	sx = (x0 < x1) ? 1 : -1;
+	sy = (y0 < y1) ? 1 : -1;
+	err = ((dx > dy) ? dx : -dy) / 2;
+	
+	while (1) {
+		xmin[y0] = MIN(xmin[y0], x0);
+		xmax[y0] = MAX(xmax[y0], x0);
+		if (x0 == x1 && y0 == y1) {
+			break;
+		}
+		e2 = err;
+		if (e2 > -dx) {
+			err -= dy;
+			x0 += sx;
+		}
+		if (e2 < dy) {
+			err += dx;
+			y0 += sy;
+		}
 	}
+}
 
-	if (y2 >= y1) {
-		yinc1 = 1;
-		yinc2 = 1;
-	} else {
-		yinc1 = -1;
-		yinc2 = -1;
+void SSD1306_DrawFilledTriangle(uint16_t x1, uint16_t y1, uint16_t x2, uint16_t y2, uint16_t x3, uint16_t y3, SSD1306_COLOR_t color) {
+	int16_t xmin[SSD1306_HEIGHT], xmax[SSD1306_HEIGHT];
+	int16_t y, ymin, ymax;
+	
+	/* Check for overflow, same as SSD1306_DrawLine */
+	x1 = MIN(x1, SSD1306_WIDTH - 1);
+	x2 = MIN(x2, SSD1306_WIDTH - 1);
+	x3 = MIN(x3, SSD1306_WIDTH - 1);
+	y1 = MIN(y1, SSD1306_HEIGHT - 1);
+	y2 = MIN(y2, SSD1306_HEIGHT - 1);
+	y3 = MIN(y3, SSD1306_HEIGHT - 1);
+	
+	ymin = MIN(y1, MIN(y2, y3));
+	ymax = MAX(y1, MAX(y2, y3));
+	for (y = ymin; y <= ymax; y++) {
+		xmin[y] = SSD1306_WIDTH;
+		xmax[y] = -1;
 	}
-
-	if (deltax >= deltay){
-		xinc1 = 0;
-		yinc2 = 0;
-		den = deltax;
-		num = deltax / 2;
-		numadd = deltay;
-		numpixels = deltax;
-	} else {
-		xinc2 = 0;
-		yinc1 = 0;
-		den = deltay;
-		num = deltay / 2;
-		numadd = deltax;
-		numpixels = deltay;
-	}
-
-	for (curpixel = 0; curpixel <= numpixels; curpixel++) {
-		SSD1306_DrawLine(x, y, x3, y3, color);
-
-		num += numadd;
-		if (num >= den) {
-			num -= den;
-			x += xinc1;
-			y += yinc1;
-		}
-		x += xinc2;
-		y += yinc2;
+	
+	/* Triangle is convex, so every row is one span between its outline pixels */
+	SSD1306_TraceEdge(x1, y1, x2, y2, xmin, xmax);
+	SSD1306_TraceEdge(x2, y2, x3, y3, xmin, xmax);
+	SSD1306_TraceEdge(x3, y3, x1, y1, xmin, xmax);
+	
+	for (y = ymin; y <= ymax; y++) {
+		SSD1306_FillArea(xmin[y], y, xmax[y], y, color);
 	}
 }
 
@@ -541,28 +990,24 @@ void SSD1306_DrawFilledCircle(int16_t x0, int16_t y0, int16_t r, SSD1306_COLOR_t
 	int16_t x = 0;
 	int16_t y = r;
 
-    SSD1306_DrawPixel(x0, y0 + r, c);
-    SSD1306_DrawPixel(x0, y0 - r, c);
-    SSD1306_DrawPixel(x0 + r, y0, c);
-    SSD1306_DrawPixel(x0 - r, y0, c);
-    SSD1306_DrawLine(x0 - r, y0, x0 + r, y0, c);
+	/* Center column, then symmetric vertical spans to the sides */
+	SSD1306_FillArea(x0, y0 - r, x0, y0 + r, c);
 
-    while (x < y) {
-        if (f >= 0) {
-            y--;
-            ddF_y += 2;
-            f += ddF_y;
-        }
-        x++;
-        ddF_x += 2;
-        f += ddF_x;
-
-        SSD1306_DrawLine(x0 - x, y0 + y, x0 + x, y0 + y, c);
-        SSD1306_DrawLine(x0 + x, y0 - y, x0 - x, y0 - y, c);
-
-        SSD1306_DrawLine(x0 + y, y0 + x, x0 - y, y0 + x, c);
-        SSD1306_DrawLine(x0 + y, y0 - x, x0 - y, y0 - x, c);
-    }
+	while (x < y) {
+		if (f >= 0) {
+			y--;
+			ddF_y += 2;
+			f += ddF_y;
+		}
+		x++;
+		ddF_x += 2;
+		f += ddF_x;
+
+		SSD1306_FillArea(x0 + x, y0 - y, x0 + x, y0 + y, c);
+		SSD1306_FillArea(x0 - x, y0 - y, x0 - x, y0 + y, c);
+		SSD1306_FillArea(x0 + y, y0 - x, x0 + y, y0 + x, c);
+		SSD1306_FillArea(x0 - y, y0 - x, x0 - y, y0 + x, c);
+	}
 }
  
 
@@ -573,84 +1018,10 @@ void SSD1306_Clear (void)
     //SSD1306_UpdateScreen();
 }
 void SSD1306_ON(void) {
-	SSD1306_WRITECOMMAND(0x8D);  
-	SSD1306_WRITECOMMAND(0x14);  
-	SSD1306_WRITECOMMAND(0xAF);  
+	const uint8_t commands[] = {0x8D, 0x14, 0xAF};
+	SSD1306_WRITECOMMANDS(commands);
 }
 void SSD1306_OFF(void) {
-	SSD1306_WRITECOMMAND(0x8D);  
-	SSD1306_WRITECOMMAND(0x10);
-	SSD1306_WRITECOMMAND(0xAE);  
-}
-
-/////////////////////////////////////////////////////////////////////////////////////////////////////////
-//  _____ ___   _____ 
-// |_   _|__ \ / ____|
-//   | |    ) | |     
-//   | |   / /| |     
-//  _| |_ / /_| |____ 
-// |_____|____|\_____|
-//
-/////////////////////////////////////////////////////////////////////////////////////////////////////////
-
-i2c_config_t i2c_conf = {
-    .mode = I2C_MODE_MASTER,
-    .sda_io_num = I2C_MASTER_SDA_IO,         // select GPIO specific to your project
-    .sda_pullup_en = GPIO_PULLUP_DISABLE,
-    .scl_io_num = I2C_MASTER_SCL_IO,         // select GPIO specific to your project
-    .scl_pullup_en = GPIO_PULLUP_DISABLE,
-    .master.clk_speed = I2C_MASTER_FREQ_HZ  // select frequency specific to your project
-    // .clk_flags = 0,          /*!< Optional, you can use I2C_SCLK_SRC_FLAG_* flags to choose i2c source clock here. */
-};
-int i2c_master_port = 0;
-
-void ssd1306_I2C_Init() {
-	esp_err_t i2c_err;
-    i2c_err = i2c_param_config(i2c_master_port,&i2c_conf);
-    if(i2c_err != ESP_OK) printf(" parameter config error code: %d \r\n",i2c_err);
-    i2c_err = i2c_driver_install(i2c_master_port,I2C_MODE_MASTER, 0,0, 0);
-    if(i2c_err != ESP_OK) printf(" driver install error code: %d \r\n ",i2c_err);   
-}
-
-void ssd1306_I2C_WriteMulti(uint8_t address, uint8_t reg, uint8_t* data, uint16_t count) {
-	// uint8_t dt[256];
-	// dt[0] = reg;
-	// uint8_t i;
-	// for(i = 0; i < count; i++)
-	// dt[i+1] = data[i];
-	// HAL_I2C_Master_Transmit(&hi2c1, address, dt, count+1, 10);
-	
-	i2c_cmd_handle_t cmd;
-    cmd = i2c_cmd_link_create(); 
-
-    i2c_master_start(cmd); //start I2C transaction
-    i2c_master_write_byte(cmd,address , true); //send Address with write Bit
-    i2c_master_write_byte(cmd,reg,1); //Send Register Address
-	//printf("length of tx data %d || Count in function %d \n ", sizeof(data), count);
-    
-	i2c_master_write(cmd, data,count,true);
-    i2c_master_stop(cmd);
-
-    i2c_master_cmd_begin(i2c_master_port,cmd, 50);
-    i2c_cmd_link_delete(cmd);
-}
-
-void ssd1306_I2C_Write(uint8_t address, uint8_t reg, uint8_t data) {
-	// uint8_t dt[2];
-	// dt[0] = reg;
-	// dt[1] = data;
-	// HAL_I2C_Master_Transmit(&hi2c1, address, dt, 2, 10);
-
-	i2c_cmd_handle_t cmd;
-    cmd = i2c_cmd_link_create(); 
-
-    i2c_master_start(cmd); //start I2C transaction
-    i2c_master_write_byte(cmd,address, true); //send Address with write Bit
-    i2c_master_write_byte(cmd,reg,1); //Send Register Address
-
-	i2c_master_write(cmd, &data, 1 ,true);
-    i2c_master_stop(cmd);
-
-    i2c_master_cmd_begin(i2c_master_port,cmd, 50);
-    i2c_cmd_link_delete(cmd);
+	const uint8_t commands[] = {0x8D, 0x10, 0xAE};
+	SSD1306_WRITECOMMANDS(commands);
 }
@@ -0,0 +1,86 @@
+#include "ssd1306_flush.h"
+#include "ssd1306_internal.h"
+#include "freertos/task.h"
+#include "freertos/event_groups.h"
+
+/* Flush task is waiting for a frame, front buffer may be swapped */
+#define SSD1306_FLUSH_IDLE_BIT        (1 << 0)
+
+/* Flush task state */
+static TaskHandle_t SSD1306_FlushTaskHandle;
+static EventGroupHandle_t SSD1306_FlushEvents;
+static volatile uint32_t SSD1306_SubmittedFrame;
+static volatile uint32_t SSD1306_FlushedFrame;
+
+static void SSD1306_FlushTask(void* arg) {
+	for (;;) {
+		ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+		
+		SSD1306_FlushFront();
+		SSD1306_FlushedFrame = SSD1306_SubmittedFrame;
+		
+		xEventGroupSetBits(SSD1306_FlushEvents, SSD1306_FLUSH_IDLE_BIT);
+	}
+}
+
+static void SSD1306_PresentAndWait(void) {
+	SSD1306_WaitFlushDone(SSD1306_SwapBuffers(portMAX_DELAY), portMAX_DELAY);
+}
+
+uint8_t SSD1306_StartFlushTask(UBaseType_t priority, BaseType_t core) {
+	if (SSD1306_FlushTaskHandle != NULL) {
+		return 1;
+	}
+	
+	SSD1306_FlushEvents = xEventGroupCreate();
+	if (SSD1306_FlushEvents == NULL) {
+		return 0;
+	}
+	xEventGroupSetBits(SSD1306_FlushEvents, SSD1306_FLUSH_IDLE_BIT);
+	
+	if (xTaskCreatePinnedToCore(SSD1306_FlushTask, "ssd1306_flush", 2048, NULL, priority, &SSD1306_FlushTaskHandle, core) != pdPASS) {
+		vEventGroupDelete(SSD1306_FlushEvents);
+		SSD1306_FlushEvents = NULL;
+		SSD1306_FlushTaskHandle = NULL;
+		return 0;
+	}
+	
+	/* From now on UpdateScreen goes through flush task */
+	SSD1306_SetPresenter(SSD1306_PresentAndWait);
+	
+	return 1;
+}
+
+uint32_t SSD1306_SwapBuffers(TickType_t wait) {
+	/* Front buffer can not be touched while it is being sent */
+	if ((xEventGroupWaitBits(SSD1306_FlushEvents, SSD1306_FLUSH_IDLE_BIT, pdTRUE, pdTRUE, wait) & SSD1306_FLUSH_IDLE_BIT) == 0) {
+		return 0;
+	}
+	
+	SSD1306_SwapFrames();
+	
+	SSD1306_SubmittedFrame++;
+	if (SSD1306_SubmittedFrame == 0) {
+		/* Zero is reserved for timeout */
+		SSD1306_SubmittedFrame = 1;
+	}
+	
+	xTaskNotifyGive(SSD1306_FlushTaskHandle);
+	
+	return SSD1306_SubmittedFrame;
+}
+
+uint8_t SSD1306_WaitFlushDone(uint32_t frame, TickType_t wait) {
+	if (SSD1306_FlushTaskHandle == NULL || frame == 0) {
+		return 0;
+	}
+	
+	/* Idle bit is cleared only by swap, so once it is set submitted frame has been flushed */
+	xEventGroupWaitBits(SSD1306_FlushEvents, SSD1306_FLUSH_IDLE_BIT, pdFALSE, pdTRUE, wait);
+	
+	return (int32_t)(SSD1306_FlushedFrame - frame) >= 0;
+}
+
+uint32_t SSD1306_GetFlushedFrame(void) {
+	return SSD1306_FlushedFrame;
+}
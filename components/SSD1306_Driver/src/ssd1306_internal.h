@@ -0,0 +1,27 @@
+#ifndef SSD1306_INTERNAL_H
+#define SSD1306_INTERNAL_H 100
+
+/* Shared between rendering core and flush task, not part of public API */
+
+#include "ssd1306.h"
+
+/* Number of 8-pixel pages */
+#define SSD1306_PAGES                 (SSD1306_HEIGHT / 8)
+/* Size of one frame in bytes */
+#define SSD1306_BUFFER_SIZE           (SSD1306_WIDTH * SSD1306_HEIGHT / 8)
+
+/* Called by SSD1306_UpdateScreen instead of flushing back buffer in caller */
+typedef void (*SSD1306_Presenter_t)(void);
+
+/* Installs presenter, NULL restores synchronous flush */
+void SSD1306_SetPresenter(SSD1306_Presenter_t presenter);
+
+/* Exchanges back and front buffer, front takes over dirty ranges of back,
+ * back keeps ranges drawn in submitted frame only.
+ * Caller must make sure front buffer is not being flushed. */
+void SSD1306_SwapFrames(void);
+
+/* Sends changed parts of front buffer to LCD */
+void SSD1306_FlushFront(void);
+
+#endif
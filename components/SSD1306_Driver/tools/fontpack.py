@@ -0,0 +1,99 @@
+#!/usr/bin/env python3
+#
+# Converts row-major uint16_t font tables into SSD1306 column-byte glyph tables.
+#
+# Every FontDef_t in the input which names a .packed table gets that table generated
+# from its .data rows. Glyphs are stored one after another, each glyph page by page
+# (8 pixel rows), each page as FontWidth bytes with bit 0 at the top, which is the
+# layout of the SSD1306 frame buffer.
+#
+# usage: fontpack.py <fonts.c> <output.c>
+#
+
+import re
+import sys
+
+TABLE_RE = re.compile(r"const\s+uint16_t\s+(\w+)\s*\[\s*\]\s*=\s*\{(.*?)\};", re.S)
+FONTDEF_RE = re.compile(r"FontDef_t\s+\w+\s*=\s*\{(.*?)\};", re.S)
+FIELD_RE = re.compile(r"\.(\w+)\s*=\s*([^,\n]+)")
+NUMBER_RE = re.compile(r"0[xX][0-9a-fA-F]+|\d+")
+
+
+def strip_comments(text):
+    text = re.sub(r"/\*.*?\*/", "", text, flags=re.S)
+    return re.sub(r"//[^\n]*", "", text)
+
+
+def parse_char(value):
+    value = value.strip()
+    if value.startswith("'"):
+        return ord(value[1:-1].encode().decode("unicode_escape"))
+    return int(value, 0)
+
+
+def pack_glyph(rows, width, height):
+    pages = (height + 7) // 8
+    out = []
+    for page in range(pages):
+        for col in range(width):
+            byte = 0
+            for bit in range(8):
+                row = page * 8 + bit
+                if row < height and (rows[row] << col) & 0x8000:
+                    byte |= 1 << bit
+            out.append(byte)
+    return out
+
+
+def main():
+    if len(sys.argv) != 3:
+        sys.exit("usage: fontpack.py <fonts.c> <output.c>")
+
+    with open(sys.argv[1]) as f:
+        source = strip_comments(f.read())
+
+    tables = {}
+    for name, body in TABLE_RE.findall(source):
+        tables[name] = [int(n, 0) for n in NUMBER_RE.findall(body)]
+
+    lines = [
+        "/* Generated by tools/fontpack.py from %s, do not edit */" % sys.argv[1].replace("\\", "/").split("/")[-1],
+        "",
+        "#include \"fonts.h\"",
+    ]
+
+    for body in FONTDEF_RE.findall(source):
+        fields = {k: v.strip() for k, v in FIELD_RE.findall(body)}
+        if "packed" not in fields or fields["packed"] == "NULL":
+            continue
+
+        data = tables[fields["data"]]
+        width = int(fields["FontWidth"], 0)
+        height = int(fields["FontHeight"], 0)
+        first = parse_char(fields["FirstChar"])
+        last = parse_char(fields["LastChar"])
+        count = last - first + 1
+
+        if width > 16:
+            sys.exit("%s: row-major tables hold at most 16 columns" % fields["data"])
+        if len(data) < count * height:
+            sys.exit("%s: %d rows, %d expected" % (fields["data"], len(data), count * height))
+
+        glyph_size = ((height + 7) // 8) * width
+        lines += [
+            "",
+            "/* %dx%d, characters %d..%d, %d bytes per glyph */" % (width, height, first, last, glyph_size),
+            "const uint8_t %s[%d] = {" % (fields["packed"], count * glyph_size),
+        ]
+        for g in range(count):
+            glyph = pack_glyph(data[g * height:(g + 1) * height], width, height)
+            ch = {" ": "space", "\\": "backslash"}.get(chr(first + g), chr(first + g))
+            lines.append("\t" + ",".join("0x%02X" % b for b in glyph) + ", // " + ch)
+        lines.append("};")
+
+    with open(sys.argv[2], "w") as f:
+        f.write("\n".join(lines) + "\n")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,319 @@
+// Benchmark of the sample codec on host.
+//
+// Each trace is cut into blocks of at most BENCH_BLOCK_BYTES, the payload
+// limit of a journal record, or of a time span where the journal closes blocks
+// by age, chained as the journal chains them, then decoded again and compared.
+// A chained trace is also decoded with its second block dropped, which must
+// stop the blocks continuing it. Exits with 1 on any mismatch. Prints the
+// encoded bytes per sample, the flash bytes per sample with the journal record
+// header of every block, the ratio against the raw record the trace replaces
+// and the encode and decode time per sample.
+//
+// The built-in traces are generated to match the device: decimated and
+// per-cycle BME690 samples in parallel mode and 400 Hz accelerometer frames
+// around a fall. A CSV file (time,value,... one sample per line, no key
+// channel) can be given to measure a recorded trace instead.
+//
+// Usage: sample_codec_bench [trace.csv]
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "sample_codec.h"
+
+#define BENCH_BLOCK_BYTES   248     // JOURNAL_MAX_PAYLOAD
+#define BENCH_RECORD_HDR    12      // journal_rec_hdr_t
+#define BENCH_MAX_SAMPLES   200000
+#define BENCH_ROUNDS        20      // Timing repeats
+
+typedef struct {
+    const char *name;
+    codec_layout_t layout;
+    double raw_bytes;           // Per sample in the format the codec replaces
+    uint32_t block_ms;          // Blocks close once their newest sample is this much younger, 0 for none
+    uint8_t chain;              // Continued blocks after each self-contained one
+    size_t count;
+    uint32_t *time;
+    int32_t (*values)[CODEC_MAX_CHANNELS];
+} trace_t;
+
+static double gauss(void) {
+    double u = (rand() + 1.0) / (RAND_MAX + 2.0), v = (rand() + 1.0) / (RAND_MAX + 2.0);
+    return sqrt(-2 * log(u)) * cos(2 * M_PI * v);
+}
+
+static void trace_alloc(trace_t *t, size_t count) {
+    t->count = count;
+    t->time = malloc(count * sizeof(*t->time));
+    t->values = malloc(count * sizeof(*t->values));
+    if (t->time == NULL || t->values == NULL) {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+    }
+}
+
+// Channels as sensor_logic.c journals them: step (key), status, 0.01 degC, Pa,
+// milli-%RH, gas Ohm keyed by heater step. Cycle is the TPHG cycle in ms,
+// interval the decimation, 0 for every sample. Decimated samples stay on the
+// heater step of the first one, as sensor_logic.c takes them.
+static void gen_env(trace_t *t, size_t count, uint32_t cycle_ms, uint32_t interval_ms) {
+    // Clean-air resistance per step of the main.c heater profile, Ohm
+    static const double gas_base[10] = {12000, 310000, 420000, 520000, 90000, 85000, 82000, 14000, 13500, 13200};
+    double temp = 2450, press = 101325, hum = 45000, drift = 1.0;
+    uint32_t time = 1000, next = 0;
+    size_t n = 0;
+    int step = 0, journal_step = -1;
+
+    trace_alloc(t, count);
+    t->layout = (codec_layout_t){.channels = 6, .key_channel = 0, .keyed_mask = 1 << 5};
+    t->raw_bytes = BENCH_RECORD_HDR + 16;   // journal_sample_t record
+
+    while (n < count) {
+        // Slow random walks with sensor noise on top
+        temp += gauss() * 0.3;
+        press += gauss() * 0.4;
+        hum += gauss() * 4;
+        drift += gauss() * 0.0002;
+        time += cycle_ms + (rand() % 3) - 1;
+        step = (step + 1) % 10;
+
+        if (interval_ms == 0 || (time >= next && (journal_step < 0 || step == journal_step))) {
+            journal_step = step;
+            t->time[n] = time;
+            t->values[n][0] = step;
+            t->values[n][1] = 0xB0;     // new_data, gas_valid, heat_stab
+            t->values[n][2] = (int32_t)lround(temp + gauss() * 1.5);
+            t->values[n][3] = (int32_t)lround(press + gauss() * 2);
+            t->values[n][4] = (int32_t)lround(hum + gauss() * 40);
+            t->values[n][5] = (int32_t)lround(gas_base[step] * drift * (1 + gauss() * 0.003));
+            n++;
+            next = time + interval_ms;
+        }
+    }
+}
+
+// x, y, z at 8 g (4096 LSB/g), time in us. Walking with a fall every 20 s:
+// 400 ms free fall, an impact and lying on the side.
+static void gen_accel(trace_t *t, size_t count) {
+    const double g = 4096, period_us = 2500;
+
+    trace_alloc(t, count);
+    t->layout = (codec_layout_t){.channels = 3, .key_channel = -1};
+    t->raw_bytes = 6;                       // imu_vec_t in journal_imu_t
+
+    for (size_t n = 0; n < count; n++) {
+        double s = fmod(n * period_us / 1e6, 20.0), a[3];
+
+        if (s < 15) {
+            double phase = 2 * M_PI * 1.8 * s;
+            a[0] = 0.15 * g * sin(phase);
+            a[1] = 0.05 * g * sin(phase / 2);
+            a[2] = g + 0.3 * g * sin(phase);
+        } else if (s < 15.4) {
+            a[0] = a[1] = a[2] = 0.05 * g;
+        } else if (s < 15.45) {
+            a[0] = 2 * g;
+            a[1] = -1.5 * g;
+            a[2] = 5.5 * g * sin(M_PI * (s - 15.4) / 0.05);
+        } else {
+            a[0] = g;
+            a[1] = 0.1 * g;
+            a[2] = 0.05 * g;
+        }
+        t->time[n] = (uint32_t)(n * period_us);
+        for (int c = 0; c < 3; c++) {
+            t->values[n][c] = (int32_t)lround(a[c] + gauss() * 12);
+        }
+    }
+}
+
+static bool load_csv(trace_t *t, const char *path) {
+    FILE *f = fopen(path, "r");
+    char line[512];
+    size_t n = 0;
+
+    if (f == NULL) {
+        perror(path);
+        return false;
+    }
+    trace_alloc(t, BENCH_MAX_SAMPLES);
+    t->name = path;
+    t->layout = (codec_layout_t){.channels = 0, .key_channel = -1};
+
+    while (n < BENCH_MAX_SAMPLES && fgets(line, sizeof(line), f) != NULL) {
+        char *p = line, *end;
+        int c = 0;
+
+        t->time[n] = (uint32_t)strtoul(p, &end, 10);
+        if (end == p) {
+            continue;           // Header or blank line
+        }
+        for (p = end; *p == ',' && c < CODEC_MAX_CHANNELS; p = end) {
+            t->values[n][c++] = (int32_t)strtol(p + 1, &end, 10);
+        }
+        if (t->layout.channels == 0) {
+            t->layout.channels = c;
+        }
+        if (c == t->layout.channels && c > 0) {
+            n++;
+        }
+    }
+    fclose(f);
+    t->count = n;
+    t->raw_bytes = 4 + 4.0 * t->layout.channels;
+    return n > 0;
+}
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void close_block(codec_encoder_t *enc, uint8_t *out, size_t *total, size_t *ends, size_t *blocks) {
+    *total += codec_encoder_finish(enc, &out[*total], BENCH_BLOCK_BYTES);
+    if (ends != NULL) {
+        ends[*blocks] = *total;
+    }
+    (*blocks)++;
+}
+
+// Encodes the whole trace into out, returns the bytes, blocks counts the blocks
+// and ends, when given, gets the end offset of each
+static size_t encode(const trace_t *t, uint8_t *out, size_t *blocks, size_t *ends) {
+    static codec_encoder_t enc;
+    size_t total = 0;
+
+    *blocks = 0;
+    codec_encoder_init(&enc, &t->layout, BENCH_BLOCK_BYTES);
+    codec_encoder_chain(&enc, t->chain);
+    for (size_t i = 0; i < t->count; i++) {
+        if (!codec_encoder_add(&enc, t->time[i], t->values[i])) {
+            close_block(&enc, out, &total, ends, blocks);
+            codec_encoder_add(&enc, t->time[i], t->values[i]);
+        }
+        if (t->block_ms > 0 && t->time[i] - enc.time0 >= t->block_ms) {
+            close_block(&enc, out, &total, ends, blocks);
+        }
+    }
+    if (enc.count > 0) {
+        close_block(&enc, out, &total, ends, blocks);
+    }
+    return total;
+}
+
+// Decodes block after block, returns the samples matching the trace
+static size_t decode(const trace_t *t, const uint8_t *in, size_t len) {
+    codec_decoder_t dec = {0};
+    size_t pos = 0, n = 0;
+    int32_t values[CODEC_MAX_CHANNELS];
+    uint32_t time;
+
+    while (pos < len && codec_decoder_continue(&dec, &in[pos], len - pos)) {
+        while (codec_decoder_next(&dec, &time, values)) {
+            if (n >= t->count || time != t->time[n] ||
+                memcmp(values, t->values[n], t->layout.channels * sizeof(int32_t)) != 0) {
+                return n;
+            }
+            n++;
+        }
+        pos += (dec.bit + 7) / 8;
+    }
+    return n;
+}
+
+// Drops the second block of a chained trace. The continued blocks after it
+// must not decode, the next self-contained block and all after it must.
+static bool lose_block(const trace_t *t, const uint8_t *out, const size_t *ends, size_t blocks) {
+    codec_decoder_t dec = {0};
+    int32_t values[CODEC_MAX_CHANNELS];
+    uint32_t time;
+    size_t n = 0;
+
+    for (size_t b = 0; b < blocks; b++) {
+        const uint8_t *block = b > 0 ? &out[ends[b - 1]] : out;
+        size_t len = ends[b] - (b > 0 ? ends[b - 1] : 0);
+        uint16_t count = (block[0] & CODEC_CONTINUED) ? block[2] : block[3];
+        bool lost = b >= 1 && b <= t->chain;
+
+        if (b != 1 && codec_decoder_continue(&dec, block, len) == lost) {
+            return false;
+        }
+        for (uint16_t i = 0; i < count; i++, n++) {
+            if (!lost && (!codec_decoder_next(&dec, &time, values) || time != t->time[n] ||
+                          memcmp(values, t->values[n], t->layout.channels * sizeof(int32_t)) != 0)) {
+                return false;
+            }
+        }
+    }
+    return n == t->count;
+}
+
+static bool run(const trace_t *t) {
+    uint8_t *out = malloc(t->count * (CODEC_MAX_CHANNELS + 1) * 6 + BENCH_BLOCK_BYTES);
+    size_t *ends = malloc(t->count * sizeof(*ends));
+    size_t blocks = 0, bytes = 0, decoded = 0;
+    uint64_t start, enc_ns, dec_ns;
+    bool chain_ok = true;
+
+    start = now_ns();
+    for (int r = 0; r < BENCH_ROUNDS; r++) {
+        bytes = encode(t, out, &blocks, NULL);
+    }
+    enc_ns = now_ns() - start;
+    start = now_ns();
+    for (int r = 0; r < BENCH_ROUNDS; r++) {
+        decoded = decode(t, out, bytes);
+    }
+    dec_ns = now_ns() - start;
+    if (t->chain > 0) {
+        encode(t, out, &blocks, ends);
+        chain_ok = blocks > t->chain + 1u && lose_block(t, out, ends, blocks);
+    }
+    free(out);
+    free(ends);
+
+    double per_sample = (double)bytes / t->count;
+    double flash = (double)(bytes + blocks * BENCH_RECORD_HDR) / t->count;
+    printf("%-14s %8zu %9.2f %9.2f %9.1f %7.1fx %8.1f %8.1f %s\n", t->name, t->count, per_sample, flash,
+           t->raw_bytes, t->raw_bytes / flash, (double)enc_ns / BENCH_ROUNDS / t->count,
+           (double)dec_ns / BENCH_ROUNDS / t->count,
+           decoded != t->count ? "MISMATCH" : !chain_ok ? "CHAIN" : "ok");
+    return decoded == t->count && chain_ok;
+}
+
+int main(int argc, char **argv) {
+    trace_t traces[5] = {0};
+    size_t count = 0;
+    bool ok = true;
+
+    srand(1);
+    if (argc > 1) {
+        if (!load_csv(&traces[count++], argv[1])) {
+            fprintf(stderr, "%s: no samples\n", argv[1]);
+            return 1;
+        }
+    } else {
+        traces[count].name = "env_10s";
+        gen_env(&traces[count++], 8640, 140, 10000);   // One day at the journal rate
+        traces[count].name = "env_10s_1min";
+        traces[count].block_ms = 60000;                 // sensor_logic.c SENSOR_JOURNAL_BLOCK_MS
+        traces[count].chain = 9;                        // SENSOR_JOURNAL_KEY_BLOCKS - 1
+        gen_env(&traces[count++], 8640, 140, 10000);
+        traces[count].name = "env_cycle";
+        gen_env(&traces[count++], 20000, 140, 0);
+        traces[count].name = "accel_400hz";
+        gen_accel(&traces[count++], 40000);
+    }
+
+    printf("%-14s %8s %9s %9s %9s %8s %8s %8s\n", "trace", "samples", "B/sample", "flash B", "raw B",
+           "ratio", "enc ns", "dec ns");
+    for (size_t i = 0; i < count; i++) {
+        ok &= run(&traces[i]);
+        free(traces[i].time);
+        free(traces[i].values);
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,120 @@
+#ifndef SAMPLE_CODEC_H
+#define SAMPLE_CODEC_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Lossless block codec for time series of fixed-point integer samples.
+// Plain C without ESP-IDF dependencies, host/ builds it natively with a benchmark.
+//
+// A sample is a uint32_t time (any unit, e.g. ms) and up to CODEC_MAX_CHANNELS
+// int32_t values. A block starts with a header holding the layout, the sample
+// count, the first sample and the first interval as zig-zag varints. The
+// remaining samples follow as a bit stream:
+//   time:    delta-of-delta against the previous interval
+//   values:  delta against the previous value of the channel, or for keyed
+//            channels against the last sample with the same key (e.g. the
+//            gas resistance of the same heater step)
+// Every delta is zig-zag mapped and stored in the block's base width for its
+// channel, the encoder picks the width that gives the smallest block:
+//   '0' + width bits            delta fits the base width
+//   '1' + 5 bits (len - 1) + len bits   escape for outliers
+// Self-contained blocks decode on their own, a lost block does not affect its
+// neighbours. A continued block leaves out the layout and the first sample and
+// codes all its samples against the state the previous block ended with, time,
+// interval, values and keyed references. It decodes only after the blocks
+// before it, back to a self-contained one. Its header is the version byte with
+// CODEC_CONTINUED set, its place after the self-contained block, so a missing
+// block stops decoding, and the sample count. Each base width is a flag bit,
+// set when a new width follows and clear to keep the previous block's.
+
+#define CODEC_MAX_CHANNELS  8
+#define CODEC_MAX_KEYS      16      // Key values are taken modulo this
+#define CODEC_BLOCK_MAX     64      // Samples per block
+#define CODEC_VERSION       1
+#define CODEC_CONTINUED     0x80    // In the version byte of a continued block
+
+typedef struct {
+    uint8_t channels;           // 1..CODEC_MAX_CHANNELS
+    int8_t key_channel;         // Channel selecting the reference of keyed channels, -1 for none
+    uint8_t keyed_mask;         // Bit per channel, all after key_channel
+} codec_layout_t;
+
+// Encoder state, owned by the caller. No allocation, samples are kept as
+// zig-zag deltas until codec_encoder_finish().
+typedef struct {
+    codec_layout_t layout;
+    size_t max_bytes;           // Block size limit
+    uint16_t count;
+    uint8_t chain;              // Continued blocks after each self-contained one
+    uint8_t until_key;          // Continued blocks left before the next self-contained one
+    bool continued;             // The open block continues the previous one
+
+    uint32_t time0;             // First sample of the block, also when continued
+    int32_t interval0;
+    int32_t values0[CODEC_MAX_CHANNELS];
+    uint32_t last_time;
+    int32_t last_interval;
+    int32_t last_values[CODEC_MAX_CHANNELS];
+    int32_t key_ref[CODEC_MAX_KEYS][CODEC_MAX_CHANNELS];
+    uint16_t key_seen;          // Bit per key slot, key_ref valid
+    uint8_t width[CODEC_MAX_CHANNELS + 1];          // Of the last block, continued blocks may repeat them
+
+    // Channel 0 is the time, then the values
+    uint32_t zz[CODEC_BLOCK_MAX][CODEC_MAX_CHANNELS + 1];
+    uint16_t len_hist[CODEC_MAX_CHANNELS + 1][33];  // Deltas per bit length
+} codec_encoder_t;
+
+// Streaming decoder over one block, samples come out one at a time
+typedef struct {
+    const uint8_t *buf;
+    size_t len;
+    size_t bit;                 // Read position in bits
+    codec_layout_t layout;
+    uint16_t count;
+    uint16_t index;
+    bool continued;
+    uint8_t link;               // Blocks since the self-contained one
+    uint8_t width[CODEC_MAX_CHANNELS + 1];
+
+    uint32_t time;
+    int32_t interval;
+    int32_t values[CODEC_MAX_CHANNELS];
+    int32_t key_ref[CODEC_MAX_KEYS][CODEC_MAX_CHANNELS];
+    uint16_t key_seen;
+} codec_decoder_t;
+
+// False when the layout is invalid. Every block is self-contained until
+// codec_encoder_chain() is called.
+bool codec_encoder_init(codec_encoder_t *enc, const codec_layout_t *layout, size_t max_bytes);
+
+// Lets up to blocks continued blocks follow each self-contained one, 0 for
+// none. The next block is self-contained, so this is also how to restart the
+// chain after a block got lost. Call it between blocks.
+void codec_encoder_chain(codec_encoder_t *enc, uint8_t blocks);
+
+// Adds a sample, false (and nothing added) when the block is full or would
+// exceed max_bytes. values holds layout.channels entries.
+bool codec_encoder_add(codec_encoder_t *enc, uint32_t time, const int32_t *values);
+
+// Bytes codec_encoder_finish() would write now
+size_t codec_encoder_size(const codec_encoder_t *enc);
+
+// Writes the block and starts a new one. Returns the block size, 0 when the
+// encoder is empty or cap is too small.
+size_t codec_encoder_finish(codec_encoder_t *enc, uint8_t *out, size_t cap);
+
+// Parses the header of a self-contained block, false when it is malformed or
+// the block is continued
+bool codec_decoder_init(codec_decoder_t *dec, const uint8_t *buf, size_t len);
+
+// Parses the header of the next block in a chain. A continued block takes
+// over the state of dec, which must have returned every sample of the previous
+// block; a self-contained one starts over as codec_decoder_init().
+bool codec_decoder_continue(codec_decoder_t *dec, const uint8_t *buf, size_t len);
+
+// Next sample of the block, false at the end or on truncated data
+bool codec_decoder_next(codec_decoder_t *dec, uint32_t *time, int32_t *values);
+
+#endif // SAMPLE_CODEC_H
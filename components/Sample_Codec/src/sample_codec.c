@@ -0,0 +1,483 @@
+#include "sample_codec.h"
+#include <string.h>
+
+#define CODEC_WIDTH_BITS    6       // Base width 0..32 in the block header
+#define CODEC_ESC_LEN_BITS  5       // Escaped length 1..32
+#define CODEC_HEADER_FIXED  4       // Version, channels and key channel, keyed mask, count
+#define CODEC_HEADER_CONT   3       // Version with CODEC_CONTINUED, place in the chain, count
+
+static inline uint32_t zigzag(int32_t v) {
+    return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);
+}
+
+static inline int32_t unzigzag(uint32_t v) {
+    return (int32_t)(v >> 1) ^ -(int32_t)(v & 1);
+}
+
+static inline unsigned bit_len(uint32_t v) {
+    return v == 0 ? 0 : 32 - __builtin_clz(v);
+}
+
+static inline size_t varint_len(uint32_t v) {
+    size_t n = 1;
+
+    while (v >= 0x80) {
+        v >>= 7;
+        n++;
+    }
+    return n;
+}
+
+static inline uint32_t key_slot(const codec_layout_t *layout, const int32_t *values) {
+    return layout->key_channel >= 0 ? (uint32_t)values[layout->key_channel] % CODEC_MAX_KEYS : 0;
+}
+
+static inline bool is_keyed(const codec_layout_t *layout, int c) {
+    return (layout->keyed_mask >> c) & 1;
+}
+
+// Base width with the fewest bits for a channel, escapes included
+static unsigned best_width(const uint16_t *hist, uint32_t *bits) {
+    uint32_t escaped = 0, fits = hist[0];
+    unsigned best = 0;
+
+    for (unsigned l = 1; l <= 32; l++) {
+        escaped += hist[l] * (1 + CODEC_ESC_LEN_BITS + l);
+    }
+    *bits = fits + escaped;
+    for (unsigned w = 1; w <= 32; w++) {
+        fits += hist[w];
+        escaped -= hist[w] * (1 + CODEC_ESC_LEN_BITS + w);
+        uint32_t cost = fits * (1 + w) + escaped;
+        if (cost < *bits) {
+            *bits = cost;
+            best = w;
+        }
+    }
+    return best;
+}
+
+// Bits of a channel's deltas at base width w, escapes included
+static uint32_t width_cost(const uint16_t *hist, unsigned w) {
+    uint32_t bits = 0;
+
+    for (unsigned l = 0; l <= 32; l++) {
+        bits += hist[l] * (l <= w ? 1 + w : 1 + CODEC_ESC_LEN_BITS + l);
+    }
+    return bits;
+}
+
+// Base width of channel c in the open block, bits counts the width field too.
+// A continued block repeats the width of the previous block in one bit when
+// a new width would not save its field.
+static unsigned block_width(const codec_encoder_t *enc, int c, uint32_t *bits) {
+    unsigned best = best_width(enc->len_hist[c], bits);
+
+    if (!enc->continued) {
+        *bits += CODEC_WIDTH_BITS;
+        return best;
+    }
+    uint32_t repeat = width_cost(enc->len_hist[c], enc->width[c]);
+    if (repeat <= *bits + CODEC_WIDTH_BITS) {
+        *bits = 1 + repeat;
+        return enc->width[c];
+    }
+    *bits += 1 + CODEC_WIDTH_BITS;
+    return best;
+}
+
+static size_t header_size(const codec_encoder_t *enc) {
+    if (enc->continued) {
+        return CODEC_HEADER_CONT;
+    }
+    size_t n = CODEC_HEADER_FIXED + varint_len(enc->time0);
+
+    if (enc->count > 1) {
+        n += varint_len(zigzag(enc->interval0));
+    }
+
+    for (int c = 0; c < enc->layout.channels; c++) {
+        n += varint_len(zigzag(enc->values0[c]));
+    }
+    return n;
+}
+
+static void reset(codec_encoder_t *enc) {
+    enc->count = 0;
+    memset(enc->len_hist, 0, sizeof(enc->len_hist));
+}
+
+bool codec_encoder_init(codec_encoder_t *enc, const codec_layout_t *layout, size_t max_bytes) {
+    if (layout->channels == 0 || layout->channels > CODEC_MAX_CHANNELS ||
+        layout->key_channel >= layout->channels || layout->key_channel < -1 ||
+        (layout->keyed_mask >> layout->channels) != 0 ||
+        (layout->keyed_mask != 0 && layout->key_channel < 0) ||
+        (layout->key_channel >= 0 && (layout->keyed_mask & ((2u << layout->key_channel) - 1)) != 0)) {
+        return false;
+    }
+    enc->layout = *layout;
+    enc->max_bytes = max_bytes;
+    enc->chain = 0;
+    enc->until_key = 0;
+    reset(enc);
+    return true;
+}
+
+void codec_encoder_chain(codec_encoder_t *enc, uint8_t blocks) {
+    enc->chain = blocks;
+    enc->until_key = 0;
+}
+
+size_t codec_encoder_size(const codec_encoder_t *enc) {
+    if (enc->count == 0) {
+        return 0;
+    }
+    uint32_t bits = 0;
+
+    for (int c = 0; c <= enc->layout.channels; c++) {
+        uint32_t channel_bits;
+        block_width(enc, c, &channel_bits);
+        bits += channel_bits;
+    }
+    return header_size(enc) + (bits + 7) / 8;
+}
+
+static void remember(codec_encoder_t *enc, uint32_t time, const int32_t *values) {
+    uint32_t key = key_slot(&enc->layout, values);
+    size_t size = enc->layout.channels * sizeof(int32_t);
+
+    enc->last_time = time;
+    memcpy(enc->last_values, values, size);
+    memcpy(enc->key_ref[key], values, size);
+    enc->key_seen |= 1u << key;
+}
+
+bool codec_encoder_add(codec_encoder_t *enc, uint32_t time, const int32_t *values) {
+    const codec_layout_t *layout = &enc->layout;
+
+    if (enc->count == 0) {
+        enc->continued = enc->until_key > 0;
+        enc->time0 = time;
+    }
+    // A self-contained block holds its first sample in the header
+    if (enc->count == 0 && !enc->continued) {
+        memcpy(enc->values0, values, layout->channels * sizeof(int32_t));
+        if (header_size(enc) + ((layout->channels + 1) * CODEC_WIDTH_BITS + 7) / 8 > enc->max_bytes) {
+            return false;
+        }
+        enc->last_interval = 0;
+        enc->key_seen = 0;
+        remember(enc, time, values);
+        enc->count = 1;
+        return true;
+    }
+    if (enc->count == CODEC_BLOCK_MAX) {
+        return false;
+    }
+
+    uint32_t *row = enc->zz[enc->count];
+    uint32_t key = key_slot(layout, values);
+    bool seen = (enc->key_seen >> key) & 1;
+    int32_t interval = (int32_t)(time - enc->last_time);
+
+    // The first interval goes into the header, later ones are delta-of-delta against it
+    if (enc->count == 1 && !enc->continued) {
+        enc->interval0 = interval;
+        enc->last_interval = interval;
+    }
+
+    row[0] = zigzag((int32_t)((uint32_t)interval - (uint32_t)enc->last_interval));
+    for (int c = 0; c < layout->channels; c++) {
+        int32_t ref = is_keyed(layout, c) && seen ? enc->key_ref[key][c] : enc->last_values[c];
+        row[c + 1] = zigzag((int32_t)((uint32_t)values[c] - (uint32_t)ref));
+    }
+
+    for (int c = 0; c <= layout->channels; c++) {
+        enc->len_hist[c][bit_len(row[c])]++;
+    }
+    enc->count++;
+    bool fits = codec_encoder_size(enc) <= enc->max_bytes;
+    enc->count--;
+    if (!fits) {
+        for (int c = 0; c <= layout->channels; c++) {
+            enc->len_hist[c][bit_len(row[c])]--;
+        }
+        return false;
+    }
+
+    enc->last_interval = interval;
+    remember(enc, time, values);
+    enc->count++;
+    return true;
+}
+
+static size_t put_varint(uint8_t *out, uint32_t v) {
+    size_t n = 0;
+
+    while (v >= 0x80) {
+        out[n++] = (uint8_t)(v | 0x80);
+        v >>= 7;
+    }
+    out[n++] = (uint8_t)v;
+    return n;
+}
+
+// MSB first into a zeroed buffer
+static void put_bits(uint8_t *out, size_t *bit, uint32_t v, unsigned n) {
+    while (n > 0) {
+        unsigned room = 8 - (*bit & 7);
+        unsigned take = n < room ? n : room;
+        uint32_t chunk = (v >> (n - take)) & ((1u << take) - 1);
+
+        out[*bit >> 3] |= (uint8_t)(chunk << (room - take));
+        *bit += take;
+        n -= take;
+    }
+}
+
+size_t codec_encoder_finish(codec_encoder_t *enc, uint8_t *out, size_t cap) {
+    const codec_layout_t *layout = &enc->layout;
+    size_t size = codec_encoder_size(enc);
+    uint8_t width[CODEC_MAX_CHANNELS + 1];
+
+    if (size == 0 || size > cap) {
+        return 0;
+    }
+
+    size_t n = 0;
+    if (enc->continued) {
+        out[n++] = CODEC_VERSION | CODEC_CONTINUED;
+        out[n++] = (uint8_t)(enc->chain - enc->until_key + 1);
+        out[n++] = (uint8_t)enc->count;
+    } else {
+        out[n++] = CODEC_VERSION;
+        out[n++] = (uint8_t)(layout->channels | ((layout->key_channel + 1) << 4));
+        out[n++] = layout->keyed_mask;
+        out[n++] = (uint8_t)enc->count;
+        n += put_varint(&out[n], enc->time0);
+        if (enc->count > 1) {
+            n += put_varint(&out[n], zigzag(enc->interval0));
+        }
+        for (int c = 0; c < layout->channels; c++) {
+            n += put_varint(&out[n], zigzag(enc->values0[c]));
+        }
+    }
+
+    uint8_t *bits = &out[n];
+    size_t bit = 0;
+    memset(bits, 0, size - n);
+    for (int c = 0; c <= layout->channels; c++) {
+        uint32_t unused;
+        width[c] = block_width(enc, c, &unused);
+        if (!enc->continued) {
+            put_bits(bits, &bit, width[c], CODEC_WIDTH_BITS);
+        } else if (width[c] == enc->width[c]) {
+            put_bits(bits, &bit, 0, 1);
+        } else {
+            put_bits(bits, &bit, 1, 1);
+            put_bits(bits, &bit, width[c], CODEC_WIDTH_BITS);
+        }
+    }
+    for (uint16_t i = enc->continued ? 0 : 1; i < enc->count; i++) {
+        for (int c = 0; c <= layout->channels; c++) {
+            uint32_t v = enc->zz[i][c];
+            unsigned len = bit_len(v);
+            if (len <= width[c]) {
+                put_bits(bits, &bit, 0, 1);
+                put_bits(bits, &bit, v, width[c]);
+            } else {
+                put_bits(bits, &bit, 1, 1);
+                put_bits(bits, &bit, len - 1, CODEC_ESC_LEN_BITS);
+                put_bits(bits, &bit, v, len);
+            }
+        }
+    }
+
+    memcpy(enc->width, width, sizeof(width));
+    enc->until_key = enc->continued ? enc->until_key - 1 : enc->chain;
+    reset(enc);
+    return size;
+}
+
+static bool get_varint(codec_decoder_t *dec, size_t *pos, uint32_t *v) {
+    uint32_t result = 0;
+
+    for (unsigned shift = 0; shift < 35; shift += 7) {
+        if (*pos >= dec->len) {
+            return false;
+        }
+        uint8_t b = dec->buf[(*pos)++];
+        result |= (uint32_t)(b & 0x7F) << shift;
+        if ((b & 0x80) == 0) {
+            *v = result;
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool get_bits(codec_decoder_t *dec, unsigned n, uint32_t *v) {
+    uint32_t result = 0;
+
+    if (dec->bit + n > dec->len * 8) {
+        return false;
+    }
+    while (n > 0) {
+        unsigned room = 8 - (dec->bit & 7);
+        unsigned take = n < room ? n : room;
+        uint8_t b = dec->buf[dec->bit >> 3];
+
+        result = (result << take) | ((b >> (room - take)) & ((1u << take) - 1));
+        dec->bit += take;
+        n -= take;
+    }
+    *v = result;
+    return true;
+}
+
+static bool get_delta(codec_decoder_t *dec, unsigned width, uint32_t *v) {
+    uint32_t escape, len;
+
+    if (!get_bits(dec, 1, &escape)) {
+        return false;
+    }
+    if (!escape) {
+        return get_bits(dec, width, v);
+    }
+    return get_bits(dec, CODEC_ESC_LEN_BITS, &len) && get_bits(dec, len + 1, v);
+}
+
+static void decoder_remember(codec_decoder_t *dec) {
+    uint32_t key = key_slot(&dec->layout, dec->values);
+
+    memcpy(dec->key_ref[key], dec->values, dec->layout.channels * sizeof(int32_t));
+    dec->key_seen |= 1u << key;
+}
+
+// A continued block flags each width, clear keeps the previous block's
+static bool get_widths(codec_decoder_t *dec) {
+    uint32_t v, changed = 1;
+
+    for (int c = 0; c <= dec->layout.channels; c++) {
+        if (dec->continued && !get_bits(dec, 1, &changed)) {
+            return false;
+        }
+        if (!changed) {
+            continue;
+        }
+        if (!get_bits(dec, CODEC_WIDTH_BITS, &v) || v > 32) {
+            return false;
+        }
+        dec->width[c] = (uint8_t)v;
+    }
+    return true;
+}
+
+bool codec_decoder_init(codec_decoder_t *dec, const uint8_t *buf, size_t len) {
+    size_t pos = CODEC_HEADER_FIXED;
+    uint32_t v;
+
+    memset(dec, 0, sizeof(*dec));
+    if (len < CODEC_HEADER_FIXED || buf[0] != CODEC_VERSION) {
+        return false;
+    }
+    dec->buf = buf;
+    dec->len = len;
+    dec->layout.channels = buf[1] & 0x0F;
+    dec->layout.key_channel = (int8_t)(buf[1] >> 4) - 1;
+    dec->layout.keyed_mask = buf[2];
+    dec->count = buf[3];
+    if (dec->layout.channels == 0 || dec->layout.channels > CODEC_MAX_CHANNELS ||
+        dec->layout.key_channel >= dec->layout.channels || (dec->layout.keyed_mask >> dec->layout.channels) != 0 ||
+        (dec->layout.key_channel < 0 ? dec->layout.keyed_mask != 0
+                                     : (dec->layout.keyed_mask & ((2u << dec->layout.key_channel) - 1)) != 0) ||
+        dec->count == 0 || dec->count > CODEC_BLOCK_MAX) {
+        return false;
+    }
+
+    if (!get_varint(dec, &pos, &dec->time)) {
+        return false;
+    }
+    if (dec->count > 1) {
+        if (!get_varint(dec, &pos, &v)) {
+            return false;
+        }
+        dec->interval = unzigzag(v);
+    }
+    for (int c = 0; c < dec->layout.channels; c++) {
+        if (!get_varint(dec, &pos, &v)) {
+            return false;
+        }
+        dec->values[c] = unzigzag(v);
+    }
+
+    dec->bit = pos * 8;
+    return get_widths(dec);
+}
+
+bool codec_decoder_continue(codec_decoder_t *dec, const uint8_t *buf, size_t len) {
+    if (len < CODEC_HEADER_CONT || buf[0] != (CODEC_VERSION | CODEC_CONTINUED)) {
+        return codec_decoder_init(dec, buf, len);
+    }
+    // The previous block must be the one before in the chain and have ended
+    // cleanly, else its state is not the encoder's
+    if (dec->count == 0 || dec->index != dec->count || buf[1] != dec->link + 1 ||
+        buf[2] == 0 || buf[2] > CODEC_BLOCK_MAX) {
+        dec->count = 0;
+        return false;
+    }
+    dec->buf = buf;
+    dec->len = len;
+    dec->link = buf[1];
+    dec->count = buf[2];
+    dec->index = 0;
+    dec->continued = true;
+    dec->bit = CODEC_HEADER_CONT * 8;
+    if (!get_widths(dec)) {
+        dec->count = 0;
+        return false;
+    }
+    return true;
+}
+
+bool codec_decoder_next(codec_decoder_t *dec, uint32_t *time, int32_t *values) {
+    const codec_layout_t *layout = &dec->layout;
+
+    if (dec->index >= dec->count) {
+        return false;
+    }
+
+    // The header of a self-contained block holds the first sample
+    if (dec->index > 0 || dec->continued) {
+        int32_t next[CODEC_MAX_CHANNELS];
+        uint32_t v, key = 0;
+        bool seen = false;
+
+        if (!get_delta(dec, dec->width[0], &v)) {
+            return false;
+        }
+        int32_t interval = (int32_t)((uint32_t)dec->interval + (uint32_t)unzigzag(v));
+
+        for (int c = 0; c < layout->channels; c++) {
+            if (!get_delta(dec, dec->width[c + 1], &v)) {
+                return false;
+            }
+            int32_t ref = is_keyed(layout, c) && seen ? dec->key_ref[key][c] : dec->values[c];
+            next[c] = (int32_t)((uint32_t)ref + (uint32_t)unzigzag(v));
+            if (c == layout->key_channel) {
+                key = (uint32_t)next[c] % CODEC_MAX_KEYS;
+                seen = (dec->key_seen >> key) & 1;
+            }
+        }
+
+        dec->interval = interval;
+        dec->time += (uint32_t)interval;
+        memcpy(dec->values, next, layout->channels * sizeof(int32_t));
+    }
+    decoder_remember(dec);
+    dec->index++;
+
+    *time = dec->time;
+    memcpy(values, dec->values, layout->channels * sizeof(int32_t));
+    return true;
+}
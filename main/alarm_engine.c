@@ -0,0 +1,287 @@
+#include "alarm_engine.h"
+#include <string.h>
+#include <stdatomic.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_cpu.h"
+#include "esp_log.h"
+#include "global_vars.h"
+#include "binlog.h"
+#include "journal.h"
+
+static const char *TAG = "ALARM";
+
+// Gas baseline, cumulative mean for the first samples of a step, then EMA of 1/64
+#define GAS_BASELINE_SHIFT   6
+#define GAS_BASELINE_WARMUP  (1 << GAS_BASELINE_SHIFT)
+#define GAS_BASELINE_SLOTS   (BME_HEATER_MAX_STEPS + 1)  // Last slot for forced samples
+
+typedef enum {
+    RULE_IDLE = 0,
+    RULE_PENDING,               // Condition true, waiting for sustain_ms
+    RULE_ACTIVE,
+} rule_state_t;
+
+// Compiled rule, everything the hot loop needs in one place
+typedef struct {
+    uint8_t source;
+    uint8_t channel;
+    int8_t window;              // History window id, RATE only
+    uint8_t type;
+    bool above;
+    uint8_t state;
+    int32_t set_level;
+    int32_t clear_level;
+    uint32_t sustain_ms;
+    uint32_t window_ms;
+    uint32_t since_ms;          // Start of RULE_PENDING
+} alarm_rule_t;
+
+typedef struct {
+    int32_t value;
+    uint16_t count;
+} gas_baseline_t;
+
+static alarm_rule_t s_rules[ALARM_MAX_RULES];
+static size_t s_rule_count;
+static uint8_t s_priority[EMERGENCY_TYPE_COUNT];
+
+static gas_baseline_t s_gas_baseline[GAS_BASELINE_SLOTS];
+static bool s_gas_alarm;        // A gas rule was pending or active on the last pass
+
+static atomic_uint_fast32_t s_rule_mask;
+static atomic_uint_fast32_t s_external_mask;
+static portMUX_TYPE s_resolve_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static alarm_stats_t s_stats;
+static portMUX_TYPE s_stats_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// Publishes the highest-priority active type
+static void resolve_emergency(void) {
+    taskENTER_CRITICAL(&s_resolve_lock);
+    uint32_t mask = atomic_load(&s_rule_mask) | atomic_load(&s_external_mask);
+    emergency_type_t prev = atomic_load(&g_current_emergency_type);
+    emergency_type_t top = EMERGENCY_TYPE_NONE;
+    for (int type = EMERGENCY_TYPE_NONE + 1; type < EMERGENCY_TYPE_COUNT; type++) {
+        if ((mask & (1u << type)) && (top == EMERGENCY_TYPE_NONE || s_priority[type] > s_priority[top])) {
+            top = type;
+        }
+    }
+    atomic_store(&g_current_emergency_type, top);
+    taskEXIT_CRITICAL(&s_resolve_lock);
+
+    if (top != prev) {
+        journal_alarm_t rec = {.from = prev, .to = top, .active_mask = mask};
+        journal_append(JOURNAL_REC_ALARM, &rec, sizeof(rec));
+    }
+}
+
+static int find_or_add_window(uint32_t window_ms, const alarm_rule_def_t *defs, size_t upto) {
+    for (size_t i = 0; i < upto; i++) {
+        if (defs[i].source == ALARM_SRC_RATE && defs[i].window_ms == window_ms) {
+            return s_rules[i].window;
+        }
+    }
+    return sensor_history_add_window(window_ms);
+}
+
+esp_err_t alarm_engine_init(const alarm_config_t *config) {
+    if (config->rule_count > ALARM_MAX_RULES) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    memset(s_rules, 0, sizeof(s_rules));
+    memset(s_gas_baseline, 0, sizeof(s_gas_baseline));
+    memcpy(s_priority, config->priority, sizeof(s_priority));
+
+    for (size_t i = 0; i < config->rule_count; i++) {
+        const alarm_rule_def_t *def = &config->rules[i];
+        alarm_rule_t *rule = &s_rules[i];
+
+        if (def->type <= EMERGENCY_TYPE_NONE || def->type >= EMERGENCY_TYPE_COUNT ||
+            (def->source != ALARM_SRC_GAS_RATIO && def->channel >= HIST_CH_COUNT)) {
+            return ESP_ERR_INVALID_ARG;
+        }
+
+        rule->source = def->source;
+        rule->channel = def->channel;
+        rule->type = def->type;
+        rule->above = def->compare == ALARM_ABOVE;
+        rule->set_level = def->threshold;
+        rule->clear_level = rule->above ? def->threshold - def->hysteresis
+                                        : def->threshold + def->hysteresis;
+        rule->sustain_ms = def->sustain_ms;
+        rule->window = -1;
+        rule->window_ms = def->window_ms;
+        if (def->source == ALARM_SRC_RATE) {
+            rule->window = find_or_add_window(def->window_ms, config->rules, i);
+            if (rule->window < 0) {
+                ESP_LOGE(TAG, "No history window left for rule %u", (unsigned)i);
+                return ESP_ERR_NO_MEM;
+            }
+        }
+    }
+    s_rule_count = config->rule_count;
+    atomic_store(&s_rule_mask, 0);
+    resolve_emergency();
+
+    ESP_LOGI(TAG, "%u alarm rules compiled.", (unsigned)s_rule_count);
+    return ESP_OK;
+}
+
+// Ratio of the sample to its step baseline, false while the baseline is warming up
+static bool gas_ratio(const bme_sample_t *sample, int32_t *ratio_pct) {
+    const uint8_t gas_ok = STATUS_GAS_VALID | STATUS_HEAT_STAB;
+    int slot = sample->heater_step >= 0 ? sample->heater_step : BME_HEATER_MAX_STEPS;
+    int32_t gas = (int32_t)sample->reading.gas_resistance;
+
+    if ((sample->status & gas_ok) != gas_ok || slot > BME_HEATER_MAX_STEPS) {
+        return false;
+    }
+    gas_baseline_t *b = &s_gas_baseline[slot];
+
+    bool ready = b->count >= GAS_BASELINE_WARMUP;
+    if (ready) {
+        *ratio_pct = (int32_t)(((int64_t)gas * 100) / (b->value > 0 ? b->value : 1));
+    }
+
+    // Learn only in clean air, a gas event must not become the new normal
+    if (!s_gas_alarm) {
+        if (!ready) {
+            b->count++;
+            b->value += (gas - b->value) / b->count;
+        } else {
+            // Division truncates towards zero, drift up and down at the same rate
+            b->value += (gas - b->value) / (1 << GAS_BASELINE_SHIFT);
+        }
+    }
+    return ready;
+}
+
+void alarm_engine_evaluate(const bme_sample_t *sample) {
+    uint32_t start = esp_cpu_get_cycle_count();
+    uint32_t now_ms = (uint32_t)(sample->timestamp_us / 1000);
+    int32_t level[HIST_CH_COUNT] = {
+        [HIST_CH_TEMPERATURE] = sample->reading.temperature,
+        [HIST_CH_PRESSURE] = (int32_t)sample->reading.pressure,
+        [HIST_CH_HUMIDITY] = (int32_t)(sample->reading.humidity / 10),
+    };
+    int32_t ratio = 0;
+    bool have_ratio = gas_ratio(sample, &ratio);
+    uint32_t mask = 0;
+    bool gas_alarm = false;
+
+    for (size_t i = 0; i < s_rule_count; i++) {
+        alarm_rule_t *rule = &s_rules[i];
+        int32_t x;
+
+        switch (rule->source) {
+        case ALARM_SRC_LEVEL:
+            x = level[rule->channel];
+            break;
+        case ALARM_SRC_RATE: {
+            sensor_history_stats_t st;
+            // Needs half a window of data before the slope means anything
+            if (!sensor_history_query(rule->window, rule->channel, &st) ||
+                (uint64_t)st.span_ms * 2 < rule->window_ms) {
+                goto keep_state;
+            }
+            x = st.slope_per_min;
+            break;
+        }
+        case ALARM_SRC_GAS_RATIO:
+            if (!have_ratio) {
+                goto keep_state;
+            }
+            x = ratio;
+            break;
+        default:
+            goto keep_state;
+        }
+
+        bool set = rule->above ? x > rule->set_level : x < rule->set_level;
+        bool clear = rule->above ? x < rule->clear_level : x > rule->clear_level;
+
+        switch (rule->state) {
+        case RULE_IDLE:
+            if (set) {
+                rule->state = RULE_PENDING;
+                rule->since_ms = now_ms;
+            }
+            break;
+        case RULE_PENDING:
+            if (!set) {
+                rule->state = RULE_IDLE;
+            }
+            break;
+        case RULE_ACTIVE:
+            if (clear) {
+                rule->state = RULE_IDLE;
+                BINLOG(RULE_CLEARED, i, x);
+            }
+            break;
+        }
+        if (rule->state == RULE_PENDING && now_ms - rule->since_ms >= rule->sustain_ms) {
+            rule->state = RULE_ACTIVE;
+            BINLOG(RULE_RAISED, i, rule->type, x);
+        }
+
+keep_state:
+        if (rule->state == RULE_ACTIVE) {
+            mask |= 1u << rule->type;
+        }
+        if (rule->source == ALARM_SRC_GAS_RATIO && rule->state != RULE_IDLE) {
+            gas_alarm = true;
+        }
+    }
+    s_gas_alarm = gas_alarm;
+
+    if (atomic_exchange(&s_rule_mask, mask) != mask) {
+        resolve_emergency();
+    }
+
+    uint32_t cycles = esp_cpu_get_cycle_count() - start;
+    taskENTER_CRITICAL(&s_stats_lock);
+    s_stats.evaluations++;
+    s_stats.cycles_last = cycles;
+    s_stats.cycles_sum += cycles;
+    if (cycles > s_stats.cycles_max) {
+        s_stats.cycles_max = cycles;
+    }
+    taskEXIT_CRITICAL(&s_stats_lock);
+}
+
+void alarm_engine_set_external(emergency_type_t type, bool active) {
+    if (type <= EMERGENCY_TYPE_NONE || type >= EMERGENCY_TYPE_COUNT) {
+        return;
+    }
+    if (active) {
+        atomic_fetch_or(&s_external_mask, 1u << type);
+    } else {
+        atomic_fetch_and(&s_external_mask, ~(1u << type));
+    }
+    resolve_emergency();
+}
+
+uint32_t alarm_engine_active_mask(void) {
+    return atomic_load(&s_rule_mask) | atomic_load(&s_external_mask);
+}
+
+void alarm_engine_get_stats(alarm_stats_t *out) {
+    taskENTER_CRITICAL(&s_stats_lock);
+    *out = s_stats;
+    taskEXIT_CRITICAL(&s_stats_lock);
+}
+
+void alarm_engine_log_stats(void) {
+    alarm_stats_t st;
+
+    alarm_engine_get_stats(&st);
+    if (st.evaluations == 0) {
+        return;
+    }
+    ESP_LOGI(TAG, "rules=%u n=%lu cycles last/avg/max=%lu/%lu/%lu active=0x%02lx",
+             (unsigned)s_rule_count, (unsigned long)st.evaluations, (unsigned long)st.cycles_last,
+             (unsigned long)(st.cycles_sum / st.evaluations), (unsigned long)st.cycles_max,
+             (unsigned long)alarm_engine_active_mask());
+}
@@ -0,0 +1,69 @@
+#ifndef ALARM_ENGINE_H
+#define ALARM_ENGINE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "common_types.h"
+#include "sensor_history.h"
+#include "sensor_snapshot.h"
+
+// --- Alarm engine ---
+// Rules are declared as alarm_rule_def_t, compiled once into a flat table and
+// evaluated in a single pass per sample. Each rule raises one emergency type;
+// the highest-priority active type is published to g_current_emergency_type.
+
+#define ALARM_MAX_RULES 16
+
+typedef enum {
+    ALARM_SRC_LEVEL = 0,        // Sample value of a channel, history units
+    ALARM_SRC_RATE,             // History slope of a channel, units per minute
+    ALARM_SRC_GAS_RATIO,        // Gas resistance in % of the learned baseline of its heater step
+} alarm_source_t;
+
+typedef enum {
+    ALARM_ABOVE = 0,            // Raise above threshold, clear below threshold - hysteresis
+    ALARM_BELOW,                // Raise below threshold, clear above threshold + hysteresis
+} alarm_compare_t;
+
+typedef struct {
+    emergency_type_t type;
+    alarm_source_t source;
+    sensor_history_channel_t channel;   // LEVEL and RATE
+    alarm_compare_t compare;
+    int32_t threshold;
+    int32_t hysteresis;
+    uint32_t sustain_ms;        // Condition must hold this long before raising
+    uint32_t window_ms;         // RATE only, history window of the slope
+} alarm_rule_def_t;
+
+typedef struct {
+    const alarm_rule_def_t *rules;
+    size_t rule_count;
+    uint8_t priority[EMERGENCY_TYPE_COUNT];     // Higher wins when several are active
+} alarm_config_t;
+
+typedef struct {
+    uint32_t evaluations;
+    uint32_t cycles_last;
+    uint32_t cycles_max;
+    uint64_t cycles_sum;
+} alarm_stats_t;
+
+// Compiles the rules and registers their history windows, call before the first sample
+esp_err_t alarm_engine_init(const alarm_config_t *config);
+
+// Evaluates every rule against one sample, called from the acquisition task
+void alarm_engine_evaluate(const bme_sample_t *sample);
+
+// Raises or clears a type owned by another detector, from any task
+void alarm_engine_set_external(emergency_type_t type, bool active);
+
+// Bit (1 << type) for each active emergency type
+uint32_t alarm_engine_active_mask(void);
+
+void alarm_engine_get_stats(alarm_stats_t *out);
+void alarm_engine_log_stats(void);
+
+#endif // ALARM_ENGINE_H
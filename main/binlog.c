@@ -0,0 +1,138 @@
+#include "binlog.h"
+#include <stdatomic.h>
+#include <stdio.h>
+#include "freertos/task.h"
+#include "esp_cpu.h"
+#include "esp_timer.h"
+
+#define BINLOG_FLUSH_MS     500     // Formatter period when the rings stay below half
+#define BINLOG_MSG_LEN      128
+
+typedef struct {
+    _Atomic uint32_t seq;       // Slot index + 1 once the record is complete
+    uint32_t time_us;           // Low word of esp_timer_get_time()
+    uint16_t id;
+    uint16_t core;
+    uint32_t args[BINLOG_MAX_ARGS];
+} binlog_rec_t;
+
+// Multi-producer (tasks and ISRs of one core, plus migrating tasks), one consumer
+typedef struct {
+    _Atomic uint32_t head;      // Next slot to reserve
+    _Atomic uint32_t tail;      // Next slot to format
+    _Atomic uint32_t dropped;
+    binlog_rec_t recs[BINLOG_RING_LEN];
+} binlog_ring_t;
+
+typedef struct {
+    esp_log_level_t level;
+    const char *tag;
+    const char *fmt;
+} binlog_format_t;
+
+#define BINLOG_ENTRY(id, lvl, t, f) [BINLOG_##id] = {.level = ESP_LOG_##lvl, .tag = t, .fmt = f},
+static const binlog_format_t s_formats[BINLOG_FORMAT_COUNT] = {BINLOG_FORMATS(BINLOG_ENTRY)};
+#undef BINLOG_ENTRY
+
+static binlog_ring_t s_rings[portNUM_PROCESSORS];
+static TaskHandle_t s_task;
+
+void binlog_record(binlog_id_t id, uint32_t a0, uint32_t a1, uint32_t a2, uint32_t a3, uint32_t a4) {
+    int core = esp_cpu_get_core_id();
+    binlog_ring_t *ring = &s_rings[core];
+    uint32_t slot = atomic_load_explicit(&ring->head, memory_order_relaxed);
+
+    // Reserve a slot, the consumer frees slots by advancing tail
+    do {
+        if (slot - atomic_load_explicit(&ring->tail, memory_order_acquire) >= BINLOG_RING_LEN) {
+            atomic_fetch_add_explicit(&ring->dropped, 1, memory_order_relaxed);
+            return;
+        }
+    } while (!atomic_compare_exchange_weak_explicit(&ring->head, &slot, slot + 1,
+                                                    memory_order_relaxed, memory_order_relaxed));
+
+    binlog_rec_t *rec = &ring->recs[slot & (BINLOG_RING_LEN - 1)];
+    rec->time_us = (uint32_t)esp_timer_get_time();
+    rec->id = id;
+    rec->core = core;
+    rec->args[0] = a0;
+    rec->args[1] = a1;
+    rec->args[2] = a2;
+    rec->args[3] = a3;
+    rec->args[4] = a4;
+    atomic_store_explicit(&rec->seq, slot + 1, memory_order_release);
+
+    // Wake the formatter early only when the ring fills up, never from an ISR
+    if (slot - atomic_load_explicit(&ring->tail, memory_order_relaxed) == BINLOG_RING_LEN / 2 &&
+        s_task != NULL && !xPortInIsrContext()) {
+        xTaskNotifyGive(s_task);
+    }
+}
+
+// Oldest complete record at the ring tail, NULL when empty or still being written
+static binlog_rec_t *peek(binlog_ring_t *ring) {
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    binlog_rec_t *rec = &ring->recs[tail & (BINLOG_RING_LEN - 1)];
+
+    if (atomic_load_explicit(&rec->seq, memory_order_acquire) != tail + 1) {
+        return NULL;
+    }
+    return rec;
+}
+
+static void format_record(const binlog_rec_t *rec, int64_t now_us) {
+    static const char letters[] = {'N', 'E', 'W', 'I', 'D', 'V'};
+    const binlog_format_t *f = &s_formats[rec->id < BINLOG_FORMAT_COUNT ? rec->id : 0];
+    char msg[BINLOG_MSG_LEN];
+    // Full timestamp from the age, records are far younger than the 71 min wrap
+    int64_t at_us = now_us - (uint32_t)((uint32_t)now_us - rec->time_us);
+
+    // Unused trailing arguments are ignored by the format
+    snprintf(msg, sizeof(msg), f->fmt, rec->args[0], rec->args[1], rec->args[2], rec->args[3], rec->args[4]);
+    esp_log_write(f->level, f->tag, "%c (%lu) %s: %s\n", letters[f->level], (unsigned long)(at_us / 1000),
+                  f->tag, msg);
+}
+
+// Formats everything that is complete, oldest first across the cores
+static void drain(void) {
+    int64_t now_us = esp_timer_get_time();
+
+    while (1) {
+        binlog_ring_t *oldest = NULL;
+        binlog_rec_t *oldest_rec = NULL;
+
+        for (int c = 0; c < portNUM_PROCESSORS; c++) {
+            binlog_rec_t *rec = peek(&s_rings[c]);
+            if (rec != NULL && (oldest_rec == NULL || (int32_t)(rec->time_us - oldest_rec->time_us) < 0)) {
+                oldest = &s_rings[c];
+                oldest_rec = rec;
+            }
+        }
+        if (oldest == NULL) {
+            return;
+        }
+
+        format_record(oldest_rec, now_us);
+        atomic_fetch_add_explicit(&oldest->tail, 1, memory_order_release);
+    }
+}
+
+static void binlog_task(void *pvParameters) {
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(BINLOG_FLUSH_MS));
+        drain();
+    }
+}
+
+bool binlog_start(UBaseType_t priority, BaseType_t core) {
+    return xTaskCreatePinnedToCore(&binlog_task, "binlog", 3072, NULL, priority, &s_task, core) == pdPASS;
+}
+
+uint32_t binlog_dropped(void) {
+    uint32_t total = 0;
+
+    for (int c = 0; c < portNUM_PROCESSORS; c++) {
+        total += atomic_load(&s_rings[c].dropped);
+    }
+    return total;
+}
@@ -0,0 +1,53 @@
+#ifndef BINLOG_H
+#define BINLOG_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_log.h"
+
+// --- Binary deferred logging ---
+// Hot paths record a format id, a timestamp and up to five 32-bit integer
+// arguments into a lock-free ring of the current core. A low-priority task
+// merges the rings by time and formats them through esp_log_write(), so no
+// printf or UART time is spent on the recording side. Arguments must be
+// integers of at most 32 bits; floats, strings and 64-bit values do not fit.
+
+#define BINLOG_MAX_ARGS     5
+#define BINLOG_RING_LEN     64      // Records per core, power of two
+
+// X(id, level, tag, format)
+#define BINLOG_FORMATS(X)                                                                        \
+    X(SAMPLE,         DEBUG, "SENSOR_LOGIC", "[%d] T: %d cC | P: %lu Pa | H: %lu m%% | Gas: %lu Ohm") \
+    X(SAMPLE_FAILED,  WARN,  "SENSOR_LOGIC", "Measurement failed: 0x%x")                         \
+    X(RULE_RAISED,    WARN,  "ALARM",        "Rule %u raised type %u (%ld).")                    \
+    X(RULE_CLEARED,   INFO,  "ALARM",        "Rule %u cleared (%ld).")                           \
+    X(FALL_IMPACT,    WARN,  "MOTION",       "Impact after free fall, fall suspected (%u us).")  \
+    X(FALL_CONFIRMED, WARN,  "MOTION",       "Fall confirmed, peak %u mg.")                      \
+    X(FALL_CANCELLED, INFO,  "MOTION",       "Impact without fall signature, cancelled.")        \
+    X(FALL_RECOVERED, INFO,  "MOTION",       "Upright again, fall cleared.")                     \
+    X(FRAME_DROPPED,  WARN,  "DISPLAY_LOGIC", "Previous frame still flushing, frame dropped.")
+
+#define BINLOG_ENUM(id, level, tag, fmt) BINLOG_##id,
+typedef enum {
+    BINLOG_FORMATS(BINLOG_ENUM)
+    BINLOG_FORMAT_COUNT
+} binlog_id_t;
+#undef BINLOG_ENUM
+
+// Records one message, safe from tasks and ISRs on either core. Drops the
+// record and counts it when the ring is full.
+void binlog_record(binlog_id_t id, uint32_t a0, uint32_t a1, uint32_t a2, uint32_t a3, uint32_t a4);
+
+// BINLOG(FALL_CONFIRMED, peak_mg), missing arguments are zero
+#define BINLOG(id, ...) binlog_record(BINLOG_##id, BINLOG_ARGS_(0, ##__VA_ARGS__, 0, 0, 0, 0, 0, 0))
+#define BINLOG_ARGS_(dummy, a0, a1, a2, a3, a4, ...) \
+    (uint32_t)(a0), (uint32_t)(a1), (uint32_t)(a2), (uint32_t)(a3), (uint32_t)(a4)
+
+// Starts the formatter task
+bool binlog_start(UBaseType_t priority, BaseType_t core);
+
+// Records lost to full rings since boot
+uint32_t binlog_dropped(void);
+
+#endif // BINLOG_H
@@ -0,0 +1,181 @@
+#include <math.h>
+#include <stddef.h>
+#include "bme_compensation.h"
+
+// Written only by set_calibration(), read-only afterwards
+static bme_calib_data_t calib;
+
+void set_calibration(const bme_calib_data_t *cal) {
+    calib = *cal;
+}
+
+const bme_calib_data_t *get_calibration(void) {
+    return &calib;
+}
+
+// --- Fixed-point compensation (Bosch BME68x integer formulas) ---
+// No floats and no shared state, t_fine is passed along explicitly, so these
+// can be called from any task or ISR. Signed coefficients are scaled with
+// multiplications, Bosch's left shifts of negative values are undefined in C.
+
+int16_t compensate_temperature_fixed(int32_t adc_T, int32_t *t_fine_out) {
+    int64_t var1, var2, var3;
+    int32_t t_fine;
+
+    var1 = ((int32_t)adc_T >> 3) - ((int32_t)calib.par_t1 << 1);
+    var2 = (var1 * (int32_t)calib.par_t2) >> 11;
+    var3 = ((var1 >> 1) * (var1 >> 1)) >> 12;
+    var3 = (var3 * ((int32_t)calib.par_t3 * 16)) >> 14;
+    t_fine = (int32_t)(var2 + var3);
+
+    if (t_fine_out != NULL) {
+        *t_fine_out = t_fine;
+    }
+    return (int16_t)(((t_fine * 5) + 128) >> 8);
+}
+
+uint32_t compensate_pressure_fixed(int32_t adc_P, int32_t t_fine) {
+    int32_t var1, var2, var3, pressure_comp;
+    uint32_t pres_u;
+
+    var1 = (t_fine >> 1) - 64000;
+    var2 = ((((var1 >> 2) * (var1 >> 2)) >> 11) * (int32_t)calib.par_p6) >> 2;
+    var2 = var2 + (var1 * (int32_t)calib.par_p5 * 2);
+    var2 = (var2 >> 2) + ((int32_t)calib.par_p4 * 65536);
+    var1 = (((((var1 >> 2) * (var1 >> 2)) >> 13) * ((int32_t)calib.par_p3 * 32)) >> 3) +
+           (((int32_t)calib.par_p2 * var1) >> 1);
+    var1 = var1 >> 18;
+    var1 = ((32768 + var1) * (int32_t)calib.par_p1) >> 15;
+    if (var1 == 0) {
+        return 0; // No calibration
+    }
+
+    // Unsigned, so high pressures do not overflow the x3125 step; drop a bit before dividing when needed
+    pres_u = (uint32_t)(1048576 - adc_P - (var2 >> 12)) * 3125u;
+    if (pres_u >= 0x80000000u) {
+        pres_u = (pres_u / (uint32_t)var1) << 1;
+    } else {
+        pres_u = (pres_u << 1) / (uint32_t)var1;
+    }
+    pressure_comp = (int32_t)pres_u;
+
+    var1 = ((int32_t)calib.par_p9 * (int32_t)(((pressure_comp >> 3) * (pressure_comp >> 3)) >> 13)) >> 12;
+    var2 = ((int32_t)(pressure_comp >> 2) * (int32_t)calib.par_p8) >> 13;
+    // Cube split in two steps, the direct product overflows above ~100 kPa
+    var3 = ((((pressure_comp >> 8) * (pressure_comp >> 8)) >> 8) *
+            (pressure_comp >> 8) * (int32_t)calib.par_p10) >> 9;
+    pressure_comp = pressure_comp + ((var1 + var2 + var3 + ((int32_t)calib.par_p7 * 128)) >> 4);
+
+    return (uint32_t)pressure_comp;
+}
+
+uint32_t compensate_humidity_fixed(int32_t adc_H, int32_t t_fine) {
+    int32_t var1, var2, var4, temp_scaled;
+    // 64 bits from var3 on, Bosch's 32-bit products wrap near saturation and
+    // gave far too low or 0 %RH where the float path gives 100
+    int64_t var3, var5, var6, hum_comp;
+
+    temp_scaled = ((t_fine * 5) + 128) >> 8;  // temperature in 0.01°C units
+    var1 = (adc_H - ((int32_t)calib.par_h1 * 16)) -
+           (((temp_scaled * (int32_t)calib.par_h3) / 100) >> 1);
+    var2 = ((int32_t)calib.par_h2 *
+            (((temp_scaled * (int32_t)calib.par_h4) / 100) +
+             (((temp_scaled * ((temp_scaled * (int32_t)calib.par_h5) / 100)) >> 6) / 100) +
+             (1 << 14))) >> 10;
+    var3 = (int64_t)var1 * var2;
+    var4 = (((int32_t)calib.par_h6 << 7) + ((temp_scaled * (int32_t)calib.par_h7) / 100)) >> 4;
+    var5 = ((var3 >> 14) * (var3 >> 14)) >> 10;
+    var6 = (var4 * var5) >> 1;
+
+    hum_comp = (((var3 + var6) >> 10) * 1000) >> 12;
+    hum_comp = (hum_comp > 100000 ? 100000 : (hum_comp < 0 ? 0 : hum_comp));
+
+    return (uint32_t)hum_comp;
+}
+
+uint32_t compensate_gas_fixed(uint16_t gas_adc, uint8_t gas_range) {
+    uint32_t var1 = UINT32_C(262144) >> gas_range;
+    int32_t var2 = (int32_t)gas_adc - 512;
+
+    var2 *= 3;
+    var2 = 4096 + var2;
+
+    // Full product in 64 bits, Bosch's 32-bit (10000 * var1 / var2) * 100 loses up to 5% on high ranges
+    return (uint32_t)((UINT64_C(1000000) * var1) / (uint32_t)var2);
+}
+
+// --- Float compensation (Bosch BME68x float formulas) ---
+
+static float t_fine_float;
+
+float compensate_temperature(int32_t adc_T) {
+    float var1 = (((float)adc_T) / 16384.0f - ((float)calib.par_t1) / 1024.0f) * ((float)calib.par_t2);
+    float var2 = ((((float)adc_T) / 131072.0f - ((float)calib.par_t1) / 8192.0f) *
+                  (((float)adc_T) / 131072.0f - ((float)calib.par_t1) / 8192.0f)) * ((float)calib.par_t3 * 16.0f);
+    t_fine_float = var1 + var2;
+    return t_fine_float / 5120.0f;
+}
+
+float compensate_pressure(int32_t adc_P) {
+    float var1, var2, var3, calc_pres;
+
+    var1 = (t_fine_float / 2.0f) - 64000.0f;
+    var2 = var1 * var1 * (((float)calib.par_p6) / 131072.0f);
+    var2 = var2 + (var1 * ((float)calib.par_p5) * 2.0f);
+    var2 = (var2 / 4.0f) + (((float)calib.par_p4) * 65536.0f);
+    var1 = (((((float)calib.par_p3 * var1 * var1) / 16384.0f) + ((float)calib.par_p2 * var1)) / 524288.0f);
+    var1 = ((1.0f + (var1 / 32768.0f)) * ((float)calib.par_p1));
+    if ((int)var1 == 0) {
+        return 0; // No calibration
+    }
+
+    calc_pres = 1048576.0f - ((float)adc_P);
+    calc_pres = (((calc_pres - (var2 / 4096.0f)) * 6250.0f) / var1);
+    var1 = (((float)calib.par_p9) * calc_pres * calc_pres) / 2147483648.0f;
+    var2 = calc_pres * (((float)calib.par_p8) / 32768.0f);
+    var3 = ((calc_pres / 256.0f) * (calc_pres / 256.0f) * (calc_pres / 256.0f) * (calib.par_p10 / 131072.0f));
+
+    return calc_pres + (var1 + var2 + var3 + ((float)calib.par_p7 * 128.0f)) / 16.0f;
+}
+
+float compensate_humidity(int32_t adc_H) {
+    float temp_comp = t_fine_float / 5120.0f;
+    float var1, var2, var3, var4, calc_hum;
+
+    var1 = (float)adc_H - (((float)calib.par_h1 * 16.0f) + (((float)calib.par_h3 / 2.0f) * temp_comp));
+    var2 = var1 * (((float)calib.par_h2 / 262144.0f) *
+                   (1.0f + (((float)calib.par_h4 / 16384.0f) * temp_comp) +
+                    (((float)calib.par_h5 / 1048576.0f) * temp_comp * temp_comp)));
+    var3 = (float)calib.par_h6 / 16384.0f;
+    var4 = (float)calib.par_h7 / 2097152.0f;
+    calc_hum = var2 + ((var3 + (var4 * temp_comp)) * var2 * var2);
+
+    return calc_hum > 100.0f ? 100.0f : (calc_hum < 0.0f ? 0.0f : calc_hum);  // %RH
+}
+
+float compensate_gas(uint16_t gas_adc, uint8_t gas_range) {
+    uint32_t var1 = UINT32_C(262144) >> gas_range;
+    int32_t var2 = (int32_t)gas_adc - 512;
+
+    var2 *= 3;
+    var2 = 4096 + var2;
+
+    return 1000000.0f * (float)var1 / (float)var2;  // in Ohms
+}
+
+void compensate_reading(int32_t temp_raw, int32_t press_raw, int32_t hum_raw,
+                        uint16_t gas_adc, uint8_t gas_range, bme_reading_t *out) {
+#if BME_USE_FIXED_POINT
+    int32_t t_fine;
+
+    out->temperature = compensate_temperature_fixed(temp_raw, &t_fine);
+    out->pressure = compensate_pressure_fixed(press_raw, t_fine);
+    out->humidity = compensate_humidity_fixed(hum_raw, t_fine);
+    out->gas_resistance = compensate_gas_fixed(gas_adc, gas_range);
+#else
+    out->temperature = (int16_t)lroundf(compensate_temperature(temp_raw) * 100.0f);
+    out->pressure = (uint32_t)lroundf(compensate_pressure(press_raw));
+    out->humidity = (uint32_t)lroundf(compensate_humidity(hum_raw) * 1000.0f);
+    out->gas_resistance = (uint32_t)lroundf(compensate_gas(gas_adc, gas_range));
+#endif
+}
@@ -0,0 +1,71 @@
+#ifndef BME_COMPENSATION_H
+#define BME_COMPENSATION_H
+
+#include <stdint.h>
+
+// BME690 compensation formulas, plain C without ESP-IDF so the host build
+// (main/host) can compare the integer and float paths.
+
+// 1: integer compensation (no FPU use), 0: float compensation
+#ifndef BME_USE_FIXED_POINT
+#define BME_USE_FIXED_POINT 1
+#endif
+
+// Decoded calibration, 16-bit fields first so none of them is misaligned
+typedef struct __attribute__((packed)) {
+    uint16_t par_t1;
+    int16_t  par_t2;
+    uint16_t par_p1;
+    int16_t  par_p2;
+    int16_t  par_p4;
+    int16_t  par_p5;
+    int16_t  par_p8;
+    int16_t  par_p9;
+    uint16_t par_h1;
+    uint16_t par_h2;
+    int16_t  par_g2;
+    int8_t   par_t3;
+    int8_t   par_p3;
+    int8_t   par_p6;
+    int8_t   par_p7;
+    uint8_t  par_p10;
+    int8_t   par_h3;
+    int8_t   par_h4;
+    int8_t   par_h5;
+    uint8_t  par_h6;
+    int8_t   par_h7;
+    int8_t   par_g1;
+    int8_t   par_g3;
+    uint8_t  res_heat_range;
+    int8_t   res_heat_val;
+    int8_t   range_sw_err;
+} bme_calib_data_t;
+
+// Compensated reading in fixed-point units
+typedef struct {
+    int16_t temperature;        // 0.01 °C
+    uint32_t pressure;          // Pa
+    uint32_t humidity;          // 0.001 %RH
+    uint32_t gas_resistance;    // Ohm
+} bme_reading_t;
+
+// Calibration in use, set once by load_calibration() before any compensation
+void set_calibration(const bme_calib_data_t *cal);
+const bme_calib_data_t *get_calibration(void);
+
+float compensate_temperature(int32_t adc_T);
+float compensate_pressure(int32_t adc_P);
+float compensate_humidity(int32_t adc_H);
+float compensate_gas(uint16_t gas_adc, uint8_t gas_range);
+
+// Integer versions, t_fine from temperature is passed to pressure and humidity
+int16_t compensate_temperature_fixed(int32_t adc_T, int32_t *t_fine);
+uint32_t compensate_pressure_fixed(int32_t adc_P, int32_t t_fine);
+uint32_t compensate_humidity_fixed(int32_t adc_H, int32_t t_fine);
+uint32_t compensate_gas_fixed(uint16_t gas_adc, uint8_t gas_range);
+
+// Compensates one measurement with the path selected by BME_USE_FIXED_POINT
+void compensate_reading(int32_t temp_raw, int32_t press_raw, int32_t hum_raw,
+                        uint16_t gas_adc, uint8_t gas_range, bme_reading_t *out);
+
+#endif // BME_COMPENSATION_H
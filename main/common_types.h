@@ -7,7 +7,10 @@
 typedef enum {
     EMERGENCY_TYPE_NONE = 0,
     EMERGENCY_TYPE_DANGER,
-    EMERGENCY_TYPE_FALL
+    EMERGENCY_TYPE_FALL,
+    EMERGENCY_TYPE_GAS,         // Gas resistance drop, hazardous gas
+    EMERGENCY_TYPE_HEAT,        // High or fast-rising temperature
+    EMERGENCY_TYPE_COUNT
 } emergency_type_t;
 
 // Add any other shared type definitions here
@@ -0,0 +1,77 @@
+#include "display_bus.h"
+#include "esp_log.h"
+#include "i2c_scheduler.h"
+#include "ssd1306_i2c.h"      // For SSD1306_I2C_ADDR
+
+static const char *TAG = "DISPLAY_BUS";
+
+// SSD1306 control bytes, sent in front of every transaction
+static const uint8_t s_control_cmd = 0x00;
+static const uint8_t s_control_data = 0x40;
+
+static i2c_master_bus_handle_t s_bus;
+static i2c_master_dev_handle_t s_dev;
+
+esp_err_t display_bus_init(i2c_master_bus_handle_t bus, uint32_t scl_hz)
+{
+    i2c_device_config_t dev_cfg = {
+        .dev_addr_length = I2C_ADDR_BIT_LEN_7,
+        .device_address = SSD1306_I2C_ADDR >> 1,
+        .scl_speed_hz = scl_hz,
+    };
+    esp_err_t err = i2c_master_bus_add_device(bus, &dev_cfg, &s_dev);
+
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to add display to bus: %s", esp_err_to_name(err));
+        return err;
+    }
+    s_bus = bus;
+    return ESP_OK;
+}
+
+static uint8_t backend_init(void *context)
+{
+    // Probe is an address-only transaction on the bus, not a device transfer
+    return s_dev != NULL && i2c_master_probe(s_bus, SSD1306_I2C_ADDR >> 1, I2C_SCHED_TIMEOUT_MS) == ESP_OK;
+}
+
+static void backend_write_commands(void *context, const uint8_t *commands, uint16_t count)
+{
+    i2c_sched_txn_t txn = {
+        .dev = s_dev,
+        .cls = I2C_SCHED_CLASS_DISPLAY,
+        .head = &s_control_cmd,
+        .head_len = 1,
+        .data = commands,
+        .width = count,
+        .rows = 1,
+        .stride = count,
+    };
+
+    i2c_sched_transfer(&txn);
+}
+
+static void backend_write_data(void *context, const uint8_t *data, uint16_t width, uint8_t rows, uint16_t stride)
+{
+    // Display keeps its own GDDRAM pointer, so every page can be its own transaction
+    i2c_sched_txn_t txn = {
+        .dev = s_dev,
+        .cls = I2C_SCHED_CLASS_DISPLAY,
+        .flags = I2C_SCHED_FLAG_CHUNK_ROWS,
+        .head = &s_control_data,
+        .head_len = 1,
+        .data = data,
+        .width = width,
+        .rows = rows,
+        .stride = stride,
+    };
+
+    i2c_sched_transfer(&txn);
+}
+
+const SSD1306_Backend_t display_bus_backend = {
+    .Init = backend_init,
+    .WriteCommands = backend_write_commands,
+    .WriteData = backend_write_data,
+    .Context = NULL,
+};
@@ -0,0 +1,16 @@
+#ifndef DISPLAY_BUS_H
+#define DISPLAY_BUS_H
+
+#include "driver/i2c_master.h"
+#include "ssd1306_backend.h"  // From SSD1306_Driver component
+
+// SSD1306 transport through the I2C scheduler. Frames are sent in the display
+// class, one page per bus transaction, so sensor reads can run between pages.
+
+// Adds the display to the shared bus, the scheduler must already be running
+esp_err_t display_bus_init(i2c_master_bus_handle_t bus, uint32_t scl_hz);
+
+// Backend to pass to SSD1306_SetBackend()
+extern const SSD1306_Backend_t display_bus_backend;
+
+#endif // DISPLAY_BUS_H
@@ -1,4 +1,7 @@
 #include "display_logic.h" // Includes global_vars.h, common_types.h, ssd1306.h, fonts.h
+#include "ssd1306_flush.h"
+#include "profiler.h"
+#include "binlog.h"
 #include <stdio.h>
 #include <string.h>
 #include "esp_log.h"
@@ -6,64 +9,126 @@
 static const char *TAG = "DISPLAY_LOGIC";
 
 // --- Configuration (copied from original main.c, can be centralized if needed) ---
-#define DISPLAY_UPDATE_INTERVAL_MS 250 // Update display every 0.25 seconds for more rapid blink
+#define DISPLAY_BLINK_INTERVAL_MS  250 // Emergency blink half period
+#define DISPLAY_SWAP_TIMEOUT_MS    DISPLAY_BLINK_INTERVAL_MS // Max wait for previous frame to leave I2C
+
+static TaskHandle_t s_display_task;
+
+void display_request_refresh(void) {
+    TaskHandle_t task = s_display_task;
+
+    if (task != NULL) {
+        xTaskNotifyGive(task);
+    }
+}
 
 void display_task(void *pvParameters) {
     char temp_str[20];
     char pressure_str[20];
     char humidity_str[20];
+    char shown[sizeof(temp_str) + sizeof(pressure_str) + sizeof(humidity_str)] = "";
     static bool s_emergency_blink_visible = true; // For blinking effect
+    bool blinking = false;
+    TickType_t next_blink = 0;
 
     ESP_LOGI(TAG, "Display task started.");
+    s_display_task = xTaskGetCurrentTaskHandle();
 
     while (1) {
-        if (xSemaphoreTake(g_display_mutex, portMAX_DELAY) == pdTRUE) {
-            SSD1306_Fill(SSD1306_COLOR_BLACK); // Clear display buffer
-
-            emergency_type_t current_emergency = g_current_emergency_type; // Copy volatile to local
-
-            if (current_emergency != EMERGENCY_TYPE_NONE) {
-                const char* emergency_text = "";
-                if (current_emergency == EMERGENCY_TYPE_DANGER) {
-                    emergency_text = "DANGER";
-                } else if (current_emergency == EMERGENCY_TYPE_FALL) {
-                    emergency_text = "FALL";
-                }
-
-                if (s_emergency_blink_visible) {
-                    uint16_t text_width = strlen(emergency_text) * Font_16x26.FontWidth;
-                    uint16_t x_pos = (SSD1306_WIDTH - text_width) / 2;
-                    uint16_t y_pos = (SSD1306_HEIGHT - Font_16x26.FontHeight) / 2;
-                    if (x_pos > SSD1306_WIDTH) x_pos = 0; 
-
-                    SSD1306_GotoXY(x_pos, y_pos);
-                    SSD1306_Puts((char*)emergency_text, &Font_16x26, SSD1306_COLOR_WHITE);
-                }
-                s_emergency_blink_visible = !s_emergency_blink_visible; // Toggle blink state
-            } else {
-                // No emergency, display sensor data
-                snprintf(temp_str, sizeof(temp_str), "Temp: %.1f C", g_temperature);
-                snprintf(pressure_str, sizeof(pressure_str), "Pres: %.1f hPa", g_pressure);
-                snprintf(humidity_str, sizeof(humidity_str), "Humi: %.0f %%", g_humidity);
-
-                SSD1306_GotoXY(0, 0);
-                SSD1306_Puts(temp_str, &Font_11x18, SSD1306_COLOR_WHITE);
-
-                SSD1306_GotoXY(0, Font_11x18.FontHeight + 4);
-                SSD1306_Puts(pressure_str, &Font_11x18, SSD1306_COLOR_WHITE);
-
-                SSD1306_GotoXY(0, (Font_11x18.FontHeight + 4) * 2);
-                SSD1306_Puts(humidity_str, &Font_11x18, SSD1306_COLOR_WHITE);
-
-                s_emergency_blink_visible = true; // Reset blink state for next potential emergency
+        // Both reads are wait-free, the producers are never blocked by rendering
+        emergency_type_t current_emergency = atomic_load(&g_current_emergency_type);
+        bme_sample_t sample;
+        bool have_sample = sensor_snapshot_read(&sample);
+        uint32_t render_start = profiler_begin();
+
+        if (current_emergency != EMERGENCY_TYPE_NONE) {
+            // Data wakeups must not speed up the blink
+            TickType_t now = xTaskGetTickCount();
+            if (blinking && (int32_t)(next_blink - now) > 0) {
+                ulTaskNotifyTake(pdTRUE, next_blink - now);
+                continue;
+            }
+            blinking = true;
+            next_blink = now + pdMS_TO_TICKS(DISPLAY_BLINK_INTERVAL_MS);
+
+            SSD1306_Fill(SSD1306_COLOR_BLACK); // Clear back buffer
+            const char* emergency_text = "";
+            if (current_emergency == EMERGENCY_TYPE_DANGER) {
+                emergency_text = "DANGER";
+            } else if (current_emergency == EMERGENCY_TYPE_FALL) {
+                emergency_text = "FALL";
+            } else if (current_emergency == EMERGENCY_TYPE_GAS) {
+                emergency_text = "GAS";
+            } else if (current_emergency == EMERGENCY_TYPE_HEAT) {
+                emergency_text = "HEAT";
+            }
+
+            if (s_emergency_blink_visible) {
+                uint16_t text_width = strlen(emergency_text) * Font_16x26.FontWidth;
+                uint16_t x_pos = (SSD1306_WIDTH - text_width) / 2;
+                uint16_t y_pos = (SSD1306_HEIGHT - Font_16x26.FontHeight) / 2;
+                if (x_pos > SSD1306_WIDTH) x_pos = 0; 
+
+                SSD1306_GotoXY(x_pos, y_pos);
+                SSD1306_Puts((char*)emergency_text, &Font_16x26, SSD1306_COLOR_WHITE);
             }
+            s_emergency_blink_visible = !s_emergency_blink_visible; // Toggle blink state
+            shown[0] = '\0';
+        } else if (!have_sample) {
+            // Splash until the first sample, so the wearer sees when protection starts
+            const char *boot_msg = "Booting...";
+            uint16_t boot_msg_width = strlen(boot_msg) * Font_11x18.FontWidth;
+            uint16_t boot_msg_x = (SSD1306_WIDTH > boot_msg_width) ? (SSD1306_WIDTH - boot_msg_width) / 2 : 0;
+            uint16_t boot_msg_y = (SSD1306_HEIGHT > Font_11x18.FontHeight) ? (SSD1306_HEIGHT - Font_11x18.FontHeight) / 2 : 0;
+
+            blinking = false;
+            SSD1306_Fill(SSD1306_COLOR_BLACK);
+            SSD1306_GotoXY(boot_msg_x, boot_msg_y);
+            SSD1306_Puts((char *)boot_msg, &Font_11x18, SSD1306_COLOR_WHITE);
+            strcpy(shown, boot_msg);
+        } else {
+            // No emergency, display sensor data
+            snprintf(temp_str, sizeof(temp_str), "Temp: %.1f C", sample.reading.temperature / 100.0f);
+            snprintf(pressure_str, sizeof(pressure_str), "Pres: %.1f hPa", sample.reading.pressure / 100.0f);
+            snprintf(humidity_str, sizeof(humidity_str), "Humi: %.0f %%", sample.reading.humidity / 1000.0f);
+
+            s_emergency_blink_visible = true; // Reset blink state for next potential emergency
+            blinking = false;
+
+            // Most samples do not change the rounded values, skip the frame then
+            char next[sizeof(shown)];
+            snprintf(next, sizeof(next), "%s|%s|%s", temp_str, pressure_str, humidity_str);
+            if (strcmp(next, shown) == 0) {
+                ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+                continue;
+            }
+            strcpy(shown, next);
+
+            SSD1306_Fill(SSD1306_COLOR_BLACK); // Clear back buffer
+            SSD1306_GotoXY(0, 0);
+            SSD1306_Puts(temp_str, &Font_11x18, SSD1306_COLOR_WHITE);
+
+            SSD1306_GotoXY(0, Font_11x18.FontHeight + 4);
+            SSD1306_Puts(pressure_str, &Font_11x18, SSD1306_COLOR_WHITE);
+
+            SSD1306_GotoXY(0, (Font_11x18.FontHeight + 4) * 2);
+            SSD1306_Puts(humidity_str, &Font_11x18, SSD1306_COLOR_WHITE);
+        }
 
-            SSD1306_UpdateScreen();
-            xSemaphoreGive(g_display_mutex);
+        profiler_end(PROBE_DISPLAY_RENDER, render_start);
 
+        // Hand the frame to the flush task, I2C transfer overlaps with our sleep
+        uint32_t swap_start = profiler_begin();
+        bool dropped = SSD1306_SwapBuffers(pdMS_TO_TICKS(DISPLAY_SWAP_TIMEOUT_MS)) == 0;
+        if (dropped) {
+            profiler_count(COUNTER_SWAP_TIMEOUT);
+            BINLOG(FRAME_DROPPED);
+            shown[0] = '\0';   // Not on screen, the same text must be drawn again
         }
+        profiler_end(PROBE_DISPLAY_SWAP, swap_start);
 
-        vTaskDelay(pdMS_TO_TICKS(DISPLAY_UPDATE_INTERVAL_MS));
+        // Blinking and a dropped frame need the timer, otherwise only new data or an alarm wakes us
+        ulTaskNotifyTake(pdTRUE, blinking || dropped ? pdMS_TO_TICKS(DISPLAY_BLINK_INTERVAL_MS) : portMAX_DELAY);
     }
 }
 
@@ -10,5 +10,9 @@
 // Task function declaration
 void display_task(void *pvParameters);
 
+// Wakes the display task to redraw, call after new data or an emergency change.
+// Without calls it sleeps, apart from the emergency blink.
+void display_request_refresh(void);
+
 #endif // DISPLAY_LOGIC_H
 
@@ -0,0 +1,174 @@
+#include "fall_detector.h"
+#include <string.h>
+
+#define FALL_LP_SHIFT       6       // Gravity low-pass, alpha 1/64
+#define FALL_ORIENT_EVERY   32      // Frames between orientation checks while fallen
+
+static inline uint32_t frames_for(uint32_t ms, uint32_t period_us) {
+    uint32_t n = (ms * 1000 + period_us - 1) / period_us;
+    return n > 0 ? n : 1;
+}
+
+static inline uint32_t mg_sq(uint32_t mg, uint16_t lsb_per_g) {
+    uint32_t lsb = (mg * lsb_per_g) / 1000;
+    return lsb * lsb;
+}
+
+void fall_detector_init(fall_detector_t *det, const fall_detector_config_t *config) {
+    uint32_t period = config->frame_period_us;
+
+    memset(det, 0, sizeof(*det));
+    det->free_fall_sq = mg_sq(config->free_fall_mg, config->lsb_per_g);
+    det->impact_sq = mg_sq(config->impact_mg, config->lsb_per_g);
+    det->still_lo_sq = mg_sq(config->still_mg < 1000 ? 1000 - config->still_mg : 0, config->lsb_per_g);
+    det->still_hi_sq = mg_sq(1000 + config->still_mg, config->lsb_per_g);
+    det->free_fall_frames = frames_for(config->free_fall_ms, period);
+    det->window_frames = frames_for(config->impact_window_ms, period);
+    det->settle_frames = frames_for(config->settle_ms, period);
+    det->post_frames = frames_for(config->post_ms, period);
+    det->recovery_frames = frames_for(config->recovery_ms, period);
+    det->tilt_cos2_q15 = ((uint32_t)config->tilt_cos_q15 * config->tilt_cos_q15) >> 15;
+    det->still_pct = config->still_pct;
+    det->lsb_per_g = config->lsb_per_g;
+
+    // Start out assuming upright, the low-pass converges within a second
+    det->lp[2] = (int32_t)config->lsb_per_g << FALL_LP_SHIFT;
+    det->ref[2] = config->lsb_per_g;
+}
+
+// True when the current gravity vector is more than the tilt angle away from ref.
+// cos^2 in Q15 is built in two divisions so every step fits in 64 bits.
+static bool orientation_changed(const fall_detector_t *det) {
+    int32_t g[3] = {
+        det->lp[0] >> FALL_LP_SHIFT,
+        det->lp[1] >> FALL_LP_SHIFT,
+        det->lp[2] >> FALL_LP_SHIFT,
+    };
+    int64_t dot = (int64_t)g[0] * det->ref[0] + (int64_t)g[1] * det->ref[1] + (int64_t)g[2] * det->ref[2];
+    int64_t ref_sq = (int64_t)det->ref[0] * det->ref[0] + (int64_t)det->ref[1] * det->ref[1] +
+                     (int64_t)det->ref[2] * det->ref[2];
+    int64_t g_sq = (int64_t)g[0] * g[0] + (int64_t)g[1] * g[1] + (int64_t)g[2] * g[2];
+
+    if (dot <= 0) {
+        return true;    // 90 degrees or more
+    }
+    if (ref_sq == 0 || g_sq == 0) {
+        return false;
+    }
+    int64_t cos2_q15 = (((dot * dot) / ref_sq) << 15) / g_sq;
+    return cos2_q15 < det->tilt_cos2_q15;
+}
+
+static uint32_t isqrt(uint32_t v) {
+    uint32_t root = 0, bit = 1u << 30;
+
+    while (bit > v) {
+        bit >>= 2;
+    }
+    while (bit != 0) {
+        if (v >= root + bit) {
+            v -= root + bit;
+            root = (root >> 1) + bit;
+        } else {
+            root >>= 1;
+        }
+        bit >>= 2;
+    }
+    return root;
+}
+
+static fall_event_t enter(fall_detector_t *det, fall_state_t state, fall_event_t event) {
+    det->state = state;
+    det->state_frames = 0;
+    det->run = 0;
+    return event;
+}
+
+fall_event_t fall_detector_process(fall_detector_t *det, const imu_frame_t *frames, size_t count) {
+    fall_event_t last = FALL_EVENT_NONE;
+
+    for (size_t i = 0; i < count; i++) {
+        const imu_vec_t *a = &frames[i].acc;
+        uint32_t mag_sq = (uint32_t)((int32_t)a->x * a->x) + (uint32_t)((int32_t)a->y * a->y) +
+                          (uint32_t)((int32_t)a->z * a->z);
+        fall_event_t ev = FALL_EVENT_NONE;
+
+        det->lp[0] += (((int32_t)a->x * (1 << FALL_LP_SHIFT)) - det->lp[0]) >> FALL_LP_SHIFT;
+        det->lp[1] += (((int32_t)a->y * (1 << FALL_LP_SHIFT)) - det->lp[1]) >> FALL_LP_SHIFT;
+        det->lp[2] += (((int32_t)a->z * (1 << FALL_LP_SHIFT)) - det->lp[2]) >> FALL_LP_SHIFT;
+        det->state_frames++;
+
+        switch (det->state) {
+        case FALL_STATE_IDLE:
+            if (mag_sq < det->free_fall_sq) {
+                if (det->run == 0) {
+                    // Orientation just before the drop, the low-pass has not moved yet
+                    det->ref[0] = det->lp[0] >> FALL_LP_SHIFT;
+                    det->ref[1] = det->lp[1] >> FALL_LP_SHIFT;
+                    det->ref[2] = det->lp[2] >> FALL_LP_SHIFT;
+                }
+                if (++det->run >= det->free_fall_frames) {
+                    enter(det, FALL_STATE_FREE_FALL, FALL_EVENT_NONE);
+                }
+            } else {
+                det->run = 0;
+            }
+            break;
+
+        case FALL_STATE_FREE_FALL:
+            if (mag_sq > det->impact_sq) {
+                det->peak_sq = mag_sq;
+                det->stats.impacts++;
+                ev = enter(det, FALL_STATE_IMPACT, FALL_EVENT_IMPACT);
+            } else if (det->state_frames > det->window_frames) {
+                enter(det, FALL_STATE_IDLE, FALL_EVENT_NONE);
+            }
+            break;
+
+        case FALL_STATE_IMPACT:
+            if (mag_sq > det->peak_sq) {
+                det->peak_sq = mag_sq;
+            }
+            if (det->state_frames >= det->settle_frames) {
+                det->stats.last_peak_mg = (uint16_t)((isqrt(det->peak_sq) * 1000) / det->lsb_per_g);
+                enter(det, FALL_STATE_POST_IMPACT, FALL_EVENT_NONE);
+            }
+            break;
+
+        case FALL_STATE_POST_IMPACT:
+            if (mag_sq >= det->still_lo_sq && mag_sq <= det->still_hi_sq) {
+                det->run++;
+            }
+            if (det->state_frames >= det->post_frames) {
+                bool still = det->run * 100 >= (uint32_t)det->still_pct * det->post_frames;
+                if (still && orientation_changed(det)) {
+                    det->stats.confirmed++;
+                    ev = enter(det, FALL_STATE_FALLEN, FALL_EVENT_CONFIRMED);
+                } else {
+                    det->stats.cancelled++;
+                    ev = enter(det, FALL_STATE_IDLE, FALL_EVENT_CANCELLED);
+                }
+            }
+            break;
+
+        case FALL_STATE_FALLEN:
+            if ((det->state_frames % FALL_ORIENT_EVERY) == 0) {
+                det->run = orientation_changed(det) ? 0 : det->run + FALL_ORIENT_EVERY;
+                if (det->run >= det->recovery_frames) {
+                    det->stats.recovered++;
+                    ev = enter(det, FALL_STATE_IDLE, FALL_EVENT_RECOVERED);
+                }
+            }
+            break;
+        }
+
+        if (ev != FALL_EVENT_NONE) {
+            last = ev;
+            det->event_index = i;
+        }
+    }
+
+    det->stats.batches++;
+    det->stats.frames += count;
+    return last;
+}
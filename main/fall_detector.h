@@ -0,0 +1,104 @@
+#ifndef FALL_DETECTOR_H
+#define FALL_DETECTOR_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "imu_types.h"
+
+// --- Fall detector ---
+// Streaming state machine over accelerometer frames, fixed point, O(1) state:
+//   IDLE -> FREE_FALL (|a| low for a while) -> IMPACT (|a| peak) -> POST_IMPACT
+//   -> FALLEN (orientation changed and wearer still) or back to IDLE.
+// The impact already reports a fall so the alarm is up within one FIFO batch;
+// the post-impact check then confirms or cancels it.
+
+typedef enum {
+    FALL_STATE_IDLE = 0,
+    FALL_STATE_FREE_FALL,
+    FALL_STATE_IMPACT,          // Settling after the peak
+    FALL_STATE_POST_IMPACT,     // Collecting orientation and stillness
+    FALL_STATE_FALLEN,
+} fall_state_t;
+
+typedef enum {
+    FALL_EVENT_NONE = 0,
+    FALL_EVENT_IMPACT,          // Free fall followed by impact, fall suspected
+    FALL_EVENT_CONFIRMED,       // Lying still in a new orientation
+    FALL_EVENT_CANCELLED,       // Impact without the post-impact signature
+    FALL_EVENT_RECOVERED,       // Back upright after a confirmed fall
+} fall_event_t;
+
+typedef struct {
+    uint16_t lsb_per_g;         // Accelerometer scale
+    uint32_t frame_period_us;
+    uint16_t free_fall_mg;      // |a| below this is free fall
+    uint16_t free_fall_ms;      // Minimum free fall duration
+    uint16_t impact_mg;         // |a| above this is an impact
+    uint16_t impact_window_ms;  // Impact must follow free fall within this
+    uint16_t settle_ms;         // Ignored after the impact, bounces
+    uint16_t post_ms;           // Post-impact observation
+    uint16_t tilt_cos_q15;      // Orientation change when cos(angle) drops below this
+    uint16_t still_mg;          // |a| within 1 g +- this counts as still
+    uint8_t still_pct;          // Share of still frames needed in the observation
+    uint16_t recovery_ms;       // Upright this long ends a confirmed fall
+} fall_detector_config_t;
+
+#define FALL_DETECTOR_DEFAULT_CONFIG(lsb, period_us) { \
+    .lsb_per_g = (lsb),                                \
+    .frame_period_us = (period_us),                    \
+    .free_fall_mg = 400,                               \
+    .free_fall_ms = 60,                                \
+    .impact_mg = 2500,                                 \
+    .impact_window_ms = 500,                           \
+    .settle_ms = 500,                                  \
+    .post_ms = 1500,                                   \
+    .tilt_cos_q15 = 23170,  /* cos 45 deg */           \
+    .still_mg = 150,                                   \
+    .still_pct = 80,                                   \
+    .recovery_ms = 3000,                               \
+}
+
+typedef struct {
+    uint32_t batches;
+    uint32_t frames;
+    uint32_t impacts;
+    uint32_t confirmed;
+    uint32_t cancelled;
+    uint32_t recovered;
+    uint16_t last_peak_mg;      // Peak of the last impact
+} fall_stats_t;
+
+typedef struct {
+    // Thresholds in squared LSB and durations in frames, from the config
+    uint32_t free_fall_sq;
+    uint32_t impact_sq;
+    uint32_t still_lo_sq;
+    uint32_t still_hi_sq;
+    uint32_t free_fall_frames;
+    uint32_t window_frames;
+    uint32_t settle_frames;
+    uint32_t post_frames;
+    uint32_t recovery_frames;
+    uint32_t tilt_cos2_q15;
+    uint8_t still_pct;
+    uint16_t lsb_per_g;
+
+    fall_state_t state;
+    uint32_t state_frames;      // Frames since entering state
+    uint32_t run;               // Free fall run, still frames or upright frames
+    uint32_t peak_sq;
+    int32_t lp[3];              // Gravity low-pass, LSB << FALL_LP_SHIFT
+    int32_t ref[3];             // Orientation before the fall, LSB
+    size_t event_index;         // Frame of the last event within the batch
+
+    fall_stats_t stats;
+} fall_detector_t;
+
+void fall_detector_init(fall_detector_t *det, const fall_detector_config_t *config);
+
+// Runs a batch of frames, returns the last event of the batch.
+// det->event_index tells which frame produced it.
+fall_event_t fall_detector_process(fall_detector_t *det, const imu_frame_t *frames, size_t count);
+
+#endif // FALL_DETECTOR_H
@@ -1,23 +1,24 @@
 #ifndef GLOBAL_VARS_H
 #define GLOBAL_VARS_H
 
-#include "freertos/FreeRTOS.h"   // For BaseType_t, etc.
-#include "freertos/semphr.h"     // For SemaphoreHandle_t
+#include <stdatomic.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/event_groups.h"
 #include "common_types.h"        // For emergency_type_t
-
-// --- Global variables for sensor readings ---
-// These are defined in main.c
-extern volatile float g_temperature;
-extern volatile float g_pressure;
-extern volatile float g_humidity;
+#include "sensor_snapshot.h"     // Sensor readings are published as snapshots
 
 // --- Global variable for current emergency state ---
-// Defined in main.c
-extern volatile emergency_type_t g_current_emergency_type;
+// Defined in main.c, a single word so loads and stores are atomic on both cores
+extern _Atomic emergency_type_t g_current_emergency_type;
 
-// --- Mutex for display access and emergency state ---
-// Defined in main.c
-extern SemaphoreHandle_t g_display_mutex;
+// --- Boot progress ---
+// Set by the concurrent init stages, app_main records when each one lands
+#define BOOT_BIT_DISPLAY        (1 << 0)    // Display up, splash shown
+#define BOOT_BIT_IMU            (1 << 1)    // Fall detection armed
+#define BOOT_BIT_ENV            (1 << 2)    // BME690 calibrated and acquiring
+#define BOOT_BIT_FIRST_SAMPLE   (1 << 3)    // First sample went through the alarm engine
+#define BOOT_BITS_ALL           0x0F
 
-#endif // GLOBAL_VARS_H
+extern EventGroupHandle_t g_boot_events;
 
+#endif // GLOBAL_VARS_H
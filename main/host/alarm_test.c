@@ -0,0 +1,255 @@
+// Steps alarm_engine through scripted sample sequences and checks when rules
+// raise and clear: sustain timing, hysteresis bands, the gas baseline freeze
+// during an alarm, rate rules over the real sensor_history, priorities with
+// an external type, and the ALARM records sent to the journal.
+//
+// The rule table is the one main.c runs. Samples come every second, the
+// history interval, unless a case says otherwise.
+#include <stdio.h>
+#include <string.h>
+#include "alarm_engine.h"
+#include "binlog.h"
+#include "global_vars.h"
+#include "journal.h"
+
+static const alarm_rule_def_t rules[] = {
+    { .type = EMERGENCY_TYPE_GAS, .source = ALARM_SRC_GAS_RATIO, .compare = ALARM_BELOW,
+      .threshold = 60, .hysteresis = 15, .sustain_ms = 3000 },
+    { .type = EMERGENCY_TYPE_HEAT, .source = ALARM_SRC_LEVEL, .channel = HIST_CH_TEMPERATURE,
+      .compare = ALARM_ABOVE, .threshold = 4500, .hysteresis = 200, .sustain_ms = 10000 },
+    { .type = EMERGENCY_TYPE_HEAT, .source = ALARM_SRC_RATE, .channel = HIST_CH_TEMPERATURE,
+      .compare = ALARM_ABOVE, .threshold = 200, .hysteresis = 50, .window_ms = 60000 },
+    { .type = EMERGENCY_TYPE_DANGER, .source = ALARM_SRC_RATE, .channel = HIST_CH_PRESSURE,
+      .compare = ALARM_BELOW, .threshold = -100, .hysteresis = 30, .window_ms = 120000 },
+};
+
+static const alarm_config_t config = {
+    .rules = rules,
+    .rule_count = sizeof(rules) / sizeof(rules[0]),
+    .priority = {
+        [EMERGENCY_TYPE_DANGER] = 1,
+        [EMERGENCY_TYPE_HEAT] = 2,
+        [EMERGENCY_TYPE_GAS] = 3,
+        [EMERGENCY_TYPE_FALL] = 4,
+    },
+};
+
+// --- Stand-ins for the firmware the engine links against ---
+
+_Atomic emergency_type_t g_current_emergency_type = EMERGENCY_TYPE_NONE;
+
+static journal_alarm_t s_journal[32];
+static int s_journal_count;
+
+uint32_t esp_cpu_get_cycle_count(void) {
+    return 0;
+}
+
+void binlog_record(binlog_id_t id, uint32_t a0, uint32_t a1, uint32_t a2, uint32_t a3, uint32_t a4) {
+    (void)id, (void)a0, (void)a1, (void)a2, (void)a3, (void)a4;
+}
+
+bool journal_append(journal_rec_type_t type, const void *payload, size_t len) {
+    if (type == JOURNAL_REC_ALARM && len == sizeof(journal_alarm_t) &&
+        s_journal_count < (int)(sizeof(s_journal) / sizeof(s_journal[0]))) {
+        memcpy(&s_journal[s_journal_count++], payload, len);
+    }
+    return true;
+}
+
+// --- Sample script ---
+
+static bme_sample_t s_sample;
+static int s_failures;
+
+static void reset(void) {
+    sensor_history_init(1000);
+    alarm_engine_set_external(EMERGENCY_TYPE_FALL, false);
+    alarm_engine_init(&config);
+    memset(&s_sample, 0, sizeof(s_sample));
+    s_sample.timestamp_us = 1000000;
+    s_sample.heater_step = -1;
+    s_sample.reading.temperature = 2300;
+    s_sample.reading.pressure = 101325;
+    s_sample.reading.humidity = 45000;
+    s_journal_count = 0;
+}
+
+// Feeds samples until ms have passed, the current reading repeated
+static void run_for(uint32_t ms, uint32_t step_ms) {
+    for (uint32_t t = 0; t < ms; t += step_ms) {
+        s_sample.timestamp_us += step_ms * 1000LL;
+        s_sample.seq++;
+        sensor_history_push(&s_sample);
+        alarm_engine_evaluate(&s_sample);
+    }
+}
+
+// Feeds samples until the type is raised (or cleared), returns the ms it took or -1
+static int32_t run_until(emergency_type_t type, bool active, uint32_t limit_ms) {
+    for (uint32_t t = 1000; t <= limit_ms; t += 1000) {
+        run_for(1000, 1000);
+        if (((alarm_engine_active_mask() >> type) & 1) == active) {
+            return (int32_t)t;
+        }
+    }
+    return -1;
+}
+
+static void expect(const char *what, long got, long want) {
+    if (got != want) {
+        printf("FAIL %s: %ld, expected %ld\n", what, got, want);
+        s_failures++;
+    }
+}
+
+static bool active(emergency_type_t type) {
+    return (alarm_engine_active_mask() >> type) & 1;
+}
+
+// --- Cases ---
+
+static void level_sustain(void) {
+    reset();
+
+    // Above the threshold for less than the sustain time never raises
+    s_sample.reading.temperature = 4600;
+    run_for(9000, 1000);
+    s_sample.reading.temperature = 4400;
+    run_for(1000, 1000);
+    expect("short excursion raised", active(EMERGENCY_TYPE_HEAT), 0);
+
+    // A dip restarts the sustain timer, then 10 s above raises
+    s_sample.reading.temperature = 4600;
+    expect("heat raised after", run_until(EMERGENCY_TYPE_HEAT, true, 30000), 11000);
+    expect("current type", atomic_load(&g_current_emergency_type), EMERGENCY_TYPE_HEAT);
+}
+
+static void level_hysteresis(void) {
+    reset();
+    s_sample.reading.temperature = 4600;
+    run_until(EMERGENCY_TYPE_HEAT, true, 30000);
+
+    // Inside the band between the clear level and the threshold it stays up
+    s_sample.reading.temperature = 4400;
+    run_for(60000, 1000);
+    expect("cleared inside hysteresis", active(EMERGENCY_TYPE_HEAT), 1);
+    s_sample.reading.temperature = 4300;
+    run_for(1000, 1000);
+    expect("cleared at the clear level", active(EMERGENCY_TYPE_HEAT), 1);
+
+    // Below it clears on the next sample, no sustain on the way down
+    s_sample.reading.temperature = 4299;
+    run_for(1000, 1000);
+    expect("cleared below the band", active(EMERGENCY_TYPE_HEAT), 0);
+    expect("current type", atomic_load(&g_current_emergency_type), EMERGENCY_TYPE_NONE);
+}
+
+static void gas_baseline(void) {
+    reset();
+    s_sample.heater_step = 3;
+    s_sample.status = STATUS_GAS_VALID | STATUS_HEAT_STAB;
+    s_sample.reading.gas_resistance = 100000;
+
+    // No ratio until the step has its warm-up samples
+    s_sample.reading.gas_resistance = 30000;
+    run_for(10000, 1000);
+    expect("raised during warm-up", active(EMERGENCY_TYPE_GAS), 0);
+    s_sample.reading.gas_resistance = 100000;
+    run_for(200000, 1000);
+
+    // 50 % of baseline, below the 60 % threshold, for 3 s
+    s_sample.reading.gas_resistance = 50000;
+    expect("gas raised after", run_until(EMERGENCY_TYPE_GAS, true, 10000), 4000);
+
+    // A long event must not drag the baseline down and clear itself
+    run_for(600000, 1000);
+    expect("gas cleared by baseline drift", active(EMERGENCY_TYPE_GAS), 1);
+
+    // 70 % is inside the band up to 75 %, 80 % clears
+    s_sample.reading.gas_resistance = 70000;
+    run_for(5000, 1000);
+    expect("gas cleared inside hysteresis", active(EMERGENCY_TYPE_GAS), 1);
+    s_sample.reading.gas_resistance = 80000;
+    run_for(1000, 1000);
+    expect("gas cleared above the band", active(EMERGENCY_TYPE_GAS), 0);
+
+    // Samples without a stable heater are ignored
+    s_sample.status = STATUS_GAS_VALID;
+    s_sample.reading.gas_resistance = 10000;
+    run_for(10000, 1000);
+    expect("raised on an unstable heater", active(EMERGENCY_TYPE_GAS), 0);
+}
+
+static void temperature_rate(void) {
+    // A step in the first seconds of history is no trend yet
+    reset();
+    run_for(5000, 1000);
+    s_sample.reading.temperature += 100;
+    run_for(5000, 1000);
+    expect("rate raised on a short history", active(EMERGENCY_TYPE_HEAT), 0);
+
+    // Half a window of history first, the slope is not trusted before
+    reset();
+    run_for(30000, 1000);
+
+    // 3 degC per minute, above the 2 degC per minute threshold
+    int32_t raised = -1;
+    for (int32_t t = 1000; t <= 60000 && raised < 0; t += 1000) {
+        s_sample.reading.temperature += 5;
+        run_for(1000, 1000);
+        if (active(EMERGENCY_TYPE_HEAT)) {
+            raised = t;
+        }
+    }
+    expect("rate raised", raised > 0, 1);
+    expect("level rule stayed idle", s_sample.reading.temperature < 4500, 1);
+
+    // Flat again, the slope decays through the band and clears
+    expect("rate cleared", run_until(EMERGENCY_TYPE_HEAT, false, 120000) > 0, 1);
+}
+
+static void priority_and_journal(void) {
+    reset();
+
+    s_sample.reading.temperature = 4600;
+    run_until(EMERGENCY_TYPE_HEAT, true, 30000);
+    alarm_engine_set_external(EMERGENCY_TYPE_FALL, true);
+    expect("fall outranks heat", atomic_load(&g_current_emergency_type), EMERGENCY_TYPE_FALL);
+    alarm_engine_set_external(EMERGENCY_TYPE_FALL, false);
+    expect("heat back after fall", atomic_load(&g_current_emergency_type), EMERGENCY_TYPE_HEAT);
+    s_sample.reading.temperature = 2300;
+    run_for(1000, 1000);
+
+    // One record per change of the published type
+    expect("journal records", s_journal_count, 4);
+    if (s_journal_count == 4) {
+        expect("record 0", s_journal[0].from * 10 + s_journal[0].to, EMERGENCY_TYPE_NONE * 10 + EMERGENCY_TYPE_HEAT);
+        expect("record 1", s_journal[1].from * 10 + s_journal[1].to, EMERGENCY_TYPE_HEAT * 10 + EMERGENCY_TYPE_FALL);
+        expect("record 1 mask", s_journal[1].active_mask,
+               (1 << EMERGENCY_TYPE_HEAT) | (1 << EMERGENCY_TYPE_FALL));
+        expect("record 2", s_journal[2].from * 10 + s_journal[2].to, EMERGENCY_TYPE_FALL * 10 + EMERGENCY_TYPE_HEAT);
+        expect("record 3", s_journal[3].from * 10 + s_journal[3].to, EMERGENCY_TYPE_HEAT * 10 + EMERGENCY_TYPE_NONE);
+    }
+}
+
+int main(void) {
+    struct {
+        const char *name;
+        void (*run)(void);
+    } cases[] = {
+        {"level_sustain", level_sustain},
+        {"level_hysteresis", level_hysteresis},
+        {"gas_baseline", gas_baseline},
+        {"temperature_rate", temperature_rate},
+        {"priority_and_journal", priority_and_journal},
+    };
+
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        int before = s_failures;
+
+        cases[i].run();
+        printf("%-22s %s\n", cases[i].name, s_failures == before ? "ok" : "FAIL");
+    }
+    return s_failures == 0 ? 0 : 1;
+}
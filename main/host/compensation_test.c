@@ -0,0 +1,159 @@
+// Compares the integer BME690 compensation with the float reference.
+//
+// Sweeps a typical calibration and randomly perturbed ones, and for each the
+// raw temperature, pressure and humidity ADC values over the sensor's
+// operating range (-40..85 degC, 300..1100 hPa, 0..100 %RH), plus every gas
+// ADC value and range. Pressure and humidity are compensated with the t_fine
+// of each path, as compensate_reading() does. Prints the largest difference
+// per quantity and fails when one is above its limit.
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "bme_compensation.h"
+
+#define TEST_CALIBRATIONS   64      // Perturbed sets after the typical one
+#define TEST_TEMPERATURES   32      // Temperatures per calibration for P and H
+#define TEST_ADC_T_STEP     61
+#define TEST_ADC_P_STEP     97
+#define TEST_ADC_H_STEP     7
+
+// Limits, the measured maximum with some margin. Pressure is the truncation of
+// the Bosch integer formula itself, largest near 1100 hPa.
+#define MAX_ERR_T_DEGC      0.01
+#define MAX_ERR_P_PA        16.0
+#define MAX_ERR_H_RH        0.1
+#define MAX_ERR_GAS_REL     0.001
+
+typedef struct {
+    const char *name;
+    double max;
+    double limit;
+    char where[96];
+} max_err_t;
+
+// Coefficients of a BME680/690 part, the spread is what each one is moved by
+static const bme_calib_data_t typical = {
+    .par_t1 = 26148, .par_t2 = 26350, .par_t3 = 3,
+    .par_p1 = 37095, .par_p2 = -10432, .par_p3 = 88, .par_p4 = 6513, .par_p5 = -87,
+    .par_p6 = 30, .par_p7 = 36, .par_p8 = -2716, .par_p9 = -1616, .par_p10 = 30,
+    .par_h1 = 763, .par_h2 = 1030, .par_h3 = 0, .par_h4 = 45, .par_h5 = 20, .par_h6 = 120, .par_h7 = -100,
+};
+
+static int spread(int value, int delta, int lo, int hi) {
+    value += rand() % (2 * delta + 1) - delta;
+    return value < lo ? lo : (value > hi ? hi : value);
+}
+
+static void perturb(bme_calib_data_t *cal) {
+    *cal = typical;
+    cal->par_t1 = spread(cal->par_t1, 1500, 0, UINT16_MAX);
+    cal->par_t2 = spread(cal->par_t2, 1500, INT16_MIN, INT16_MAX);
+    cal->par_t3 = spread(cal->par_t3, 3, INT8_MIN, INT8_MAX);
+    cal->par_p1 = spread(cal->par_p1, 2000, 0, UINT16_MAX);
+    cal->par_p2 = spread(cal->par_p2, 800, INT16_MIN, INT16_MAX);
+    cal->par_p3 = spread(cal->par_p3, 10, INT8_MIN, INT8_MAX);
+    cal->par_p4 = spread(cal->par_p4, 1500, INT16_MIN, INT16_MAX);
+    cal->par_p5 = spread(cal->par_p5, 100, INT16_MIN, INT16_MAX);
+    cal->par_p6 = spread(cal->par_p6, 10, INT8_MIN, INT8_MAX);
+    cal->par_p7 = spread(cal->par_p7, 20, INT8_MIN, INT8_MAX);
+    cal->par_p8 = spread(cal->par_p8, 1000, INT16_MIN, INT16_MAX);
+    cal->par_p9 = spread(cal->par_p9, 1000, INT16_MIN, INT16_MAX);
+    cal->par_p10 = spread(cal->par_p10, 10, 0, UINT8_MAX);
+    cal->par_h1 = spread(cal->par_h1, 100, 0, 4095);
+    cal->par_h2 = spread(cal->par_h2, 100, 0, 4095);
+    cal->par_h3 = spread(cal->par_h3, 5, INT8_MIN, INT8_MAX);
+    cal->par_h4 = spread(cal->par_h4, 10, INT8_MIN, INT8_MAX);
+    cal->par_h5 = spread(cal->par_h5, 10, INT8_MIN, INT8_MAX);
+    cal->par_h6 = spread(cal->par_h6, 20, 0, UINT8_MAX);
+    cal->par_h7 = spread(cal->par_h7, 20, INT8_MIN, INT8_MAX);
+}
+
+static void track(max_err_t *e, double err, int set, const char *what, long adc, double ref) {
+    if (err > e->max) {
+        e->max = err;
+        snprintf(e->where, sizeof(e->where), "set %d, %s %ld, reference %.3f", set, what, adc, ref);
+    }
+}
+
+static void sweep_calibration(int set, max_err_t *t_err, max_err_t *p_err, max_err_t *h_err) {
+    int32_t adc_t[(1 << 20) / TEST_ADC_T_STEP + 1];
+    int n = 0;
+
+    // Temperature over the whole range
+    for (int32_t adc_T = 0; adc_T < (1 << 20); adc_T += TEST_ADC_T_STEP) {
+        float ref = compensate_temperature(adc_T);
+        int32_t t_fine;
+
+        if (ref < -40.0f || ref > 85.0f) {
+            continue;
+        }
+        track(t_err, fabs(compensate_temperature_fixed(adc_T, &t_fine) / 100.0 - ref), set, "adc_T", adc_T, ref);
+        adc_t[n++] = adc_T;
+    }
+
+    // Pressure and humidity at temperatures spread over the range
+    for (int i = 0; i < TEST_TEMPERATURES && n > 0; i++) {
+        int32_t adc_T = adc_t[(long)i * (n - 1) / (TEST_TEMPERATURES - 1)], t_fine;
+
+        compensate_temperature_fixed(adc_T, &t_fine);
+        for (int32_t adc_P = 0; adc_P < (1 << 20); adc_P += TEST_ADC_P_STEP) {
+            compensate_temperature(adc_T);      // Float t_fine for the reference
+            float ref = compensate_pressure(adc_P);
+
+            if (ref < 30000.0f || ref > 110000.0f) {
+                continue;
+            }
+            track(p_err, fabs((double)compensate_pressure_fixed(adc_P, t_fine) - ref), set, "adc_P", adc_P, ref);
+        }
+        for (int32_t adc_H = 0; adc_H < (1 << 16); adc_H += TEST_ADC_H_STEP) {
+            compensate_temperature(adc_T);
+            float ref = compensate_humidity(adc_H);
+
+            track(h_err, fabs(compensate_humidity_fixed(adc_H, t_fine) / 1000.0 - ref), set, "adc_H", adc_H, ref);
+        }
+    }
+}
+
+static bool report(const max_err_t *e) {
+    bool ok = e->max <= e->limit;
+
+    printf("%-12s max %10.5f limit %8.4f %-4s (%s)\n", e->name, e->max, e->limit, ok ? "ok" : "FAIL", e->where);
+    return ok;
+}
+
+int main(void) {
+    max_err_t t_err = {"T degC", 0, MAX_ERR_T_DEGC, ""};
+    max_err_t p_err = {"P Pa", 0, MAX_ERR_P_PA, ""};
+    max_err_t h_err = {"H %RH", 0, MAX_ERR_H_RH, ""};
+    max_err_t g_err = {"gas rel", 0, MAX_ERR_GAS_REL, ""};
+    bme_calib_data_t cal;
+    bool ok = true;
+
+    srand(1);
+    for (int set = 0; set <= TEST_CALIBRATIONS; set++) {
+        if (set == 0) {
+            cal = typical;
+        } else {
+            perturb(&cal);
+        }
+        set_calibration(&cal);
+        sweep_calibration(set, &t_err, &p_err, &h_err);
+    }
+
+    // Gas does not depend on calibration in the high-range formula
+    for (uint8_t range = 0; range < 16; range++) {
+        for (uint16_t adc = 0; adc < 1024; adc++) {
+            float ref = compensate_gas(adc, range);
+
+            track(&g_err, fabs(compensate_gas_fixed(adc, range) - ref) / ref, range, "gas_adc", adc, ref);
+        }
+    }
+
+    printf("%d calibrations\n", TEST_CALIBRATIONS + 1);
+    ok &= report(&t_err);
+    ok &= report(&p_err);
+    ok &= report(&h_err);
+    ok &= report(&g_err);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,185 @@
+// Replays accelerometer traces through fall_detector in FIFO-sized batches.
+//
+// For each trace it prints the detector events, the detection latency and the
+// time per batch. Latency runs from the trace's impact_us to the last frame of
+// the batch that reported the impact, which is when the watermark interrupt
+// hands the batch over on the device. Time is host time, in nanoseconds and,
+// on x86, TSC cycles. The ESP32 figures come from the profiler on the device.
+//
+// A trace fails when it misses its expected outcome (see gen_fall_traces.py),
+// or when a fall is reported later than REPLAY_MAX_LATENCY_MS after impact.
+//
+// Usage: fall_replay [-b frames_per_batch] trace.csv...
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define REPLAY_CYCLES() __rdtsc()
+#else
+#define REPLAY_CYCLES() 0ULL
+#endif
+#include "fall_detector.h"
+
+#define REPLAY_LSB_PER_G        4096    // IMU_ACC_RANGE_8G, as main.c configures it
+#define REPLAY_BATCH_FRAMES     16      // main.c watermark
+#define REPLAY_MAX_FRAMES       40000
+#define REPLAY_MAX_LATENCY_MS   100
+
+typedef struct {
+    const char *path;
+    char expect[16];
+    int64_t impact_us;          // -1 when the trace has no impact
+    size_t count;
+    int64_t t_us[REPLAY_MAX_FRAMES];
+    imu_frame_t frames[REPLAY_MAX_FRAMES];
+} trace_t;
+
+static const char *const event_names[] = {"none", "impact", "confirmed", "cancelled", "recovered"};
+
+static bool load_trace(trace_t *t, const char *path) {
+    FILE *f = fopen(path, "r");
+    char line[256];
+
+    if (f == NULL) {
+        perror(path);
+        return false;
+    }
+    t->path = path;
+    strcpy(t->expect, "none");
+    t->impact_us = -1;
+    t->count = 0;
+
+    while (t->count < REPLAY_MAX_FRAMES && fgets(line, sizeof(line), f) != NULL) {
+        long long us;
+        int ax, ay, az;
+
+        if (line[0] == '#') {
+            sscanf(line, "# expect=%15s", t->expect);
+            if (sscanf(line, "# impact_us=%lld", &us) == 1) {
+                t->impact_us = us;
+            }
+            continue;
+        }
+        if (sscanf(line, "%lld,%d,%d,%d", &us, &ax, &ay, &az) != 4) {
+            continue;           // Column header
+        }
+        // mg to LSB
+        t->t_us[t->count] = us;
+        t->frames[t->count].acc.x = (int16_t)(ax * REPLAY_LSB_PER_G / 1000);
+        t->frames[t->count].acc.y = (int16_t)(ay * REPLAY_LSB_PER_G / 1000);
+        t->frames[t->count].acc.z = (int16_t)(az * REPLAY_LSB_PER_G / 1000);
+        t->count++;
+    }
+    fclose(f);
+    return t->count > 1;
+}
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static bool replay(const trace_t *t, size_t batch) {
+    fall_detector_config_t config = FALL_DETECTOR_DEFAULT_CONFIG(REPLAY_LSB_PER_G,
+                                                                 (uint32_t)(t->t_us[1] - t->t_us[0]));
+    fall_detector_t det;
+    uint64_t ns_sum = 0, ns_max = 0, cyc_sum = 0, cyc_max = 0;
+    int64_t impact_at = -1, alarm_since = -1, alarm_us = 0, latency_us = -1;
+    bool alarm = false, confirmed = false, any_event = false, ok;
+    size_t batches = 0;
+
+    fall_detector_init(&det, &config);
+    printf("%s (expect %s)\n", t->path, t->expect);
+
+    for (size_t start = 0; start + batch <= t->count; start += batch) {
+        int64_t batch_end_us = t->t_us[start + batch - 1];
+        uint64_t ns = now_ns(), cyc = REPLAY_CYCLES();
+        fall_event_t ev = fall_detector_process(&det, &t->frames[start], batch);
+
+        cyc = REPLAY_CYCLES() - cyc;
+        ns = now_ns() - ns;
+        ns_sum += ns;
+        cyc_sum += cyc;
+        ns_max = ns > ns_max ? ns : ns_max;
+        cyc_max = cyc > cyc_max ? cyc : cyc_max;
+        batches++;
+
+        if (ev == FALL_EVENT_NONE) {
+            continue;
+        }
+        any_event = true;
+        printf("  %8.3f s  %-9s (frame at %.3f s)\n", batch_end_us / 1e6, event_names[ev],
+               t->t_us[start + det.event_index] / 1e6);
+
+        // Same alarm handling as motion_logic.c
+        bool raise = ev == FALL_EVENT_IMPACT || ev == FALL_EVENT_CONFIRMED;
+        if (raise && !alarm) {
+            alarm_since = batch_end_us;
+        } else if (!raise && alarm) {
+            alarm_us += batch_end_us - alarm_since;
+        }
+        alarm = raise;
+        if (ev == FALL_EVENT_IMPACT && impact_at < 0) {
+            impact_at = batch_end_us;
+            if (t->impact_us >= 0) {
+                latency_us = batch_end_us - t->impact_us;
+            }
+        }
+        confirmed |= ev == FALL_EVENT_CONFIRMED;
+    }
+    if (alarm) {
+        alarm_us += t->t_us[t->count - 1] - alarm_since;
+    }
+
+    if (strcmp(t->expect, "confirmed") == 0) {
+        ok = confirmed && latency_us >= 0 && latency_us <= REPLAY_MAX_LATENCY_MS * 1000;
+    } else if (strcmp(t->expect, "cancelled") == 0) {
+        ok = !confirmed && !alarm;
+    } else {
+        ok = !any_event;
+    }
+
+    if (latency_us >= 0) {
+        printf("  impact reported %.1f ms after impact\n", latency_us / 1e3);
+    }
+    if (alarm_us > 0) {
+        printf("  fall alarm up for %.1f ms%s\n", alarm_us / 1e3, alarm ? ", still up at the end" : "");
+    }
+    printf("  %zu batches of %zu frames: %.0f ns avg, %llu ns max", batches, batch,
+           (double)ns_sum / batches, (unsigned long long)ns_max);
+    if (cyc_sum > 0) {
+        printf(", %.0f cycles avg, %llu max", (double)cyc_sum / batches, (unsigned long long)cyc_max);
+    }
+    printf("\n  %s\n", ok ? "ok" : "FAIL");
+    return ok;
+}
+
+int main(int argc, char **argv) {
+    static trace_t trace;
+    size_t batch = REPLAY_BATCH_FRAMES;
+    bool ok = true;
+    int i = 1;
+
+    if (argc > 2 && strcmp(argv[1], "-b") == 0) {
+        batch = strtoul(argv[2], NULL, 10);
+        i = 3;
+    }
+    if (i >= argc || batch == 0) {
+        fprintf(stderr, "usage: %s [-b frames_per_batch] trace.csv...\n", argv[0]);
+        return 2;
+    }
+    for (; i < argc; i++) {
+        if (!load_trace(&trace, argv[i])) {
+            fprintf(stderr, "%s: no frames\n", argv[i]);
+            ok = false;
+            continue;
+        }
+        ok &= replay(&trace, batch);
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,108 @@
+#!/usr/bin/env python3
+"""Writes synthetic accelerometer traces for fall_replay.
+
+Each trace is a CSV of t_us,ax,ay,az in mg at 400 Hz, the device rate. Lines
+starting with '#' carry what fall_replay checks:
+  # expect=confirmed|cancelled|none   outcome the detector must reach
+  # impact_us=<t>                      ground truth impact time, for latency
+
+The shapes follow published fall and activity recordings qualitatively, with
+sensor noise on top. They are not device recordings; a CSV recorded on the
+device in the same format can be replayed the same way.
+
+Usage: gen_fall_traces.py <output dir>
+"""
+import math
+import os
+import random
+import sys
+
+RATE_HZ = 400
+NOISE_MG = 15
+
+
+def walking(t):
+    phase = 2 * math.pi * 1.8 * t
+    return (150 * math.sin(phase), 50 * math.sin(phase / 2), 1000 + 300 * math.sin(phase))
+
+
+def half_sine(t, start, length, peak):
+    if start <= t < start + length:
+        return peak * math.sin(math.pi * (t - start) / length)
+    return 0.0
+
+
+def bounce(t, start, length, peak, hz):
+    if start <= t < start + length:
+        return peak * math.exp(-5 * (t - start) / length) * math.sin(2 * math.pi * hz * (t - start))
+    return 0.0
+
+
+def fall_forward(t):
+    """Walking, 350 ms free fall, 5 g impact, then lying still on the side."""
+    if t < 3.0:
+        return walking(t)
+    if t < 3.35:
+        return (60, 40, 90)
+    if t < 3.9:
+        return (1000 + half_sine(t, 3.35, 0.05, 3500) + bounce(t, 3.35, 0.55, 900, 9),
+                -half_sine(t, 3.35, 0.05, 1500),
+                half_sine(t, 3.35, 0.05, 3000) + bounce(t, 3.35, 0.55, 600, 7))
+    breathing = 20 * math.sin(2 * math.pi * 0.25 * t)
+    return (1000 + breathing, 60, 80)
+
+
+def sit_hard(t):
+    """Standing, knees bend, 100 ms drop into a chair, 3.2 g landing, seated upright."""
+    if t < 2.0:
+        return (20, 10, 1000)
+    if t < 2.25:
+        return (40, 10, 1000 - 450 * math.sin(math.pi * (t - 2.0) / 0.5))
+    if t < 2.35:
+        return (30, 10, 250)
+    if t < 2.8:
+        return (80 + half_sine(t, 2.35, 0.04, 600),
+                10,
+                990 + half_sine(t, 2.35, 0.04, 2200) + bounce(t, 2.35, 0.45, 250, 6))
+    # Seated, leaning back a little
+    return (170, 10, 985)
+
+
+def lie_down(t):
+    """Standing, then lying down on a bed over two seconds, no drop and no impact."""
+    if t < 2.0:
+        return (20, 10, 1000)
+    if t < 4.0:
+        angle = (math.pi / 2) * (1 - math.cos(math.pi * (t - 2.0) / 2.0)) / 2
+        sway = 80 * math.sin(2 * math.pi * 1.5 * t)
+        return (1000 * math.sin(angle) + sway, 10, 1000 * math.cos(angle) + sway)
+    return (1000, 10, 30)
+
+
+TRACES = [
+    ("fall_forward", fall_forward, 8.0, "confirmed", 3.35),
+    ("sit_hard", sit_hard, 6.0, "cancelled", 2.35),
+    ("lie_down", lie_down, 8.0, "none", None),
+]
+
+
+def main():
+    out_dir = sys.argv[1]
+    os.makedirs(out_dir, exist_ok=True)
+    random.seed(1)
+
+    for name, shape, seconds, expect, impact_s in TRACES:
+        with open(os.path.join(out_dir, name + ".csv"), "w") as f:
+            f.write("# %s, synthetic, %d Hz\n" % (name, RATE_HZ))
+            f.write("# expect=%s\n" % expect)
+            if impact_s is not None:
+                f.write("# impact_us=%d\n" % round(impact_s * 1e6))
+            f.write("t_us,ax,ay,az\n")
+            for n in range(int(seconds * RATE_HZ)):
+                t = n / RATE_HZ
+                a = shape(t)
+                f.write("%d,%d,%d,%d\n" % (round(t * 1e6), *(round(v + random.gauss(0, NOISE_MG)) for v in a)))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,180 @@
+// Checks sensor_history's running sums and min/max deques against a brute
+// force recomputation after every push.
+//
+// Samples land on a 100 ms grid with random gaps, some closer than the
+// minimum interval so the filter drops them. Each trace is long enough to
+// wrap the ring several times. The windows cover fewer records than the
+// ring, about as many, and more, so records leave them both by age and by
+// slot reuse. One trace starts just before the 32-bit millisecond clock
+// wraps. On the grid the regression is exact, so the slope must match the
+// recomputed one to the unit.
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "sensor_history.h"
+
+#define TEST_PUSHES         6000
+#define TEST_MIN_INTERVAL   300     // ms
+#define TEST_GRID_MS        100     // HIST_SLOPE_UNIT_MS
+
+typedef struct {
+    int64_t t_ms;                   // Unwrapped
+    int32_t value[HIST_CH_COUNT];
+} ref_record_t;
+
+static const uint32_t windows_ms[] = {10000, 60000, 600000};
+
+static ref_record_t s_ref[TEST_PUSHES];
+static int s_ref_count;
+static int s_failures;
+
+static void fail(const char *trace, int push, int window, int ch, const char *what, long got, long want) {
+    if (s_failures++ < 10) {
+        printf("%s: push %d window %d channel %d: %s %ld, expected %ld\n", trace, push, window, ch, what, got, want);
+    }
+}
+
+// Recomputes one window over the last SENSOR_HISTORY_CAPACITY records
+static bool ref_stats(int window, int ch, sensor_history_stats_t *out) {
+    const ref_record_t *newest = &s_ref[s_ref_count - 1];
+    int first = s_ref_count - 1;
+    int64_t n, sum_t = 0, sum_tt = 0, sum_y = 0, sum_ty = 0;
+    int32_t base = s_ref[0].value[ch];
+
+    while (first > 0 && s_ref_count - first < SENSOR_HISTORY_CAPACITY &&
+           newest->t_ms - s_ref[first - 1].t_ms <= windows_ms[window]) {
+        first--;
+    }
+    n = s_ref_count - first;
+    out->min = out->max = newest->value[ch];
+    for (int i = first; i < s_ref_count; i++) {
+        int64_t t = (s_ref[i].t_ms - s_ref[first].t_ms) / TEST_GRID_MS;
+        int32_t y = s_ref[i].value[ch] - base;
+
+        out->min = s_ref[i].value[ch] < out->min ? s_ref[i].value[ch] : out->min;
+        out->max = s_ref[i].value[ch] > out->max ? s_ref[i].value[ch] : out->max;
+        sum_t += t;
+        sum_tt += t * t;
+        sum_y += y;
+        sum_ty += t * y;
+    }
+
+    int64_t den = n * sum_tt - sum_t * sum_t;
+    int64_t num = n * sum_ty - sum_t * sum_y;
+
+    out->mean = base + (int32_t)(sum_y / n);
+    out->slope_per_min = den != 0 ? (int32_t)((num * (60000 / TEST_GRID_MS)) / den) : 0;
+    out->count = (uint16_t)n;
+    out->span_ms = (uint32_t)(newest->t_ms - s_ref[first].t_ms);
+    return true;
+}
+
+static void check(const char *trace, int push, const int *ids) {
+    for (int w = 0; w < (int)(sizeof(windows_ms) / sizeof(windows_ms[0])); w++) {
+        for (int ch = 0; ch < HIST_CH_COUNT; ch++) {
+            sensor_history_stats_t got, want;
+
+            if (!sensor_history_query(ids[w], ch, &got)) {
+                fail(trace, push, w, ch, "query", 0, 1);
+                continue;
+            }
+            ref_stats(w, ch, &want);
+            if (got.count != want.count) {
+                fail(trace, push, w, ch, "count", got.count, want.count);
+            }
+            if (got.span_ms != want.span_ms) {
+                fail(trace, push, w, ch, "span", got.span_ms, want.span_ms);
+            }
+            if (got.min != want.min) {
+                fail(trace, push, w, ch, "min", got.min, want.min);
+            }
+            if (got.max != want.max) {
+                fail(trace, push, w, ch, "max", got.max, want.max);
+            }
+            if (got.mean != want.mean) {
+                fail(trace, push, w, ch, "mean", got.mean, want.mean);
+            }
+            if (got.slope_per_min != want.slope_per_min) {
+                fail(trace, push, w, ch, "slope", got.slope_per_min, want.slope_per_min);
+            }
+        }
+    }
+}
+
+static void check_recent(const char *trace) {
+    int32_t out[SENSOR_HISTORY_CAPACITY];
+    uint16_t n = sensor_history_recent(HIST_CH_PRESSURE, out, SENSOR_HISTORY_CAPACITY);
+    uint16_t want = s_ref_count < SENSOR_HISTORY_CAPACITY ? s_ref_count : SENSOR_HISTORY_CAPACITY;
+
+    if (n != want) {
+        fail(trace, s_ref_count, -1, HIST_CH_PRESSURE, "recent count", n, want);
+        return;
+    }
+    for (uint16_t i = 0; i < n; i++) {
+        int32_t v = s_ref[s_ref_count - n + i].value[HIST_CH_PRESSURE];
+        if (out[i] != v) {
+            fail(trace, s_ref_count, -1, HIST_CH_PRESSURE, "recent value", out[i], v);
+            return;
+        }
+    }
+}
+
+static int32_t walk(int32_t v, int32_t step, int32_t lo, int32_t hi) {
+    v += rand() % (2 * step + 1) - step;
+    return v < lo ? lo : (v > hi ? hi : v);
+}
+
+static void run_trace(const char *trace, int64_t start_ms) {
+    bme_sample_t sample = {0};
+    int64_t t_ms = start_ms, last_ms = 0;
+    int32_t temp = 2300, press = 101325, hum = 45000;
+    int ids[sizeof(windows_ms) / sizeof(windows_ms[0])];
+
+    sensor_history_init(TEST_MIN_INTERVAL);
+    for (size_t w = 0; w < sizeof(windows_ms) / sizeof(windows_ms[0]); w++) {
+        ids[w] = sensor_history_add_window(windows_ms[w]);
+    }
+    s_ref_count = 0;
+
+    for (int push = 0; push < TEST_PUSHES; push++) {
+        // Mostly regular, with the odd burst and the odd long gap
+        int r = rand() % 20;
+        t_ms += TEST_GRID_MS * (r == 0 ? 1 : (r == 1 ? 1 + rand() % 300 : 3 + rand() % 5));
+        temp = walk(temp, 8, -4000, 8500);
+        press = walk(press, 6, 95000, 108000);
+        hum = walk(hum, 200, 0, 100000);
+
+        sample.timestamp_us = t_ms * 1000;
+        sample.seq++;
+        sample.reading.temperature = (int16_t)temp;
+        sample.reading.pressure = (uint32_t)press;
+        sample.reading.humidity = (uint32_t)hum;
+        sensor_history_push(&sample);
+
+        // The history keeps 32-bit milliseconds, the filter works on those
+        if (s_ref_count == 0 || (uint32_t)(t_ms - last_ms) >= TEST_MIN_INTERVAL) {
+            ref_record_t *ref = &s_ref[s_ref_count++];
+            ref->t_ms = t_ms;
+            ref->value[HIST_CH_TEMPERATURE] = temp;
+            ref->value[HIST_CH_PRESSURE] = press;
+            ref->value[HIST_CH_HUMIDITY] = hum / 10;
+            last_ms = t_ms;
+        }
+        check(trace, push, ids);
+    }
+    check_recent(trace);
+    printf("%-10s %d pushes, %d stored\n", trace, TEST_PUSHES, s_ref_count);
+}
+
+int main(void) {
+    srand(1);
+    run_trace("boot", 1000);
+    run_trace("ms_wrap", ((int64_t)1 << 32) - 300000);
+
+    if (s_failures > 0) {
+        printf("%d mismatches\n", s_failures);
+        return 1;
+    }
+    printf("ok\n");
+    return 0;
+}
@@ -0,0 +1,323 @@
+// Runs the flash journal over a NOR flash fake the size of the "journal"
+// partition: programming can only clear bits, so writing over a record that
+// was not erased fails the test. Records go in through journal_benchmark, the
+// writer task's put path without the queue.
+//
+// Checks recovery on an empty partition, after wrapping the ring, and after a
+// power cut in the middle of a record, and that erases wait while held. Also
+// prints write throughput and recovery time on the host for a full partition.
+// On the host flash is memory, so these are the CPU side only; the device
+// figures come from CONFIG_JOURNAL_BENCHMARK_RECORDS.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "esp_partition.h"
+#include "esp_rom_crc.h"
+#include "esp_timer.h"
+#include "freertos/queue.h"
+#include "freertos/task.h"
+#include "journal.h"
+
+#define TEST_PARTITION_SIZE 0xB0000     // partitions.csv
+#define TEST_SECTORS        (TEST_PARTITION_SIZE / JOURNAL_SECTOR_SIZE)
+
+static uint8_t s_flash[TEST_PARTITION_SIZE];
+static const esp_partition_t s_part = {
+    .type = ESP_PARTITION_TYPE_DATA,
+    .subtype = JOURNAL_PARTITION_SUBTYPE,
+    .size = TEST_PARTITION_SIZE,
+    .erase_size = JOURNAL_SECTOR_SIZE,
+    .label = JOURNAL_PARTITION_LABEL,
+};
+static long s_cut_bytes = -1;           // Bytes programmed before the power cut, -1 for none
+static TickType_t s_ticks;
+static TickType_t s_release_at;         // Tick at which the hold is released, 0 for never
+static int s_failures;
+
+// --- Stand-ins for ESP-IDF and FreeRTOS ---
+
+const esp_partition_t *esp_partition_find_first(esp_partition_type_t type, esp_partition_subtype_t subtype,
+                                                const char *label) {
+    (void)type, (void)subtype, (void)label;
+    return &s_part;
+}
+
+esp_err_t esp_partition_read(const esp_partition_t *part, size_t offset, void *dst, size_t size) {
+    (void)part;
+    memcpy(dst, &s_flash[offset], size);
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_write(const esp_partition_t *part, size_t offset, const void *src, size_t size) {
+    const uint8_t *bytes = src;
+
+    (void)part;
+    for (size_t i = 0; i < size && s_cut_bytes != 0; i++) {
+        if ((s_flash[offset + i] & bytes[i]) != bytes[i]) {
+            printf("FAIL programming unerased flash at 0x%zx\n", offset + i);
+            exit(1);
+        }
+        s_flash[offset + i] &= bytes[i];
+        if (s_cut_bytes > 0) {
+            s_cut_bytes--;
+        }
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_erase_range(const esp_partition_t *part, size_t offset, size_t size) {
+    (void)part;
+    memset(&s_flash[offset], 0xFF, size);
+    return ESP_OK;
+}
+
+uint32_t esp_rom_crc32_le(uint32_t crc, const uint8_t *buf, uint32_t len) {
+    crc = ~crc;
+    while (len--) {
+        crc ^= *buf++;
+        for (int k = 0; k < 8; k++) {
+            crc = (crc >> 1) ^ (0xEDB88320u & -(crc & 1));
+        }
+    }
+    return ~crc;
+}
+
+const char *esp_err_to_name(esp_err_t code) {
+    (void)code;
+    return "error";
+}
+
+int64_t esp_timer_get_time(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size) {
+    (void)length, (void)item_size;
+    return (QueueHandle_t)&s_part;      // Never dereferenced, the test does not queue
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t wait) {
+    (void)queue, (void)item, (void)wait;
+    return pdFALSE;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t wait) {
+    (void)queue, (void)item, (void)wait;
+    return pdFALSE;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name, uint32_t stack, void *arg,
+                                   UBaseType_t priority, TaskHandle_t *handle, BaseType_t core) {
+    (void)fn, (void)name, (void)stack, (void)arg, (void)priority, (void)handle, (void)core;
+    return pdPASS;
+}
+
+TickType_t xTaskGetTickCount(void) {
+    return s_ticks;
+}
+
+// Time passes only while the journal waits, the fall path releases the hold
+void vTaskDelay(TickType_t ticks) {
+    s_ticks += ticks > 0 ? ticks : 1;
+    if (s_release_at != 0 && (int32_t)(s_ticks - s_release_at) >= 0) {
+        journal_hold_erases(false);
+        s_release_at = 0;
+    }
+}
+
+// --- Helpers ---
+
+static void expect(const char *what, long got, long want) {
+    if (got != want) {
+        printf("FAIL %s: %ld, expected %ld\n", what, got, want);
+        s_failures++;
+    }
+}
+
+static void erase_all(void) {
+    memset(s_flash, 0xFF, sizeof(s_flash));
+}
+
+static journal_stats_t stats(void) {
+    journal_stats_t st;
+
+    journal_get_stats(&st);
+    return st;
+}
+
+// Bytes one benchmark record takes in flash, header and padding included
+static uint32_t record_bytes(void) {
+    journal_stats_t before = stats();
+
+    journal_benchmark(1);
+    return stats().bytes - before.bytes;
+}
+
+static uint32_t records_per_sector(void) {
+    return (JOURNAL_SECTOR_SIZE - sizeof(journal_sector_hdr_t)) / record_bytes();
+}
+
+// Walks the sectors back from the active one like a reader would, up to an
+// erased sector. Sequences must run back without a gap. Records are counted
+// up to the first one that fails its CRC, which is where the reader stops.
+static uint32_t check_ring(uint32_t active, uint32_t seq) {
+    uint32_t records = 0;
+
+    for (uint32_t k = 0; k < TEST_SECTORS; k++) {
+        uint32_t sector = (active + TEST_SECTORS - k) % TEST_SECTORS;
+        const uint8_t *base = &s_flash[sector * JOURNAL_SECTOR_SIZE];
+        journal_sector_hdr_t hdr;
+
+        memcpy(&hdr, base, sizeof(hdr));
+        if (hdr.magic == 0xFFFFFFFF) {
+            break;
+        }
+        if (hdr.magic != JOURNAL_SECTOR_MAGIC || hdr.seq != seq - k ||
+            hdr.crc != esp_rom_crc32_le(0, (const uint8_t *)&hdr, offsetof(journal_sector_hdr_t, crc))) {
+            printf("FAIL sector %u: seq %u, expected %u\n", (unsigned)sector, (unsigned)hdr.seq, (unsigned)(seq - k));
+            s_failures++;
+            break;
+        }
+        for (uint32_t off = sizeof(hdr); off + sizeof(journal_rec_hdr_t) <= JOURNAL_SECTOR_SIZE;) {
+            journal_rec_hdr_t rec;
+
+            memcpy(&rec, &base[off], sizeof(rec));
+            if (rec.type == 0xFF) {
+                break;
+            }
+            uint32_t crc = esp_rom_crc32_le(0, (const uint8_t *)&rec, offsetof(journal_rec_hdr_t, crc));
+            if (rec.len > JOURNAL_MAX_PAYLOAD || esp_rom_crc32_le(crc, &base[off + sizeof(rec)], rec.len) != rec.crc) {
+                break;
+            }
+            off += sizeof(rec) + ((rec.len + 3u) & ~3u);
+            records++;
+        }
+    }
+    return records;
+}
+
+// --- Cases ---
+
+static void empty_partition(void) {
+    erase_all();
+    expect("init", journal_init(), ESP_OK);
+
+    journal_stats_t st = stats();
+    expect("active sector", st.active_sector, 0);
+    expect("sequence", st.sector_seq, 1);
+    expect("recovered records", st.recovered_records, 0);
+}
+
+static void wrap_and_recover(void) {
+    erase_all();
+    journal_init();
+
+    // One and a half times around the ring, recovery then scans a full partition
+    uint32_t per_sector = records_per_sector();
+    uint32_t records = per_sector * TEST_SECTORS * 3 / 2;
+    journal_stats_t before = stats();
+    int64_t start = esp_timer_get_time();
+
+    journal_benchmark(records);
+    int64_t took = esp_timer_get_time() - start;
+    journal_stats_t st = stats();
+
+    // Plus the one records_per_sector() wrote
+    expect("sequence", st.sector_seq, 1 + records / per_sector);
+    expect("active sector", st.active_sector, records / per_sector % TEST_SECTORS);
+    expect("recovered records", st.recovered_records, records % per_sector + 1);
+    expect("records in the ring", check_ring(st.active_sector, st.sector_seq),
+           (TEST_SECTORS - 1) * per_sector + st.recovered_records);
+    expect("write errors", st.write_errors, 0);
+
+    uint32_t bytes = st.bytes - before.bytes;
+    printf("  %u records, %u KB, %u page writes, %u erases: %.0f KB/s, recovery %u us (host, flash in RAM)\n",
+           (unsigned)records, (unsigned)(bytes / 1024), (unsigned)(st.page_writes - before.page_writes),
+           (unsigned)(st.sector_erases - before.sector_erases), took > 0 ? bytes * 1e6 / 1024 / took : 0.0,
+           (unsigned)st.recovery_us);
+}
+
+static void torn_record(void) {
+    erase_all();
+    journal_init();
+    journal_benchmark(3);
+    expect("recovered before the cut", stats().recovered_records, 3);
+
+    // Power goes in the middle of the next record's payload
+    s_cut_bytes = sizeof(journal_rec_hdr_t) + 8;
+    journal_benchmark(2);
+    s_cut_bytes = -1;
+    expect("init after the cut", journal_init(), ESP_OK);
+    expect("recovered after the cut", stats().recovered_records, 3);
+
+    // The torn record closes its sector, writing goes on in the next one
+    journal_benchmark(1);
+    journal_stats_t st = stats();
+    expect("active sector after the cut", st.active_sector, 1);
+    expect("sequence after the cut", st.sector_seq, 2);
+    expect("recovered in the new sector", st.recovered_records, 1);
+    expect("records in the ring", check_ring(st.active_sector, st.sector_seq), 4);
+}
+
+static void erase_hold(void) {
+    erase_all();
+    journal_init();
+    uint32_t per_sector = records_per_sector();
+
+    // Held while the sector fills, no erase-ahead
+    journal_hold_erases(true);
+    journal_stats_t before = stats();
+    journal_benchmark(per_sector - 1);
+    expect("erases while held", stats().sector_erases - before.sector_erases, 0);
+
+    // A rotation needs the erase, it waits for the hold up to the limit
+    TickType_t start = s_ticks;
+    journal_benchmark(1);
+    journal_stats_t st = stats();
+    expect("waits", st.erase_waits - before.erase_waits, 1);
+    expect("waited ticks", s_ticks - start, pdMS_TO_TICKS(JOURNAL_ERASE_HOLD_MAX_MS));
+    expect("erases after the limit", st.sector_erases - before.sector_erases, 1);
+    expect("active sector", st.active_sector, 1);
+
+    // Released by the fall path while waiting, the erase follows at once
+    journal_benchmark(per_sector - 1);
+    before = stats();
+    start = s_ticks;
+    s_release_at = s_ticks + 5;
+    journal_benchmark(1);
+    st = stats();
+    expect("waited ticks until release", s_ticks - start, 5);
+    expect("erases after release", st.sector_erases - before.sector_erases, 1);
+    expect("active sector after release", st.active_sector, 2);
+
+    // Not held, the next sector is erased once this one is half full
+    before = stats();
+    journal_benchmark(per_sector / 2);
+    expect("erase-ahead", stats().sector_erases - before.sector_erases, 1);
+    expect("records in the ring", check_ring(stats().active_sector, stats().sector_seq),
+           2 * per_sector + 1 + per_sector / 2);
+}
+
+int main(void) {
+    struct {
+        const char *name;
+        void (*run)(void);
+    } cases[] = {
+        {"empty_partition", empty_partition},
+        {"wrap_and_recover", wrap_and_recover},
+        {"torn_record", torn_record},
+        {"erase_hold", erase_hold},
+    };
+
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        int before = s_failures;
+
+        cases[i].run();
+        printf("%-22s %s\n", cases[i].name, s_failures == before ? "ok" : "FAIL");
+    }
+    return s_failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,11 @@
+#ifndef HOST_STUB_I2C_MASTER_H
+#define HOST_STUB_I2C_MASTER_H
+
+// Host stand-in, the handle types that appear in main's headers
+
+#include "esp_err.h"
+
+typedef struct i2c_master_bus_t *i2c_master_bus_handle_t;
+typedef struct i2c_master_dev_t *i2c_master_dev_handle_t;
+
+#endif // HOST_STUB_I2C_MASTER_H
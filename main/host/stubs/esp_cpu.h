@@ -0,0 +1,10 @@
+#ifndef HOST_STUB_ESP_CPU_H
+#define HOST_STUB_ESP_CPU_H
+
+// Host stand-in, the test provides the counter
+
+#include <stdint.h>
+
+uint32_t esp_cpu_get_cycle_count(void);
+
+#endif // HOST_STUB_ESP_CPU_H
@@ -0,0 +1,19 @@
+#ifndef HOST_STUB_ESP_ERR_H
+#define HOST_STUB_ESP_ERR_H
+
+// Host stand-in, error codes as in ESP-IDF
+
+typedef int esp_err_t;
+
+#define ESP_OK                  0
+#define ESP_FAIL                -1
+#define ESP_ERR_NO_MEM          0x101
+#define ESP_ERR_INVALID_ARG     0x102
+#define ESP_ERR_INVALID_STATE   0x103
+#define ESP_ERR_INVALID_SIZE    0x104
+#define ESP_ERR_NOT_FOUND       0x105
+#define ESP_ERR_NOT_FINISHED    0x10C
+
+const char *esp_err_to_name(esp_err_t code);    // Provided by the test that needs it
+
+#endif // HOST_STUB_ESP_ERR_H
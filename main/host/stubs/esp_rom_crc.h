@@ -0,0 +1,10 @@
+#ifndef HOST_STUB_ESP_ROM_CRC_H
+#define HOST_STUB_ESP_ROM_CRC_H
+
+// Host stand-in, the test provides the function
+
+#include <stdint.h>
+
+uint32_t esp_rom_crc32_le(uint32_t crc, const uint8_t *buf, uint32_t len);
+
+#endif // HOST_STUB_ESP_ROM_CRC_H
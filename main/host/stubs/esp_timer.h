@@ -0,0 +1,10 @@
+#ifndef HOST_STUB_ESP_TIMER_H
+#define HOST_STUB_ESP_TIMER_H
+
+// Host stand-in, the test provides the clock
+
+#include <stdint.h>
+
+int64_t esp_timer_get_time(void);
+
+#endif // HOST_STUB_ESP_TIMER_H
@@ -0,0 +1,31 @@
+#ifndef HOST_STUB_FREERTOS_H
+#define HOST_STUB_FREERTOS_H
+
+// Host stand-in, just enough of FreeRTOS for the modules built in main/host.
+// The tests are single threaded, so critical sections do nothing.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t TickType_t;
+
+#define portMAX_DELAY       0xFFFFFFFFu
+#define configTICK_RATE_HZ  100
+#define pdMS_TO_TICKS(ms)   ((TickType_t)((uint64_t)(ms) * configTICK_RATE_HZ / 1000))
+
+#define pdTRUE  1
+#define pdFALSE 0
+#define pdPASS  1
+
+typedef struct {
+    int unused;
+} portMUX_TYPE;
+
+#define portMUX_INITIALIZER_UNLOCKED {0}
+#define taskENTER_CRITICAL(mux) ((void)(mux))
+#define taskEXIT_CRITICAL(mux)  ((void)(mux))
+
+#endif // HOST_STUB_FREERTOS_H
@@ -0,0 +1,8 @@
+#ifndef HOST_STUB_EVENT_GROUPS_H
+#define HOST_STUB_EVENT_GROUPS_H
+
+#include "freertos/FreeRTOS.h"
+
+typedef struct EventGroupDef_t *EventGroupHandle_t;
+
+#endif // HOST_STUB_EVENT_GROUPS_H
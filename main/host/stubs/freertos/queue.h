@@ -0,0 +1,14 @@
+#ifndef HOST_STUB_QUEUE_H
+#define HOST_STUB_QUEUE_H
+
+// Host stand-in, the test provides the functions
+
+#include "freertos/FreeRTOS.h"
+
+typedef struct QueueDefinition *QueueHandle_t;
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size);
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t wait);
+BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t wait);
+
+#endif // HOST_STUB_QUEUE_H
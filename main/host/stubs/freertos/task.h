@@ -0,0 +1,16 @@
+#ifndef HOST_STUB_TASK_H
+#define HOST_STUB_TASK_H
+
+// Host stand-in, the test provides the functions
+
+#include "freertos/FreeRTOS.h"
+
+typedef struct tskTaskControlBlock *TaskHandle_t;
+typedef void (*TaskFunction_t)(void *);
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name, uint32_t stack, void *arg,
+                                   UBaseType_t priority, TaskHandle_t *handle, BaseType_t core);
+TickType_t xTaskGetTickCount(void);
+void vTaskDelay(TickType_t ticks);
+
+#endif // HOST_STUB_TASK_H
@@ -0,0 +1,430 @@
+#include "imu.h"
+#include <string.h>
+#include "freertos/task.h"
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "esp_rom_sys.h"
+#include "esp_sleep.h"
+#include "esp_timer.h"
+#include "i2c_scheduler.h"
+#include "profiler.h"
+
+static const char *TAG = "IMU";
+
+// BMI270 registers
+#define REG_CHIP_ID         0x00
+#define REG_INT_STATUS_0    0x1C    // Feature interrupts, clear on read
+#define REG_INT_STATUS_1    0x1D
+#define REG_FIFO_LENGTH_0   0x24
+#define REG_FIFO_DATA       0x26
+#define REG_INTERNAL_STATUS 0x21
+#define REG_FEAT_PAGE       0x2F
+#define REG_FEATURES_IN     0x30
+#define REG_ACC_CONF        0x40
+#define REG_ACC_RANGE       0x41
+#define REG_GYR_CONF        0x42
+#define REG_GYR_RANGE       0x43
+#define REG_FIFO_WTM_0      0x46
+#define REG_FIFO_CONFIG_0   0x48
+#define REG_FIFO_CONFIG_1   0x49
+#define REG_INT1_IO_CTRL    0x53
+#define REG_INT_LATCH       0x55
+#define REG_INT1_MAP_FEAT   0x56
+#define REG_INT_MAP_DATA    0x58
+#define REG_INIT_CTRL       0x59
+#define REG_INIT_ADDR_0     0x5B
+#define REG_INIT_DATA       0x5E
+#define REG_PWR_CONF        0x7C
+#define REG_PWR_CTRL        0x7D
+#define REG_CMD             0x7E
+
+#define CHIP_ID_BMI270      0x24
+#define CMD_SOFT_RESET      0xB6
+#define CMD_FIFO_FLUSH      0xB0
+
+#define CONF_BWP_NORMAL     (0x02 << 4)
+#define CONF_FILTER_PERF    0x80
+#define CONF_ODR_50HZ       0x07    // Feature engine rate, idle sampling
+#define FIFO_CONFIG_1_ACC   0x40    // Headerless, accel only unless gyro is added
+#define FIFO_CONFIG_1_GYR   0x80
+#define INT_IO_ACTIVE_HIGH  0x02
+#define INT_IO_OUTPUT_EN    0x08
+#define INT_MAP_FWM_INT1    0x02
+#define FEAT_NO_MOTION      0x20    // INT1_MAP_FEAT and INT_STATUS_0
+#define FEAT_ANY_MOTION     0x40
+#define PWR_CTRL_GYR_EN     0x02
+#define PWR_CTRL_ACC_EN     0x04
+#define PWR_CONF_ADV_SAVE   0x01
+#define PWR_CONF_FIFO_WAKE  0x02
+#define INTERNAL_STATUS_MSG 0x0F
+#define INTERNAL_STATUS_OK  0x01
+
+#define CONFIG_FILE_SIZE    8192
+#define CONFIG_CHUNK        256     // Divides the file size
+
+// Any/no-motion feature blocks: page, offset in FEATURES_IN
+#define FEAT_ANY_MOT_PAGE   1
+#define FEAT_ANY_MOT_ADDR   0x0C
+#define FEAT_NO_MOT_PAGE    2
+#define FEAT_NO_MOT_ADDR    0x00
+#define FEAT_MOT_XYZ        0xE000  // Word 0, all axes
+#define FEAT_MOT_EN         0x8000  // Word 1
+#define FEAT_MOT_STEP_MS    20      // Duration unit, one sample at 50 Hz
+
+// INT_STATUS_0 up to FIFO_LENGTH in one read
+#define STATUS_BURST_LEN    (REG_FIFO_LENGTH_0 + 2 - REG_INT_STATUS_0)
+
+// Bosch BMI270 configuration microcode, from the BMI270 sensor API (drivers/bmi270)
+extern const uint8_t bmi270_config_file[];
+
+static i2c_master_dev_handle_t s_dev;
+static imu_config_t s_config;
+static uint8_t s_frame_len;
+static TaskHandle_t s_drain_task;
+static imu_frames_cb_t s_cb;
+static void *s_cb_arg;
+static volatile int64_t s_irq_time_us;
+static bool s_streaming;
+
+// One drain reads into these, sized for a full FIFO
+static uint8_t s_fifo_buf[IMU_FIFO_SIZE];
+static imu_frame_t s_frames[IMU_MAX_FRAMES];
+
+static imu_stats_t s_stats;
+static portMUX_TYPE s_stats_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static esp_err_t imu_write(uint8_t reg, uint8_t value) {
+    uint8_t buf[2] = {reg, value};
+    return i2c_sched_write(s_dev, I2C_SCHED_CLASS_IMU, buf, 2);
+}
+
+static esp_err_t imu_read(uint8_t reg, uint8_t *buf, size_t len) {
+    return i2c_sched_write_read(s_dev, I2C_SCHED_CLASS_IMU, &reg, 1, buf, len);
+}
+
+// Uploads the feature engine microcode, INIT_ADDR counts 16-bit words
+static esp_err_t load_config_file(void) {
+    static const uint8_t reg_init_data = REG_INIT_DATA;
+    esp_err_t err = imu_write(REG_INIT_CTRL, 0x00);
+
+    for (uint32_t index = 0; err == ESP_OK && index < CONFIG_FILE_SIZE; index += CONFIG_CHUNK) {
+        uint8_t addr[3] = {REG_INIT_ADDR_0, (uint8_t)((index / 2) & 0x0F), (uint8_t)((index / 2) >> 4)};
+        i2c_sched_txn_t txn = {
+            .dev = s_dev,
+            .cls = I2C_SCHED_CLASS_IMU,
+            .head = &reg_init_data,
+            .head_len = 1,
+            .data = &bmi270_config_file[index],
+            .width = CONFIG_CHUNK,
+            .rows = 1,
+            .stride = CONFIG_CHUNK,
+        };
+
+        err = i2c_sched_write(s_dev, I2C_SCHED_CLASS_IMU, addr, sizeof(addr));
+        if (err == ESP_OK) {
+            err = i2c_sched_transfer(&txn);
+        }
+    }
+    if (err == ESP_OK) {
+        err = imu_write(REG_INIT_CTRL, 0x01);
+    }
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    // Initialization takes up to 20 ms
+    uint8_t status = 0;
+    vTaskDelay(pdMS_TO_TICKS(20) + 1);
+    err = imu_read(REG_INTERNAL_STATUS, &status, 1);
+    if (err == ESP_OK && (status & INTERNAL_STATUS_MSG) != INTERNAL_STATUS_OK) {
+        ESP_LOGE(TAG, "Config load failed, internal status 0x%02X", status);
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+    return err;
+}
+
+// Writes one any/no-motion block: duration in 20 ms samples, threshold in 1/2048 g
+static esp_err_t write_motion_feature(uint8_t page, uint8_t addr, uint16_t duration_ms, uint16_t mg) {
+    uint16_t duration = (duration_ms / FEAT_MOT_STEP_MS) & 0x1FFF;
+    uint16_t threshold = ((uint32_t)mg * 2048 / 1000) & 0x07FF;
+    uint16_t w0 = duration | FEAT_MOT_XYZ;
+    uint16_t w1 = threshold | FEAT_MOT_EN;
+    uint8_t buf[5] = {REG_FEATURES_IN + addr, w0 & 0xFF, w0 >> 8, w1 & 0xFF, w1 >> 8};
+    esp_err_t err = imu_write(REG_FEAT_PAGE, page);
+
+    if (err == ESP_OK) {
+        err = i2c_sched_write(s_dev, I2C_SCHED_CLASS_IMU, buf, sizeof(buf));
+    }
+    return err;
+}
+
+// Switches between FIFO streaming and the low-power any-motion idle.
+// Advanced power save is off while the registers change.
+static esp_err_t set_streaming(bool streaming) {
+    const imu_config_t *c = &s_config;
+    uint8_t map_feat = c->motion_wakeup ? (streaming ? FEAT_NO_MOTION : FEAT_ANY_MOTION) : 0;
+    uint8_t pwr_ctrl = PWR_CTRL_ACC_EN | (streaming && c->gyro ? PWR_CTRL_GYR_EN : 0);
+    const uint8_t stream_regs[][2] = {
+        {REG_ACC_CONF, CONF_FILTER_PERF | CONF_BWP_NORMAL | c->odr},
+        {REG_PWR_CTRL, pwr_ctrl},
+        {REG_FIFO_CONFIG_1, FIFO_CONFIG_1_ACC | (c->gyro ? FIFO_CONFIG_1_GYR : 0)},
+        {REG_CMD, CMD_FIFO_FLUSH},
+        {REG_INT_MAP_DATA, INT_MAP_FWM_INT1},
+        {REG_INT1_MAP_FEAT, map_feat},
+        // The FIFO can be read while the sensor sleeps between samples
+        {REG_PWR_CONF, PWR_CONF_ADV_SAVE | PWR_CONF_FIFO_WAKE},
+    };
+    const uint8_t idle_regs[][2] = {
+        {REG_INT_MAP_DATA, 0x00},
+        {REG_FIFO_CONFIG_1, 0x00},
+        {REG_ACC_CONF, CONF_BWP_NORMAL | CONF_ODR_50HZ},  // Low power, 4 samples averaged
+        {REG_PWR_CTRL, pwr_ctrl},
+        {REG_INT1_MAP_FEAT, map_feat},
+        {REG_PWR_CONF, PWR_CONF_ADV_SAVE},
+    };
+    const uint8_t (*regs)[2] = streaming ? stream_regs : idle_regs;
+    size_t n = streaming ? sizeof(stream_regs) / sizeof(stream_regs[0]) : sizeof(idle_regs) / sizeof(idle_regs[0]);
+    esp_err_t err = imu_write(REG_PWR_CONF, 0x00);
+
+    esp_rom_delay_us(450);
+    for (size_t i = 0; err == ESP_OK && i < n; i++) {
+        err = imu_write(regs[i][0], regs[i][1]);
+    }
+    if (err == ESP_OK) {
+        s_streaming = streaming;
+    }
+    return err;
+}
+
+static void IRAM_ATTR imu_int1_isr(void *arg) {
+    BaseType_t woken = pdFALSE;
+
+    // Level triggered, masked until the drain task has read the status
+    gpio_intr_disable(IMU_INT1_GPIO);
+    s_irq_time_us = esp_timer_get_time();
+    vTaskNotifyGiveFromISR(s_drain_task, &woken);
+    portYIELD_FROM_ISR(woken);
+}
+
+uint32_t imu_frame_period_us(void) {
+    // odr 0x08 is 100 Hz, every step doubles
+    return 10000u >> (s_config.odr - IMU_ODR_100HZ);
+}
+
+esp_err_t imu_init(i2c_master_bus_handle_t bus, const imu_config_t *config) {
+    i2c_device_config_t dev_cfg = {
+        .dev_addr_length = I2C_ADDR_BIT_LEN_7,
+        .device_address = IMU_I2C_ADDR,
+        .scl_speed_hz = IMU_I2C_FREQ_HZ,
+    };
+    uint8_t id = 0;
+    esp_err_t err;
+
+    s_config = *config;
+    s_frame_len = IMU_ACC_FRAME_LEN * (config->gyro ? 2 : 1);
+    if (config->watermark_frames == 0 || config->watermark_frames * s_frame_len > IMU_FIFO_SIZE / 2) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    // 11-bit threshold field, 1 g would wrap to 0 and fire on any jitter
+    if (config->motion_wakeup && config->motion_mg >= 1000) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    err = i2c_master_bus_add_device(bus, &dev_cfg, &s_dev);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    err = imu_read(REG_CHIP_ID, &id, 1);
+    if (err != ESP_OK || id != CHIP_ID_BMI270) {
+        ESP_LOGE(TAG, "BMI270 not found (id 0x%02X, %s)", id, esp_err_to_name(err));
+        return err != ESP_OK ? err : ESP_ERR_NOT_FOUND;
+    }
+
+    // Soft reset, then advanced power save off for the config upload
+    imu_write(REG_CMD, CMD_SOFT_RESET);
+    vTaskDelay(pdMS_TO_TICKS(2) + 1);
+    err = imu_write(REG_PWR_CONF, 0x00);
+    if (err == ESP_OK) {
+        esp_rom_delay_us(450);
+        err = load_config_file();
+    }
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    uint16_t wtm = config->watermark_frames * s_frame_len;
+    const uint8_t setup[][2] = {
+        {REG_ACC_RANGE, config->acc_range},
+        {REG_GYR_CONF, CONF_FILTER_PERF | CONF_BWP_NORMAL | config->odr},
+        {REG_GYR_RANGE, 0x00},
+        {REG_FIFO_WTM_0, wtm & 0xFF},
+        {REG_FIFO_WTM_0 + 1, (wtm >> 8) & 0x1F},
+        {REG_FIFO_CONFIG_0, 0x00},          // Overwrite oldest when full, no sensor time frame
+        {REG_INT1_IO_CTRL, INT_IO_OUTPUT_EN | INT_IO_ACTIVE_HIGH},
+        {REG_INT_LATCH, 0x01},              // Held until the status read, wakes light sleep
+    };
+    for (size_t i = 0; err == ESP_OK && i < sizeof(setup) / sizeof(setup[0]); i++) {
+        err = imu_write(setup[i][0], setup[i][1]);
+    }
+    if (err == ESP_OK && config->motion_wakeup) {
+        err = write_motion_feature(FEAT_ANY_MOT_PAGE, FEAT_ANY_MOT_ADDR, config->wake_ms, config->motion_mg);
+        if (err == ESP_OK) {
+            err = write_motion_feature(FEAT_NO_MOT_PAGE, FEAT_NO_MOT_ADDR, config->idle_ms, config->motion_mg);
+        }
+    }
+    if (err == ESP_OK) {
+        err = set_streaming(!config->motion_wakeup);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "BMI270 setup failed: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    ESP_LOGI(TAG, "BMI270 streaming %lu Hz, %u-byte frames, watermark %u frames%s",
+             (unsigned long)(1000000 / imu_frame_period_us()), s_frame_len, config->watermark_frames,
+             config->motion_wakeup ? ", on motion only" : "");
+    return ESP_OK;
+}
+
+static inline int16_t le16(const uint8_t *p) {
+    return (int16_t)(p[0] | (p[1] << 8));
+}
+
+// Headerless frames are gyro then accel when both are enabled
+static size_t decode_frames(const uint8_t *buf, size_t len) {
+    size_t count = len / s_frame_len;
+
+    for (size_t i = 0; i < count; i++) {
+        const uint8_t *f = &buf[i * s_frame_len];
+        imu_frame_t *out = &s_frames[i];
+
+        if (s_config.gyro) {
+            out->gyr = (imu_vec_t){le16(&f[0]), le16(&f[2]), le16(&f[4])};
+            f += IMU_ACC_FRAME_LEN;
+        } else {
+            out->gyr = (imu_vec_t){0, 0, 0};
+        }
+        out->acc = (imu_vec_t){le16(&f[0]), le16(&f[2]), le16(&f[4])};
+    }
+    return count;
+}
+
+static void imu_drain_task(void *pvParameters) {
+    // A lost edge only delays the drain, the FIFO keeps filling meanwhile
+    const TickType_t timeout = pdMS_TO_TICKS((4 * s_config.watermark_frames * imu_frame_period_us()) / 1000) + 1;
+
+    while (1) {
+        // Idle waits for any-motion only, nothing to poll
+        ulTaskNotifyTake(pdTRUE, s_streaming ? timeout : portMAX_DELAY);
+        int64_t t_last = s_irq_time_us;
+        uint32_t start = profiler_begin();
+
+        // Interrupt status and FIFO length in one transaction
+        uint8_t status[STATUS_BURST_LEN];
+        esp_err_t err = imu_read(REG_INT_STATUS_0, status, sizeof(status));
+        gpio_intr_enable(IMU_INT1_GPIO);
+        if (err != ESP_OK) {
+            profiler_count(COUNTER_IMU_READ_FAILED);
+            continue;
+        }
+        uint8_t feat = status[0];
+        if (!s_streaming) {
+            if ((feat & FEAT_ANY_MOTION) && set_streaming(true) == ESP_OK) {
+                taskENTER_CRITICAL(&s_stats_lock);
+                s_stats.wakeups++;
+                taskEXIT_CRITICAL(&s_stats_lock);
+            }
+            continue;
+        }
+
+        const uint8_t *len_buf = &status[REG_FIFO_LENGTH_0 - REG_INT_STATUS_0];
+        uint16_t fifo_len = len_buf[0] | ((len_buf[1] & 0x3F) << 8);
+        uint16_t read_len = fifo_len - (fifo_len % s_frame_len);
+        if (read_len > IMU_FIFO_SIZE) {
+            read_len = IMU_FIFO_SIZE - (IMU_FIFO_SIZE % s_frame_len);
+        }
+
+        // FIFO_DATA does not auto-increment, the whole burst streams out of it
+        size_t count = 0;
+        if (read_len > 0) {
+            if (imu_read(REG_FIFO_DATA, s_fifo_buf, read_len) == ESP_OK) {
+                count = decode_frames(s_fifo_buf, read_len);
+            } else {
+                profiler_count(COUNTER_IMU_READ_FAILED);
+            }
+        }
+        profiler_end(PROBE_IMU_DRAIN, start);
+
+        if (count > 0) {
+            taskENTER_CRITICAL(&s_stats_lock);
+            s_stats.bursts++;
+            s_stats.frames += count;
+            s_stats.bytes += read_len + sizeof(status);
+            s_stats.transactions += 2;
+            if (fifo_len + s_frame_len > IMU_FIFO_SIZE) {
+                s_stats.overruns++;
+            }
+            if (count > s_stats.max_burst_frames) {
+                s_stats.max_burst_frames = count;
+            }
+            taskEXIT_CRITICAL(&s_stats_lock);
+        }
+
+        if (count > 0 && s_cb != NULL) {
+            s_cb(s_frames, count, t_last, s_cb_arg);
+        }
+
+        // The tail of the stream is delivered before going idle
+        if (s_config.motion_wakeup && (feat & FEAT_NO_MOTION) && set_streaming(false) == ESP_OK) {
+            taskENTER_CRITICAL(&s_stats_lock);
+            s_stats.idles++;
+            taskEXIT_CRITICAL(&s_stats_lock);
+        }
+    }
+}
+
+esp_err_t imu_start(imu_frames_cb_t cb, void *arg, UBaseType_t priority, BaseType_t core) {
+    const gpio_config_t io_cfg = {
+        .pin_bit_mask = 1ULL << IMU_INT1_GPIO,
+        .mode = GPIO_MODE_INPUT,
+        .pull_down_en = GPIO_PULLDOWN_ENABLE,
+        .intr_type = GPIO_INTR_HIGH_LEVEL,
+    };
+    esp_err_t err;
+
+    s_cb = cb;
+    s_cb_arg = arg;
+    if (xTaskCreatePinnedToCore(&imu_drain_task, "imu_drain", 3072, NULL, priority, &s_drain_task, core) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    err = gpio_config(&io_cfg);
+    if (err == ESP_OK) {
+        err = gpio_install_isr_service(0);
+        if (err == ESP_ERR_INVALID_STATE) {
+            err = ESP_OK;   // Already installed by another driver
+        }
+    }
+    if (err == ESP_OK) {
+        err = gpio_isr_handler_add(IMU_INT1_GPIO, imu_int1_isr, NULL);
+    }
+    // Edges are lost in automatic light sleep, the latched level wakes the chip instead
+    if (err == ESP_OK) {
+        err = gpio_wakeup_enable(IMU_INT1_GPIO, GPIO_INTR_HIGH_LEVEL);
+    }
+    if (err == ESP_OK) {
+        err = esp_sleep_enable_gpio_wakeup();
+    }
+    return err;
+}
+
+bool imu_is_streaming(void) {
+    return s_streaming;
+}
+
+void imu_get_stats(imu_stats_t *out) {
+    taskENTER_CRITICAL(&s_stats_lock);
+    *out = s_stats;
+    taskEXIT_CRITICAL(&s_stats_lock);
+}
@@ -0,0 +1,86 @@
+#ifndef IMU_H
+#define IMU_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_err.h"
+#include "driver/gpio.h"
+#include "driver/i2c_master.h"
+#include "imu_types.h"
+
+// --- BMI270 FIFO streaming ---
+// Headerless accelerometer (optionally gyro) frames collect in the BMI270 FIFO.
+// A watermark interrupt on INT1 wakes the drain task, which empties the FIFO
+// in one burst read through the IMU class of the I2C scheduler.
+// With motion wakeup the BMI270 idles in low-power mode with only its any-motion
+// feature armed on INT1; streaming runs from any-motion until no-motion.
+
+#define IMU_I2C_ADDR        0x68    // SDO to GND
+#define IMU_INT1_GPIO       GPIO_NUM_27
+#define IMU_I2C_FREQ_HZ     400000
+
+#define IMU_FIFO_SIZE       2048    // Bytes
+#define IMU_ACC_FRAME_LEN   6
+#define IMU_MAX_FRAMES      (IMU_FIFO_SIZE / IMU_ACC_FRAME_LEN)
+
+// Output data rate, ACC_CONF/GYR_CONF odr field
+typedef enum {
+    IMU_ODR_100HZ = 0x08,
+    IMU_ODR_200HZ = 0x09,
+    IMU_ODR_400HZ = 0x0A,
+    IMU_ODR_800HZ = 0x0B,
+    IMU_ODR_1600HZ = 0x0C,
+} imu_odr_t;
+
+// ACC_RANGE values
+typedef enum {
+    IMU_ACC_RANGE_2G = 0x00,
+    IMU_ACC_RANGE_4G = 0x01,
+    IMU_ACC_RANGE_8G = 0x02,
+    IMU_ACC_RANGE_16G = 0x03,
+} imu_acc_range_t;
+
+typedef struct {
+    imu_odr_t odr;
+    imu_acc_range_t acc_range;
+    bool gyro;                  // Also stream gyro, at the same rate, ±2000 dps
+    uint16_t watermark_frames;  // Frames per burst
+    bool motion_wakeup;         // Stream only between any-motion and no-motion
+    uint16_t motion_mg;         // Slope threshold of both features, below 1000
+    uint16_t wake_ms;           // Any-motion duration, 20 ms steps
+    uint16_t idle_ms;           // No-motion duration before streaming stops
+} imu_config_t;
+
+// Called from the drain task with the frames of one burst, oldest first.
+// t_last_us is the watermark interrupt time, close to the newest frame.
+typedef void (*imu_frames_cb_t)(const imu_frame_t *frames, size_t count, int64_t t_last_us, void *arg);
+
+typedef struct {
+    uint32_t bursts;            // FIFO drains
+    uint32_t frames;
+    uint32_t bytes;
+    uint32_t transactions;      // I2C transactions of the drains
+    uint32_t overruns;          // Drains that found the FIFO full
+    uint16_t max_burst_frames;
+    uint32_t wakeups;           // Any-motion, idle to streaming
+    uint32_t idles;             // No-motion, streaming to idle
+} imu_stats_t;
+
+// Adds the BMI270 to the bus, loads its config file and sets up FIFO and INT1.
+// Needs the I2C scheduler to be running.
+esp_err_t imu_init(i2c_master_bus_handle_t bus, const imu_config_t *config);
+
+// Starts the drain task, cb may be NULL
+esp_err_t imu_start(imu_frames_cb_t cb, void *arg, UBaseType_t priority, BaseType_t core);
+
+// False while idling for motion wakeup
+bool imu_is_streaming(void);
+
+// Frame period of the configured rate
+uint32_t imu_frame_period_us(void);
+
+void imu_get_stats(imu_stats_t *out);
+
+#endif // IMU_H
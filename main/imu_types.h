@@ -0,0 +1,20 @@
+#ifndef IMU_TYPES_H
+#define IMU_TYPES_H
+
+#include <stdint.h>
+
+// Accelerometer and gyro samples as the BMI270 FIFO delivers them. No ESP-IDF
+// headers here, the fall detector and the journal layout build on the host.
+
+typedef struct {
+    int16_t x;
+    int16_t y;
+    int16_t z;
+} imu_vec_t;
+
+typedef struct {
+    imu_vec_t acc;              // LSB per g is 32768 / range
+    imu_vec_t gyr;              // Zero without gyro
+} imu_frame_t;
+
+#endif // IMU_TYPES_H
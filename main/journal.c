@@ -0,0 +1,449 @@
+#include "journal.h"
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/queue.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_partition.h"
+#include "esp_rom_crc.h"
+#include "esp_timer.h"
+
+static const char *TAG = "JOURNAL";
+
+#define JOURNAL_QUEUE_LEN   32      // Holds the pre-impact IMU window of a fall in one go
+#define JOURNAL_ALIGN(n)    (((n) + 3) & ~3u)
+#define JOURNAL_ERASED      0xFF
+
+typedef struct {
+    journal_rec_hdr_t hdr;
+    uint8_t payload[JOURNAL_MAX_PAYLOAD];
+} journal_item_t;
+
+static const esp_partition_t *s_part;
+static uint32_t s_sectors;
+static QueueHandle_t s_queue;
+
+// Write position, owned by journal_init/journal_benchmark, then by the task
+static uint32_t s_active;           // Sector being appended to
+static uint32_t s_seq;              // Its header sequence
+static uint32_t s_off;              // End of the staged records within the sector
+static uint32_t s_synced;           // End of what is programmed, s_page_off <= s_synced <= s_off
+static uint32_t s_page_off;         // Sector offset of the page in s_page
+static bool s_next_erased;
+static _Atomic bool s_hold_erases;
+static uint8_t s_page[JOURNAL_PAGE_SIZE];
+
+static journal_stats_t s_stats;
+static portMUX_TYPE s_stats_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static inline uint32_t sector_addr(uint32_t sector) {
+    return sector * JOURNAL_SECTOR_SIZE;
+}
+
+static uint32_t record_crc(const journal_rec_hdr_t *hdr, const uint8_t *payload) {
+    uint32_t crc = esp_rom_crc32_le(0, (const uint8_t *)hdr, offsetof(journal_rec_hdr_t, crc));
+    return esp_rom_crc32_le(crc, payload, hdr->len);
+}
+
+static uint32_t sector_crc(const journal_sector_hdr_t *hdr) {
+    return esp_rom_crc32_le(0, (const uint8_t *)hdr, offsetof(journal_sector_hdr_t, crc));
+}
+
+static bool sector_valid(const journal_sector_hdr_t *hdr) {
+    return hdr->magic == JOURNAL_SECTOR_MAGIC && hdr->version == JOURNAL_VERSION && hdr->crc == sector_crc(hdr);
+}
+
+static void count_write_error(esp_err_t err) {
+    ESP_LOGE(TAG, "Flash write failed: %s", esp_err_to_name(err));
+    taskENTER_CRITICAL(&s_stats_lock);
+    s_stats.write_errors++;
+    taskEXIT_CRITICAL(&s_stats_lock);
+}
+
+static esp_err_t erase_sector(uint32_t sector) {
+    int64_t start = esp_timer_get_time();
+    esp_err_t err = esp_partition_erase_range(s_part, sector_addr(sector), JOURNAL_SECTOR_SIZE);
+    uint32_t took = (uint32_t)(esp_timer_get_time() - start);
+
+    if (err != ESP_OK) {
+        count_write_error(err);
+        return err;
+    }
+    taskENTER_CRITICAL(&s_stats_lock);
+    s_stats.sector_erases++;
+    if (took > s_stats.erase_max_us) {
+        s_stats.erase_max_us = took;
+    }
+    taskEXIT_CRITICAL(&s_stats_lock);
+    return ESP_OK;
+}
+
+// Programs the staged bytes of the current page up to sector offset end
+static void program(uint32_t end) {
+    esp_err_t err = esp_partition_write(s_part, sector_addr(s_active) + s_synced,
+                                        &s_page[s_synced - s_page_off], end - s_synced);
+    s_synced = end;
+    if (err != ESP_OK) {
+        count_write_error(err);
+        return;
+    }
+    taskENTER_CRITICAL(&s_stats_lock);
+    s_stats.page_writes++;
+    taskEXIT_CRITICAL(&s_stats_lock);
+}
+
+static void flush(void) {
+    if (s_off > s_synced) {
+        program(s_off);
+    }
+}
+
+// Opens a sector with the next sequence number, s_seq starts at 0 for an empty journal
+static esp_err_t open_sector(uint32_t sector) {
+    journal_sector_hdr_t hdr = {
+        .magic = JOURNAL_SECTOR_MAGIC,
+        .seq = s_seq + 1,
+        .version = JOURNAL_VERSION,
+        .reserved = 0xFFFF,
+    };
+    hdr.crc = sector_crc(&hdr);
+
+    esp_err_t err = esp_partition_write(s_part, sector_addr(sector), &hdr, sizeof(hdr));
+    if (err != ESP_OK) {
+        count_write_error(err);
+        return err;
+    }
+    s_active = sector;
+    s_seq = hdr.seq;
+    s_off = s_synced = sizeof(hdr);
+    s_page_off = 0;
+    s_next_erased = false;
+    memset(s_page, JOURNAL_ERASED, sizeof(s_page));
+
+    taskENTER_CRITICAL(&s_stats_lock);
+    s_stats.active_sector = s_active;
+    s_stats.sector_seq = s_seq;
+    taskEXIT_CRITICAL(&s_stats_lock);
+    return ESP_OK;
+}
+
+// A rotation cannot go around an unerased sector, it waits out the hold instead.
+// The queue buffers new records meanwhile.
+static void wait_erase_hold(void) {
+    TickType_t until = xTaskGetTickCount() + pdMS_TO_TICKS(JOURNAL_ERASE_HOLD_MAX_MS);
+
+    if (!atomic_load(&s_hold_erases)) {
+        return;
+    }
+    taskENTER_CRITICAL(&s_stats_lock);
+    s_stats.erase_waits++;
+    taskEXIT_CRITICAL(&s_stats_lock);
+    while (atomic_load(&s_hold_erases) && (int32_t)(until - xTaskGetTickCount()) > 0) {
+        vTaskDelay(pdMS_TO_TICKS(10));
+    }
+}
+
+static void rotate(void) {
+    uint32_t next = (s_active + 1) % s_sectors;
+
+    flush();
+    if (!s_next_erased) {
+        wait_erase_hold();
+    }
+    if (!s_next_erased && erase_sector(next) != ESP_OK) {
+        s_off = s_synced = JOURNAL_SECTOR_SIZE;     // Stay full, the next record retries
+        return;
+    }
+    open_sector(next);
+}
+
+// Copies into the page buffer, programming each page as it fills
+static void stage(const uint8_t *bytes, uint32_t len) {
+    while (len > 0) {
+        uint32_t in_page = s_off - s_page_off;
+        uint32_t chunk = JOURNAL_PAGE_SIZE - in_page < len ? JOURNAL_PAGE_SIZE - in_page : len;
+
+        memcpy(&s_page[in_page], bytes, chunk);
+        s_off += chunk;
+        bytes += chunk;
+        len -= chunk;
+        if (s_off - s_page_off == JOURNAL_PAGE_SIZE) {
+            program(s_off);
+            s_page_off = s_off;
+            memset(s_page, JOURNAL_ERASED, sizeof(s_page));
+        }
+    }
+}
+
+static void put_record(journal_item_t *item) {
+    static const uint8_t pad[3] = {JOURNAL_ERASED, JOURNAL_ERASED, JOURNAL_ERASED};
+    uint32_t total = sizeof(item->hdr) + JOURNAL_ALIGN(item->hdr.len);
+
+    if (s_off + total > JOURNAL_SECTOR_SIZE) {
+        rotate();
+        if (s_off + total > JOURNAL_SECTOR_SIZE) {
+            return;
+        }
+    }
+
+    item->hdr.crc = record_crc(&item->hdr, item->payload);
+    stage((const uint8_t *)&item->hdr, sizeof(item->hdr));
+    stage(item->payload, item->hdr.len);
+    stage(pad, JOURNAL_ALIGN(item->hdr.len) - item->hdr.len);
+
+    // Erase ahead so rotating never waits for the 4 KB erase, unless held
+    if (!s_next_erased && s_sectors > 1 && s_off >= JOURNAL_SECTOR_SIZE / 2 && !atomic_load(&s_hold_erases)) {
+        s_next_erased = erase_sector((s_active + 1) % s_sectors) == ESP_OK;
+    }
+
+    taskENTER_CRITICAL(&s_stats_lock);
+    s_stats.records++;
+    s_stats.bytes += total;
+    taskEXIT_CRITICAL(&s_stats_lock);
+}
+
+// Walks the records of the newest sector, returns the count and the end offset
+static uint32_t scan_sector(const uint8_t *buf, uint32_t *end) {
+    uint32_t off = sizeof(journal_sector_hdr_t), count = 0;
+
+    while (off + sizeof(journal_rec_hdr_t) <= JOURNAL_SECTOR_SIZE) {
+        journal_rec_hdr_t hdr;
+        memcpy(&hdr, &buf[off], sizeof(hdr));
+        if (hdr.type == JOURNAL_ERASED) {
+            *end = off;
+            return count;
+        }
+        uint32_t total = sizeof(hdr) + JOURNAL_ALIGN(hdr.len);
+        if (hdr.len > JOURNAL_MAX_PAYLOAD || off + total > JOURNAL_SECTOR_SIZE ||
+            hdr.crc != record_crc(&hdr, &buf[off + sizeof(hdr)])) {
+            // Torn by a brown-out, nothing after it can be trusted
+            ESP_LOGW(TAG, "Torn record at sector %lu offset %lu", (unsigned long)s_active, (unsigned long)off);
+            break;
+        }
+        off += total;
+        count++;
+    }
+    *end = JOURNAL_SECTOR_SIZE;     // Full or torn, the next record opens a new sector
+    return count;
+}
+
+// Finds the newest sector and the end of its records
+static esp_err_t recover(void) {
+    int64_t start = esp_timer_get_time();
+    bool found = false;
+    esp_err_t err;
+
+    for (uint32_t i = 0; i < s_sectors; i++) {
+        journal_sector_hdr_t hdr;
+        err = esp_partition_read(s_part, sector_addr(i), &hdr, sizeof(hdr));
+        if (err != ESP_OK) {
+            return err;
+        }
+        if (sector_valid(&hdr) && (!found || (int32_t)(hdr.seq - s_seq) > 0)) {
+            s_active = i;
+            s_seq = hdr.seq;
+            found = true;
+        }
+    }
+
+    uint32_t count = 0;
+    if (!found) {
+        ESP_LOGI(TAG, "No journal found, starting a new one");
+        s_seq = 0;
+        err = erase_sector(0);
+        if (err == ESP_OK) {
+            err = open_sector(0);
+        }
+        if (err != ESP_OK) {
+            return err;
+        }
+    } else {
+        uint8_t *buf = malloc(JOURNAL_SECTOR_SIZE);
+        if (buf == NULL) {
+            return ESP_ERR_NO_MEM;
+        }
+        err = esp_partition_read(s_part, sector_addr(s_active), buf, JOURNAL_SECTOR_SIZE);
+        if (err == ESP_OK) {
+            count = scan_sector(buf, &s_off);
+        }
+        free(buf);
+        if (err != ESP_OK) {
+            return err;
+        }
+        s_synced = s_off;
+        s_page_off = s_off & ~(uint32_t)(JOURNAL_PAGE_SIZE - 1);
+        s_next_erased = false;
+        memset(s_page, JOURNAL_ERASED, sizeof(s_page));
+    }
+
+    uint32_t took = (uint32_t)(esp_timer_get_time() - start);
+    taskENTER_CRITICAL(&s_stats_lock);
+    s_stats.active_sector = s_active;
+    s_stats.sector_seq = s_seq;
+    s_stats.recovered_records = count;
+    s_stats.recovery_us = took;
+    taskEXIT_CRITICAL(&s_stats_lock);
+
+    ESP_LOGI(TAG, "Recovered sector %lu/%lu seq %lu, %lu records, end %lu, %lu us",
+             (unsigned long)s_active, (unsigned long)s_sectors, (unsigned long)s_seq, (unsigned long)count,
+             (unsigned long)s_off, (unsigned long)took);
+    return ESP_OK;
+}
+
+esp_err_t journal_init(void) {
+    s_part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, JOURNAL_PARTITION_SUBTYPE, JOURNAL_PARTITION_LABEL);
+    if (s_part == NULL) {
+        ESP_LOGE(TAG, "No \"%s\" partition", JOURNAL_PARTITION_LABEL);
+        return ESP_ERR_NOT_FOUND;
+    }
+    s_sectors = s_part->size / JOURNAL_SECTOR_SIZE;
+    if (s_sectors < 2) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    esp_err_t err = recover();
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Recovery failed: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    s_queue = xQueueCreate(JOURNAL_QUEUE_LEN, sizeof(journal_item_t));
+    return s_queue != NULL ? ESP_OK : ESP_ERR_NO_MEM;
+}
+
+static void journal_task(void *pvParameters) {
+    static journal_item_t item;
+    TickType_t flush_at = 0;
+
+    while (1) {
+        // Wait for the flush deadline only while something is staged but not programmed
+        TickType_t wait = portMAX_DELAY;
+        if (s_off > s_synced) {
+            TickType_t now = xTaskGetTickCount();
+            wait = (int32_t)(flush_at - now) > 0 ? flush_at - now : 0;
+        }
+
+        if (xQueueReceive(s_queue, &item, wait) != pdTRUE) {
+            flush();
+            continue;
+        }
+        if (s_off == s_synced) {
+            flush_at = xTaskGetTickCount() + pdMS_TO_TICKS(JOURNAL_FLUSH_MS);
+        }
+        put_record(&item);
+        // Alarm transitions and boots are what an investigation starts from
+        if (item.hdr.type == JOURNAL_REC_ALARM || item.hdr.type == JOURNAL_REC_BOOT) {
+            flush();
+        }
+    }
+}
+
+esp_err_t journal_start(UBaseType_t priority, BaseType_t core) {
+    if (s_queue == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (xTaskCreatePinnedToCore(&journal_task, "journal", 3072, NULL, priority, NULL, core) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+bool journal_append(journal_rec_type_t type, const void *payload, size_t len) {
+    journal_item_t item;
+
+    if (s_queue == NULL || len > JOURNAL_MAX_PAYLOAD) {
+        return false;
+    }
+    item.hdr.type = type;
+    item.hdr.len = (uint8_t)len;
+    item.hdr.reserved = 0xFFFF;
+    item.hdr.time_ms = (uint32_t)(esp_timer_get_time() / 1000);
+    memcpy(item.payload, payload, len);
+
+    if (xQueueSend(s_queue, &item, 0) != pdTRUE) {
+        taskENTER_CRITICAL(&s_stats_lock);
+        s_stats.dropped++;
+        taskEXIT_CRITICAL(&s_stats_lock);
+        return false;
+    }
+    return true;
+}
+
+void journal_hold_erases(bool hold) {
+    atomic_store(&s_hold_erases, hold);
+}
+
+void journal_get_stats(journal_stats_t *out) {
+    taskENTER_CRITICAL(&s_stats_lock);
+    *out = s_stats;
+    taskEXIT_CRITICAL(&s_stats_lock);
+}
+
+void journal_log_stats(void) {
+    journal_stats_t st;
+
+    journal_get_stats(&st);
+    if (s_part == NULL) {
+        return;
+    }
+    ESP_LOGI(TAG, "records=%lu bytes=%lu pages=%lu erases=%lu (max %lu us, %lu waits) dropped=%lu errors=%lu "
+             "sector=%lu seq=%lu",
+             (unsigned long)st.records, (unsigned long)st.bytes, (unsigned long)st.page_writes,
+             (unsigned long)st.sector_erases, (unsigned long)st.erase_max_us, (unsigned long)st.erase_waits,
+             (unsigned long)st.dropped, (unsigned long)st.write_errors,
+             (unsigned long)st.active_sector, (unsigned long)st.sector_seq);
+}
+
+esp_err_t journal_benchmark(uint32_t records) {
+    static const codec_layout_t layout = JOURNAL_SAMPLE_LAYOUT;
+    journal_item_t item = {
+        .hdr = {.type = JOURNAL_REC_SAMPLES, .reserved = 0xFFFF},
+    };
+    journal_stats_t before, after;
+
+    if (s_part == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    // One block of synthetic samples 10 s apart, written over and over
+    codec_encoder_t *enc = malloc(sizeof(*enc));
+    if (enc == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    codec_encoder_init(enc, &layout, JOURNAL_MAX_PAYLOAD);
+    for (uint32_t i = 0;; i++) {
+        int32_t values[JOURNAL_CH_COUNT] = {
+            [JOURNAL_CH_STEP] = i % 10,
+            [JOURNAL_CH_STATUS] = 0xB0,
+            [JOURNAL_CH_TEMPERATURE] = 2150 + (i & 3),
+            [JOURNAL_CH_PRESSURE] = 101325 - (i & 7),
+            [JOURNAL_CH_HUMIDITY] = 45000 + (i & 31),
+            [JOURNAL_CH_GAS] = 50000 * (1 + i % 10) + (i & 0xFF),
+        };
+        if (!codec_encoder_add(enc, i * 10000, values)) {
+            break;
+        }
+    }
+    item.hdr.len = (uint8_t)codec_encoder_finish(enc, item.payload, sizeof(item.payload));
+    free(enc);
+
+    journal_get_stats(&before);
+    int64_t start = esp_timer_get_time();
+    for (uint32_t i = 0; i < records; i++) {
+        item.hdr.time_ms = (uint32_t)(esp_timer_get_time() / 1000);
+        put_record(&item);
+    }
+    flush();
+    int64_t took = esp_timer_get_time() - start;
+    journal_get_stats(&after);
+
+    uint32_t bytes = after.bytes - before.bytes;
+    ESP_LOGI(TAG, "Benchmark: %lu records, %lu bytes in %lu ms, %lu KB/s, %lu erases, longest %lu us",
+             (unsigned long)records, (unsigned long)bytes, (unsigned long)(took / 1000),
+             (unsigned long)(took > 0 ? (uint64_t)bytes * 1000000 / 1024 / took : 0),
+             (unsigned long)(after.sector_erases - before.sector_erases), (unsigned long)after.erase_max_us);
+
+    // Boot time recovery with the sector the benchmark left behind
+    return recover();
+}
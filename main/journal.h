@@ -0,0 +1,145 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_err.h"
+#include "imu_types.h"
+#include "sample_codec.h"
+
+// --- Flash journal ---
+// Black-box recorder in the "journal" data partition (partitions.csv).
+// The partition is a ring of 4 KB sectors written append-only, each starting
+// with a header carrying a sequence number. Producers queue records without
+// touching flash; the journal task stages them in a RAM copy of the current
+// 256-byte flash page and writes whole pages, or the staged tail after
+// JOURNAL_FLUSH_MS and immediately after an alarm transition. The next sector
+// is erased ahead of time once the active one is half full, so rotation never
+// waits for an erase. Every sector is reused in turn, which levels wear.
+// An erase stops the flash cache on both cores for tens of ms, so erases are
+// held off while the fall detector tracks a possible fall (journal_hold_erases).
+//
+// Layout, little endian:
+//   sector: journal_sector_hdr_t, then records up to the sector end
+//   record: journal_rec_hdr_t, payload, 0xFF padding to 4 bytes
+// A record type of 0xFF is erased flash, the end of the sector's records.
+// Recovery reads every sector header, then walks the newest sector checking
+// record CRCs; a torn record closes that sector.
+
+#define JOURNAL_PARTITION_LABEL   "journal"
+#define JOURNAL_PARTITION_SUBTYPE 0x40
+#define JOURNAL_SECTOR_SIZE       4096
+#define JOURNAL_PAGE_SIZE         256
+#define JOURNAL_MAX_PAYLOAD       248
+#define JOURNAL_FLUSH_MS          5000
+#define JOURNAL_ERASE_HOLD_MAX_MS 3000    // Longest a rotation waits for a hold to end
+
+#define JOURNAL_SECTOR_MAGIC      0x4C4E524A  // "JRNL"
+#define JOURNAL_VERSION           1
+
+typedef enum {
+    JOURNAL_REC_BOOT = 1,
+    JOURNAL_REC_SAMPLES,        // Decimated BME690 samples, one sample_codec block, chained
+    JOURNAL_REC_ALARM,          // Emergency type transition
+    JOURNAL_REC_IMU,            // Raw accelerometer frames around a fall event
+} journal_rec_type_t;
+
+typedef struct __attribute__((packed)) {
+    uint32_t magic;
+    uint32_t seq;               // Increments with every sector opened
+    uint16_t version;
+    uint16_t reserved;
+    uint32_t crc;               // Over the fields above
+} journal_sector_hdr_t;
+
+typedef struct __attribute__((packed)) {
+    uint8_t type;
+    uint8_t len;                // Payload bytes
+    uint16_t reserved;
+    uint32_t time_ms;           // Since boot
+    uint32_t crc;               // Over type, len, reserved, time_ms and payload
+} journal_rec_hdr_t;
+
+typedef struct __attribute__((packed)) {
+    uint32_t reset_reason;      // esp_reset_reason_t
+} journal_boot_t;
+
+// Channels of JOURNAL_REC_SAMPLES, sample time in ms since boot. Gas resistance
+// is delta coded against the last sample of the same heater step. Continued
+// blocks decode from the last self-contained one on, so a reader starting at
+// the oldest sector skips samples records up to a self-contained block.
+typedef enum {
+    JOURNAL_CH_STEP = 0,        // Heater step, -1 in forced mode
+    JOURNAL_CH_STATUS,
+    JOURNAL_CH_TEMPERATURE,     // 0.01 °C
+    JOURNAL_CH_PRESSURE,        // Pa
+    JOURNAL_CH_HUMIDITY,        // milli-%RH
+    JOURNAL_CH_GAS,             // Ohm
+    JOURNAL_CH_COUNT
+} journal_sample_channel_t;
+
+#define JOURNAL_SAMPLE_LAYOUT {             \
+    .channels = JOURNAL_CH_COUNT,           \
+    .key_channel = JOURNAL_CH_STEP,         \
+    .keyed_mask = 1 << JOURNAL_CH_GAS,      \
+}
+
+typedef struct __attribute__((packed)) {
+    uint8_t from;               // emergency_type_t
+    uint8_t to;
+    uint16_t reserved;
+    uint32_t active_mask;       // All active types, alarm_engine_active_mask()
+} journal_alarm_t;
+
+#define JOURNAL_IMU_FRAMES 40
+
+typedef struct __attribute__((packed)) {
+    uint16_t event;             // Counts fall events since boot
+    int16_t first_frame;        // Index of acc[0] relative to the impact batch
+    uint8_t count;
+    uint8_t reserved;
+    imu_vec_t acc[JOURNAL_IMU_FRAMES];
+} journal_imu_t;
+
+typedef struct {
+    uint32_t records;
+    uint32_t bytes;             // Record bytes staged, headers and padding included
+    uint32_t page_writes;
+    uint32_t sector_erases;
+    uint32_t dropped;           // Queue full
+    uint32_t write_errors;
+    uint32_t erase_max_us;      // Longest sector erase
+    uint32_t erase_waits;       // Rotations that waited for an erase hold
+    uint32_t active_sector;
+    uint32_t sector_seq;
+    uint32_t recovered_records; // In the newest sector at boot
+    uint32_t recovery_us;
+} journal_stats_t;
+
+// Finds the partition and recovers the write position, no task yet
+esp_err_t journal_init(void);
+
+// Starts the writer task, records queued before are kept
+esp_err_t journal_start(UBaseType_t priority, BaseType_t core);
+
+// Queues one record, never blocks. False when the queue is full or the
+// journal is not running.
+bool journal_append(journal_rec_type_t type, const void *payload, size_t len);
+
+// While held, the erase-ahead is put off and a rotation that needs an erase
+// waits for the release, at most JOURNAL_ERASE_HOLD_MAX_MS. Records keep
+// queueing meanwhile. Any task may call it.
+void journal_hold_erases(bool hold);
+
+void journal_get_stats(journal_stats_t *out);
+void journal_log_stats(void);
+
+// Writes records sample blocks straight to flash and re-runs recovery,
+// logging throughput, the longest erase and recovery time. Records past the
+// partition size wrap it, so recovery runs over a full partition. Overwrites
+// journal contents, call between journal_init() and journal_start() only.
+esp_err_t journal_benchmark(uint32_t records);
+
+#endif // JOURNAL_H
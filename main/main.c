@@ -4,13 +4,26 @@
 #include <stdlib.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
-#include "freertos/semphr.h"
+#include "freertos/event_groups.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "ssd1306.h"        // From SSD1306_Driver component
+#include "ssd1306_flush.h"  // Background frame flush
+#include "ssd1306_i2c.h"    // Display address and clock
+#include "i2c_scheduler.h"  // From I2C_Scheduler component
+#include "display_bus.h"
 #include "fonts.h"          // From SSD1306_Driver component
 #include <math.h>
 #include "driver/i2c_master.h"
 #include "sensor.h"
+#include "sensor_history.h"
+#include "alarm_engine.h"
+#include "motion_logic.h"
+#include "power_monitor.h"
+#include "profiler.h"
+#include "binlog.h"
+#include "journal.h"
+#include "esp_system.h"
 
 // Include new local headers
 #include "common_types.h"
@@ -19,160 +32,236 @@
 #include "sensor_logic.h"
 
 #define TAG "APP_MAIN"
+#define SENSOR_ACQ_PERIOD_MS 2000
+#define BOOT_METRICS_TIMEOUT_MS 5000    // Stages missing by then are reported as failed
+#define PROFILER_REPORT_MS 60000
+
+// 400 Hz accelerometer in 40 ms bursts, short enough for the fall detector to
+// raise an impact within 100 ms, still one FIFO drain instead of 16 sample reads.
+// Streaming only runs from any-motion until 5 s without motion; the slope of a
+// drop into free fall trips any-motion within one 20 ms feature sample.
+static const imu_config_t imu_config = {
+    .odr = IMU_ODR_400HZ,
+    .acc_range = IMU_ACC_RANGE_8G,
+    .gyro = false,
+    .watermark_frames = 16,
+    .motion_wakeup = true,
+    .motion_mg = 80,
+    .wake_ms = 20,
+    .idle_ms = 5000,
+};
+#define SENSOR_HISTORY_INTERVAL_MS 1000  // 256 records cover a bit over 4 minutes
+
+// Units follow sensor_history.h: 0.01 °C, Pa, 0.01 %RH; rates per minute
+static const alarm_rule_def_t alarm_rules[] = {
+    // Hazardous gas: resistance well below the clean-air baseline of its heater step
+    { .type = EMERGENCY_TYPE_GAS, .source = ALARM_SRC_GAS_RATIO, .compare = ALARM_BELOW,
+      .threshold = 60, .hysteresis = 15, .sustain_ms = 3000 },
+    // Heat stress: sustained high temperature, or a fast rise
+    { .type = EMERGENCY_TYPE_HEAT, .source = ALARM_SRC_LEVEL, .channel = HIST_CH_TEMPERATURE,
+      .compare = ALARM_ABOVE, .threshold = 4500, .hysteresis = 200, .sustain_ms = 10000 },
+    { .type = EMERGENCY_TYPE_HEAT, .source = ALARM_SRC_RATE, .channel = HIST_CH_TEMPERATURE,
+      .compare = ALARM_ABOVE, .threshold = 200, .hysteresis = 50, .window_ms = 60000 },
+    // Pressure drop, e.g. a sudden ventilation or door event in a confined space
+    { .type = EMERGENCY_TYPE_DANGER, .source = ALARM_SRC_RATE, .channel = HIST_CH_PRESSURE,
+      .compare = ALARM_BELOW, .threshold = -100, .hysteresis = 30, .window_ms = 120000 },
+};
+
+static const alarm_config_t alarm_config = {
+    .rules = alarm_rules,
+    .rule_count = sizeof(alarm_rules) / sizeof(alarm_rules[0]),
+    .priority = {
+        [EMERGENCY_TYPE_DANGER] = 1,
+        [EMERGENCY_TYPE_HEAT] = 2,
+        [EMERGENCY_TYPE_GAS] = 3,
+        [EMERGENCY_TYPE_FALL] = 4,
+    },
+};
+
+// Gas scan, about 140 ms per TPHG cycle with the oversampling in sensor.h
+static const bme_heater_profile_t gas_heater_profile = {
+    .len = 10,
+    .shared_dur_ms = 100,
+    .temp_c = {320, 100, 100, 100, 200, 200, 200, 320, 320, 320},
+    .dur_mult = {5, 2, 10, 30, 5, 5, 5, 5, 5, 5},
+};
 
 // --- Define Global variables ---
 // These are now declared 'extern' in global_vars.h for other files to see
-volatile float g_temperature = 25.0;
-volatile float g_pressure = 1012.5;
-volatile float g_humidity = 60.0;
-volatile emergency_type_t g_current_emergency_type = EMERGENCY_TYPE_NONE;
-SemaphoreHandle_t g_display_mutex; // Mutex to protect shared display resources and emergency state
+_Atomic emergency_type_t g_current_emergency_type = EMERGENCY_TYPE_NONE;
+EventGroupHandle_t g_boot_events;
 extern i2c_master_bus_handle_t bus;
 extern i2c_master_dev_handle_t dev;
 
+// --- Boot stages ---
+// Each runs as its own task so their bus traffic interleaves in the I2C scheduler
+// instead of queueing behind each other. A failed stage leaves its bit unset.
 
-void app_main() {
-    // Initialize the SSD1306 display
-    // SSD1306_Init() handles I2C setup based on defines in ssd1306.h and ssd1306.c
-    if (SSD1306_Init()) {
-        ESP_LOGI(TAG, "SSD1306 Initialized Successfully.");
+static void display_init_task(void *pvParameters) {
+    // Initialize the SSD1306 display, it runs at its own SCL clock on the shared bus
+    if (display_bus_init(bus, SSD1306_I2C_FREQ_HZ) != ESP_OK) {
+        ESP_LOGE(TAG, "Display bus setup failed!");
     } else {
-        ESP_LOGE(TAG, "SSD1306 Initialization Failed!");
-        // Handle initialization failure (e.g., halt or retry)
-        return;
+        SSD1306_SetBackend(&display_bus_backend);
+        if (!SSD1306_Init()) {
+            ESP_LOGE(TAG, "SSD1306 Initialization Failed!");
+        } else if (!SSD1306_StartFlushTask(3, 1)) {
+            // From here on frames are flushed in the background by the SSD1306 driver
+            ESP_LOGE(TAG, "Failed to start SSD1306 flush task!");
+        } else if (xTaskCreatePinnedToCore(&display_task, "display_oled_task", 2048 * 2, NULL, 5, NULL, 1) != pdPASS) {
+            // The display task shows the splash until the first sample arrives. Pinned
+            // next to the flush task, its profiler probes span the blocking swap.
+            ESP_LOGE(TAG, "Failed to create display_task!");
+        } else {
+            xEventGroupSetBits(g_boot_events, BOOT_BIT_DISPLAY);
+        }
     }
-    i2c_master_bus_config_t bus_cfg = {
-        .clk_source = I2C_CLK_SRC_DEFAULT,
-        .i2c_port = I2C_PORT,
-        .sda_io_num = SDA_PIN,
-        .scl_io_num = SCL_PIN,
-        .glitch_ignore_cnt = 7,
-    };
-    ESP_ERROR_CHECK(i2c_new_master_bus(&bus_cfg, &bus));
+    vTaskDelete(NULL);
+}
 
+static void imu_init_task(void *pvParameters) {
+    // The helmet still works as an environment monitor without the IMU
+    if (motion_start(bus, &imu_config, 8, 0) == ESP_OK) {
+        xEventGroupSetBits(g_boot_events, BOOT_BIT_IMU);
+    } else {
+        ESP_LOGW(TAG, "IMU unavailable, fall detection disabled.");
+    }
+    vTaskDelete(NULL);
+}
+
+static void env_init_task(void *pvParameters) {
     i2c_device_config_t dev_cfg = {
         .device_address = BME690_ADDR,
         .dev_addr_length = I2C_ADDR_BIT_LEN_7,
         .scl_speed_hz = 100000,
     };
-    ESP_ERROR_CHECK(i2c_master_bus_add_device(bus, &dev_cfg, &dev));
-
     uint8_t id = 0;
-    read_registers(REG_CHIP_ID, &id, 1);
-    if (id != CHIP_ID_VAL) {
+
+    if (i2c_master_bus_add_device(bus, &dev_cfg, &dev) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to add BME690");
+    } else if (read_registers(REG_CHIP_ID, &id, 1) != ESP_OK || id != CHIP_ID_VAL) {
         ESP_LOGE(TAG, "Unexpected chip ID: 0x%02X", id);
-        return;
+    } else if (load_calibration() != ESP_OK) {
+        ESP_LOGE(TAG, "Calibration unavailable");
+    } else if (configure_sensor() != ESP_OK) {
+        ESP_LOGE(TAG, "BME690 configuration failed");
+    } else if (!sensor_acquisition_start(SENSOR_ACQ_PERIOD_MS, &gas_heater_profile, 6, 0)) {
+        // Readings and the environment alarms come from the acquisition task
+        ESP_LOGE(TAG, "Failed to start sensor acquisition!");
+    } else {
+        xEventGroupSetBits(g_boot_events, BOOT_BIT_ENV);
     }
+    vTaskDelete(NULL);
+}
 
-    read_temperature_calibration();
-    read_humidity_calibration();
-    read_gas_calibration();
-    // Initial display message
-    SSD1306_Fill(SSD1306_COLOR_BLACK); // Clear buffer before first write
-    const char* boot_msg = "Booting...";
-    // Calculate position to center the boot message using Font_11x18
-    uint16_t boot_msg_width = strlen(boot_msg) * Font_11x18.FontWidth;
-    uint16_t boot_msg_x = (SSD1306_WIDTH > boot_msg_width) ? (SSD1306_WIDTH - boot_msg_width) / 2 : 0;
-    uint16_t boot_msg_y = (SSD1306_HEIGHT > Font_11x18.FontHeight) ? (SSD1306_HEIGHT - Font_11x18.FontHeight) / 2 : 0;
-    SSD1306_GotoXY(boot_msg_x, boot_msg_y);
-    SSD1306_Puts(boot_msg, &Font_11x18, SSD1306_COLOR_WHITE);
-    SSD1306_UpdateScreen();
-    vTaskDelay(pdMS_TO_TICKS(2000)); // Show initial message for a bit
-
-    // Create mutex for display and emergency state
-    g_display_mutex = xSemaphoreCreateMutex();
-    if (g_display_mutex == NULL) {
-        ESP_LOGE(TAG, "Failed to create display mutex!");
-        return; // Critical error
+// Records when each stage lands, relative to esp_timer start (bootloader excluded)
+static void log_boot_metrics(void) {
+    static const struct {
+        EventBits_t bit;
+        const char *name;
+    } stages[] = {
+        {BOOT_BIT_DISPLAY, "display"},
+        {BOOT_BIT_IMU, "imu"},
+        {BOOT_BIT_ENV, "env"},
+        {BOOT_BIT_FIRST_SAMPLE, "first sample"},
+    };
+    int64_t at_us[sizeof(stages) / sizeof(stages[0])] = {0};
+    int64_t deadline = esp_timer_get_time() + BOOT_METRICS_TIMEOUT_MS * 1000LL;
+    EventBits_t seen = 0;
+
+    while (seen != BOOT_BITS_ALL) {
+        int64_t left = deadline - esp_timer_get_time();
+        if (left <= 0) {
+            break;
+        }
+        EventBits_t bits = xEventGroupWaitBits(g_boot_events, BOOT_BITS_ALL & ~seen, pdFALSE, pdFALSE,
+                                               pdMS_TO_TICKS(left / 1000) + 1);
+        int64_t now = esp_timer_get_time();
+        for (size_t i = 0; i < sizeof(stages) / sizeof(stages[0]); i++) {
+            if ((bits & stages[i].bit) && !(seen & stages[i].bit)) {
+                at_us[i] = now;
+            }
+        }
+        seen |= bits;
     }
 
-    // Create the display task (function is now in display_logic.c)
-    if (xTaskCreate(&display_task, "display_oled_task", 2048 * 2, NULL, 5, NULL) != pdPASS) {
-        ESP_LOGE(TAG, "Failed to create display_task!");
-        if (g_display_mutex != NULL) vSemaphoreDelete(g_display_mutex); // Clean up mutex
-        return; // Critical error
+    for (size_t i = 0; i < sizeof(stages) / sizeof(stages[0]); i++) {
+        if (seen & stages[i].bit) {
+            ESP_LOGI(TAG, "Boot: %-12s %5lu ms", stages[i].name, (unsigned long)(at_us[i] / 1000));
+        } else {
+            ESP_LOGE(TAG, "Boot: %-12s failed", stages[i].name);
+        }
+    }
+    // Alarm capable: a sample was evaluated and the display can show the result
+    if ((seen & (BOOT_BIT_DISPLAY | BOOT_BIT_FIRST_SAMPLE)) == (BOOT_BIT_DISPLAY | BOOT_BIT_FIRST_SAMPLE)) {
+        int64_t capable = at_us[0] > at_us[3] ? at_us[0] : at_us[3];
+        ESP_LOGI(TAG, "Boot: alarm capable %5lu ms", (unsigned long)(capable / 1000));
     }
-    ESP_LOGI(TAG, "Display task created.");
+}
 
-    // Create the sensor simulation task (function is now in sensor_logic.c)
-    // In a real application, this would be your BME680 reading task
-    if (xTaskCreate(&sensor_simulation_task, "sensor_sim_task", 2048 * 2, NULL, 4, NULL) != pdPASS) {
-        ESP_LOGE(TAG, "Failed to create sensor_simulation_task!");
-        // Consider cleanup if display_task was already created and needs to be stopped
-        return; // Critical error
+void app_main() {
+    // Hot paths log through binary records, formatted here at the lowest priority
+    if (!binlog_start(1, 1)) {
+        ESP_LOGW(TAG, "Failed to start binlog formatter.");
     }
-    ESP_LOGI(TAG, "Sensor simulation task created.");
-    while (true) {
-        configure_sensor();  // Forced mode every cycle
-        vTaskDelay(pdMS_TO_TICKS(50));
 
-        int32_t t_raw, p_raw, h_raw;
-        uint16_t gas_adc;
-        uint8_t gas_range;
-        read_raw_data(&t_raw, &p_raw, &h_raw, &gas_adc, &gas_range);
+    // Black-box journal, the boot record marks where this run starts
+    if (journal_init() == ESP_OK) {
+#if CONFIG_JOURNAL_BENCHMARK_RECORDS > 0
+        journal_benchmark(CONFIG_JOURNAL_BENCHMARK_RECORDS);
+#endif
+        journal_boot_t boot = {.reset_reason = esp_reset_reason()};
+        journal_append(JOURNAL_REC_BOOT, &boot, sizeof(boot));
+        if (journal_start(2, 1) != ESP_OK) {
+            ESP_LOGW(TAG, "Failed to start journal task.");
+        }
+    } else {
+        ESP_LOGW(TAG, "Journal unavailable, nothing is recorded to flash.");
+    }
 
-        float temp = compensate_temperature(t_raw);
-        float press = compensate_pressure(p_raw);
-        float hum = compensate_humidity(h_raw);
-        float gas = compensate_gas(gas_adc, gas_range);
+    // DFS and automatic light sleep, bus users hold PM locks only around I2C bursts
+    if (power_monitor_init() != ESP_OK) {
+        ESP_LOGW(TAG, "Power management unavailable, running at full clock.");
+    }
 
-        ESP_LOGI(TAG, "T: %.2f °C | P: %.2f Pa | H: %.2f %% | Gas: %.2f Ohm", temp, press, hum, gas);
+    // One I2C bus shared by the display, the BME690 and the BMI270
+    i2c_master_bus_config_t bus_cfg = {
+        .clk_source = I2C_CLK_SRC_DEFAULT,
+        .i2c_port = I2C_PORT,
+        .sda_io_num = SDA_PIN,
+        .scl_io_num = SCL_PIN,
+        .glitch_ignore_cnt = 7,
+    };
+    ESP_ERROR_CHECK(i2c_new_master_bus(&bus_cfg, &bus));
 
-        vTaskDelay(pdMS_TO_TICKS(2000));
-    }
+    // All bus traffic goes through the scheduler, IMU first, then sensor, then display
+    ESP_ERROR_CHECK(i2c_sched_init(10, 0));
 
-    // Initial display message
-    SSD1306_Fill(SSD1306_COLOR_BLACK); // Clear buffer before first write
-    const char* boot_msg = "Booting...";
-    // Calculate position to center the boot message using Font_11x18
-    uint16_t boot_msg_width = strlen(boot_msg) * Font_11x18.FontWidth;
-    uint16_t boot_msg_x = (SSD1306_WIDTH > boot_msg_width) ? (SSD1306_WIDTH - boot_msg_width) / 2 : 0;
-    uint16_t boot_msg_y = (SSD1306_HEIGHT > Font_11x18.FontHeight) ? (SSD1306_HEIGHT - Font_11x18.FontHeight) / 2 : 0;
-    SSD1306_GotoXY(boot_msg_x, boot_msg_y);
-    SSD1306_Puts(boot_msg, &Font_11x18, SSD1306_COLOR_WHITE);
-    SSD1306_UpdateScreen();
-    vTaskDelay(pdMS_TO_TICKS(2000)); // Show initial message for a bit
-
-    // Create mutex for display and emergency state
-    g_display_mutex = xSemaphoreCreateMutex();
-    if (g_display_mutex == NULL) {
-        ESP_LOGE(TAG, "Failed to create display mutex!");
+    g_boot_events = xEventGroupCreate();
+    if (g_boot_events == NULL) {
+        ESP_LOGE(TAG, "Failed to create boot event group!");
         return; // Critical error
     }
 
-    // Create the display task (function is now in display_logic.c)
-    if (xTaskCreate(&display_task, "display_oled_task", 2048 * 2, NULL, 5, NULL) != pdPASS) {
-        ESP_LOGE(TAG, "Failed to create display_task!");
-        if (g_display_mutex != NULL) vSemaphoreDelete(g_display_mutex); // Clean up mutex
+    // Both are RAM only and must exist before the first sample or fall event
+    sensor_history_init(SENSOR_HISTORY_INTERVAL_MS);
+    if (alarm_engine_init(&alarm_config) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to compile alarm rules!");
         return; // Critical error
     }
-    ESP_LOGI(TAG, "Display task created.");
 
-    // Create the sensor simulation task (function is now in sensor_logic.c)
-    // In a real application, this would be your BME680 reading task
-    if (xTaskCreate(&sensor_simulation_task, "sensor_sim_task", 2048 * 2, NULL, 4, NULL) != pdPASS) {
-        ESP_LOGE(TAG, "Failed to create sensor_simulation_task!");
-        // Consider cleanup if display_task was already created and needs to be stopped
+    if (xTaskCreatePinnedToCore(&imu_init_task, "boot_imu", 4096, NULL, 7, NULL, 0) != pdPASS ||
+        xTaskCreatePinnedToCore(&env_init_task, "boot_env", 4096, NULL, 6, NULL, 0) != pdPASS ||
+        xTaskCreatePinnedToCore(&display_init_task, "boot_display", 4096, NULL, 5, NULL, 1) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create boot tasks!");
         return; // Critical error
     }
-    ESP_LOGI(TAG, "Sensor simulation task created.");
-    while (true) {
-        configure_sensor();  // Forced mode every cycle
-        vTaskDelay(pdMS_TO_TICKS(50));
-
-        int32_t t_raw, p_raw, h_raw;
-        uint16_t gas_adc;
-        uint8_t gas_range;
-        read_raw_data(&t_raw, &p_raw, &h_raw, &gas_adc, &gas_range);
-
-        float temp = compensate_temperature(t_raw);
-        float press = compensate_pressure(p_raw);
-        float hum = compensate_humidity(h_raw);
-        float gas = compensate_gas(gas_adc, gas_range);
 
-        ESP_LOGI(TAG, "T: %.2f °C | P: %.2f Pa | H: %.2f %% | Gas: %.2f Ohm", temp, press, hum, gas);
+    log_boot_metrics();
 
-        vTaskDelay(pdMS_TO_TICKS(2000));
+    // Latency histograms, stack and CPU use, bus, alarm, motion, power and journal stats
+    if (!profiler_start(PROFILER_REPORT_MS, 1)) {
+        ESP_LOGW(TAG, "Failed to start profiler report.");
     }
     ESP_LOGI(TAG, "app_main finished setup. Tasks are running.");
     // app_main can exit now (or enter a low-power mode, or a simple loop if needed for other top-level logic).
@@ -0,0 +1,180 @@
+#include "motion_logic.h"
+#include "freertos/task.h"
+#include "esp_cpu.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "alarm_engine.h"
+#include "display_logic.h"
+#include "binlog.h"
+#include "journal.h"
+
+static const char *TAG = "MOTION";
+
+static fall_detector_t s_fall;
+static uint32_t s_period_us;
+
+// Raw window around each impact for the journal, 1 s either side at 400 Hz
+#define MOTION_PRE_FRAMES   400
+#define MOTION_POST_FRAMES  400
+
+static imu_vec_t s_pre[MOTION_PRE_FRAMES];  // Ring of the latest frames before the batch
+static uint32_t s_pre_pos;
+static uint32_t s_pre_len;
+static int64_t s_pre_last_us;
+static journal_imu_t s_window;              // IMU record being filled
+static int16_t s_window_index;              // Frame index relative to the impact
+static uint32_t s_window_left;              // Frames still to record
+static bool s_erases_held;
+
+static motion_stats_t s_stats;
+static portMUX_TYPE s_stats_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static void window_flush(void) {
+    if (s_window.count > 0) {
+        journal_append(JOURNAL_REC_IMU, &s_window,
+                       offsetof(journal_imu_t, acc) + s_window.count * sizeof(imu_vec_t));
+        s_window.count = 0;
+    }
+}
+
+static void window_add(const imu_vec_t *acc) {
+    if (s_window.count == 0) {
+        s_window.first_frame = s_window_index;
+    }
+    s_window.acc[s_window.count++] = *acc;
+    s_window_index++;
+    if (s_window.count == JOURNAL_IMU_FRAMES) {
+        window_flush();
+    }
+}
+
+// Journals the pre-impact ring on an impact, then frames until the window is complete
+static void record_window(const imu_frame_t *frames, size_t count, int64_t t_last_us, fall_event_t ev) {
+    // A gap in streaming makes the ring stale, the window must be continuous
+    if (t_last_us - s_pre_last_us > (int64_t)(count + 1) * s_period_us * 2) {
+        s_pre_len = 0;
+    }
+    s_pre_last_us = t_last_us;
+
+    if (ev == FALL_EVENT_IMPACT && s_window_left == 0) {
+        s_window.event++;
+        s_window.count = 0;
+        s_window_index = -(int16_t)(s_pre_len + s_fall.event_index);
+        for (uint32_t i = 0; i < s_pre_len; i++) {
+            window_add(&s_pre[(s_pre_pos + MOTION_PRE_FRAMES - s_pre_len + i) % MOTION_PRE_FRAMES]);
+        }
+        s_window_left = s_fall.event_index + MOTION_POST_FRAMES;
+    }
+    if (s_window_left > 0) {
+        for (size_t i = 0; i < count && s_window_left > 0; i++, s_window_left--) {
+            window_add(&frames[i].acc);
+        }
+        if (s_window_left == 0) {
+            window_flush();
+        }
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        s_pre[s_pre_pos] = frames[i].acc;
+        s_pre_pos = (s_pre_pos + 1) % MOTION_PRE_FRAMES;
+    }
+    s_pre_len = s_pre_len + count < MOTION_PRE_FRAMES ? s_pre_len + count : MOTION_PRE_FRAMES;
+}
+
+static void on_imu_frames(const imu_frame_t *frames, size_t count, int64_t t_last_us, void *arg) {
+    uint32_t start = esp_cpu_get_cycle_count();
+    fall_event_t ev = fall_detector_process(&s_fall, frames, count);
+    uint32_t cycles = esp_cpu_get_cycle_count() - start;
+    uint32_t latency = 0;
+
+    switch (ev) {
+    case FALL_EVENT_IMPACT: {
+        alarm_engine_set_external(EMERGENCY_TYPE_FALL, true);
+        // Frames are evenly spaced, the newest one is at the watermark interrupt
+        int64_t t_event = t_last_us - (int64_t)(count - 1 - s_fall.event_index) * s_period_us;
+        latency = (uint32_t)(esp_timer_get_time() - t_event);
+        BINLOG(FALL_IMPACT, latency);
+        break;
+    }
+    case FALL_EVENT_CONFIRMED:
+        alarm_engine_set_external(EMERGENCY_TYPE_FALL, true);
+        BINLOG(FALL_CONFIRMED, s_fall.stats.last_peak_mg);
+        break;
+    case FALL_EVENT_CANCELLED:
+        alarm_engine_set_external(EMERGENCY_TYPE_FALL, false);
+        BINLOG(FALL_CANCELLED);
+        break;
+    case FALL_EVENT_RECOVERED:
+        alarm_engine_set_external(EMERGENCY_TYPE_FALL, false);
+        BINLOG(FALL_RECOVERED);
+        break;
+    default:
+        break;
+    }
+    if (ev != FALL_EVENT_NONE) {
+        display_request_refresh();
+    }
+    record_window(frames, count, t_last_us, ev);
+
+    // A flash erase stalls this task with the cache, none from the first free
+    // fall frame until the impact is confirmed or cancelled
+    bool tracking = (s_fall.state == FALL_STATE_IDLE && s_fall.run > 0) || s_fall.state == FALL_STATE_FREE_FALL ||
+                    s_fall.state == FALL_STATE_IMPACT || s_fall.state == FALL_STATE_POST_IMPACT;
+    if (tracking != s_erases_held) {
+        s_erases_held = tracking;
+        journal_hold_erases(tracking);
+    }
+
+    taskENTER_CRITICAL(&s_stats_lock);
+    s_stats.fall = s_fall.stats;
+    s_stats.cycles_last = cycles;
+    s_stats.cycles_sum += cycles;
+    if (cycles > s_stats.cycles_max) {
+        s_stats.cycles_max = cycles;
+    }
+    if (ev == FALL_EVENT_IMPACT) {
+        s_stats.latency_last_us = latency;
+        if (latency > s_stats.latency_max_us) {
+            s_stats.latency_max_us = latency;
+        }
+    }
+    taskEXIT_CRITICAL(&s_stats_lock);
+}
+
+esp_err_t motion_start(i2c_master_bus_handle_t bus, const imu_config_t *config,
+                       UBaseType_t priority, BaseType_t core) {
+    esp_err_t err = imu_init(bus, config);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    s_period_us = imu_frame_period_us();
+    fall_detector_config_t fall_cfg = FALL_DETECTOR_DEFAULT_CONFIG(32768 >> (config->acc_range + 1), s_period_us);
+    fall_detector_init(&s_fall, &fall_cfg);
+
+    return imu_start(on_imu_frames, NULL, priority, core);
+}
+
+void motion_get_stats(motion_stats_t *out) {
+    taskENTER_CRITICAL(&s_stats_lock);
+    *out = s_stats;
+    taskEXIT_CRITICAL(&s_stats_lock);
+}
+
+void motion_log_stats(void) {
+    motion_stats_t st;
+    imu_stats_t imu;
+
+    motion_get_stats(&st);
+    imu_get_stats(&imu);
+    if (st.fall.batches == 0) {
+        return;
+    }
+    ESP_LOGI(TAG, "wakeups=%lu idles=%lu batches=%lu frames=%lu cycles last/avg/max=%lu/%lu/%lu "
+             "falls=%lu/%lu/%lu latency last/max=%lu/%lu us",
+             (unsigned long)imu.wakeups, (unsigned long)imu.idles, (unsigned long)st.fall.batches,
+             (unsigned long)st.fall.frames, (unsigned long)st.cycles_last,
+             (unsigned long)(st.cycles_sum / st.fall.batches), (unsigned long)st.cycles_max,
+             (unsigned long)st.fall.impacts, (unsigned long)st.fall.confirmed, (unsigned long)st.fall.cancelled,
+             (unsigned long)st.latency_last_us, (unsigned long)st.latency_max_us);
+}
@@ -0,0 +1,26 @@
+#ifndef MOTION_LOGIC_H
+#define MOTION_LOGIC_H
+
+#include "freertos/FreeRTOS.h"
+#include "driver/i2c_master.h"
+#include "imu.h"
+#include "fall_detector.h"
+
+typedef struct {
+    fall_stats_t fall;
+    uint32_t cycles_last;       // Detector cost of one FIFO batch
+    uint32_t cycles_max;
+    uint64_t cycles_sum;
+    uint32_t latency_last_us;   // Impact frame to emergency update
+    uint32_t latency_max_us;
+} motion_stats_t;
+
+// Brings up the IMU and feeds its FIFO batches to the fall detector, which
+// raises and clears EMERGENCY_TYPE_FALL through the alarm engine.
+esp_err_t motion_start(i2c_master_bus_handle_t bus, const imu_config_t *config,
+                       UBaseType_t priority, BaseType_t core);
+
+void motion_get_stats(motion_stats_t *out);
+void motion_log_stats(void);
+
+#endif // MOTION_LOGIC_H
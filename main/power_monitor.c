@@ -0,0 +1,118 @@
+#include "power_monitor.h"
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "esp_pm.h"
+#include "esp_timer.h"
+#include "global_vars.h"
+#include "imu.h"
+
+static const char *TAG = "POWER";
+
+#define POWER_MIN_FREQ_MHZ      80      // Lowest clock that keeps APB at 80 MHz
+#define POWER_ACCOUNT_PERIOD_US 1000000
+
+static const char *const s_state_names[POWER_STATE_COUNT] = {"idle", "sampling", "emergency"};
+
+static esp_timer_handle_t s_timer;
+static int64_t s_last_us;
+static atomic_uint_fast32_t s_slept_us;    // Since the last accounting period
+
+static power_state_stats_t s_stats[POWER_STATE_COUNT];
+static portMUX_TYPE s_stats_lock = portMUX_INITIALIZER_UNLOCKED;
+
+#if CONFIG_PM_LIGHT_SLEEP_CALLBACKS
+// Runs with interrupts off right after each light sleep
+static esp_err_t IRAM_ATTR on_sleep_exit(int64_t sleep_time_us, void *arg) {
+    atomic_fetch_add(&s_slept_us, (uint32_t)sleep_time_us);
+    return ESP_OK;
+}
+#endif
+
+static power_state_t current_state(void) {
+    if (atomic_load(&g_current_emergency_type) != EMERGENCY_TYPE_NONE) {
+        return POWER_STATE_EMERGENCY;
+    }
+    return imu_is_streaming() ? POWER_STATE_SAMPLING : POWER_STATE_IDLE;
+}
+
+// The whole period goes to the state seen at its end, 1 s granularity is plenty
+static void account_cb(void *arg) {
+    int64_t now = esp_timer_get_time();
+    uint32_t slept = atomic_exchange(&s_slept_us, 0);
+    power_state_t state = current_state();
+
+    taskENTER_CRITICAL(&s_stats_lock);
+    s_stats[state].time_us += now - s_last_us;
+    s_stats[state].sleep_us += slept;
+    taskEXIT_CRITICAL(&s_stats_lock);
+    s_last_us = now;
+}
+
+esp_err_t power_monitor_init(void) {
+    esp_err_t err = ESP_OK;
+
+#if CONFIG_PM_ENABLE
+    esp_pm_config_t pm_config = {
+        .max_freq_mhz = CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ,
+        .min_freq_mhz = POWER_MIN_FREQ_MHZ,
+        .light_sleep_enable = true,
+    };
+    err = esp_pm_configure(&pm_config);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "PM configuration failed: %s", esp_err_to_name(err));
+        return err;
+    }
+#if CONFIG_PM_LIGHT_SLEEP_CALLBACKS
+    esp_pm_sleep_cbs_register_config_t cbs = {
+        .exit_cb = on_sleep_exit,
+    };
+    err = esp_pm_light_sleep_register_cbs(&cbs);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "No light sleep callback, sleep residency not measured");
+    }
+#endif
+    ESP_LOGI(TAG, "DFS %d-%d MHz, automatic light sleep", POWER_MIN_FREQ_MHZ, CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ);
+#else
+    ESP_LOGW(TAG, "CONFIG_PM_ENABLE is off, running at a fixed clock");
+#endif
+
+    const esp_timer_create_args_t timer_args = {
+        .callback = account_cb,
+        .name = "power_acct",
+        .skip_unhandled_events = true,
+    };
+    err = esp_timer_create(&timer_args, &s_timer);
+    if (err == ESP_OK) {
+        s_last_us = esp_timer_get_time();
+        err = esp_timer_start_periodic(s_timer, POWER_ACCOUNT_PERIOD_US);
+    }
+    return err;
+}
+
+void power_monitor_get_stats(power_state_stats_t out[POWER_STATE_COUNT]) {
+    taskENTER_CRITICAL(&s_stats_lock);
+    memcpy(out, s_stats, sizeof(s_stats));
+    taskEXIT_CRITICAL(&s_stats_lock);
+}
+
+void power_monitor_log_stats(void) {
+    power_state_stats_t st[POWER_STATE_COUNT];
+
+    power_monitor_get_stats(st);
+    for (int i = 0; i < POWER_STATE_COUNT; i++) {
+        if (st[i].time_us == 0) {
+            continue;
+        }
+        uint64_t awake_us = st[i].time_us > st[i].sleep_us ? st[i].time_us - st[i].sleep_us : 0;
+        uint32_t avg_ua = (uint32_t)((awake_us * POWER_ACTIVE_UA + st[i].sleep_us * POWER_SLEEP_UA) /
+                                     st[i].time_us);
+        ESP_LOGI(TAG, "%-9s %lu s, light sleep %lu%%, ~%lu.%lu mA", s_state_names[i],
+                 (unsigned long)(st[i].time_us / 1000000),
+                 (unsigned long)(st[i].sleep_us * 100 / st[i].time_us),
+                 (unsigned long)(avg_ua / 1000), (unsigned long)((avg_ua % 1000) / 100));
+    }
+}
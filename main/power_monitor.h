@@ -0,0 +1,35 @@
+#ifndef POWER_MONITOR_H
+#define POWER_MONITOR_H
+
+#include <stdint.h>
+#include "esp_err.h"
+
+// --- Power management ---
+// DFS between the default CPU clock and 80 MHz plus automatic light sleep.
+// Time and light-sleep residency are accounted per system state, and an ESP32
+// current estimate is derived from the residency, logged by the profiler. Peripherals (BME690 heater,
+// OLED, IMU) are not included in the estimate.
+
+typedef enum {
+    POWER_STATE_IDLE = 0,       // No motion, environment sampling only
+    POWER_STATE_SAMPLING,       // IMU streaming into the fall detector
+    POWER_STATE_EMERGENCY,      // Alarm shown, display blinking
+    POWER_STATE_COUNT
+} power_state_t;
+
+// Current model for the estimate, ESP32 datasheet figures
+#define POWER_ACTIVE_UA     30000   // CPU running at mixed 80/240 MHz, radio off
+#define POWER_SLEEP_UA      800     // Light sleep
+
+typedef struct {
+    uint64_t time_us;
+    uint64_t sleep_us;          // Light sleep within time_us
+} power_state_stats_t;
+
+// Configures DFS and light sleep and starts the accounting
+esp_err_t power_monitor_init(void);
+
+void power_monitor_get_stats(power_state_stats_t out[POWER_STATE_COUNT]);
+void power_monitor_log_stats(void);
+
+#endif // POWER_MONITOR_H
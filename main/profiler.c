@@ -0,0 +1,168 @@
+#include "profiler.h"
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "i2c_scheduler.h"
+#include "alarm_engine.h"
+#include "motion_logic.h"
+#include "power_monitor.h"
+#include "binlog.h"
+#include "journal.h"
+
+static const char *TAG = "PROFILER";
+
+#define PROFILER_MAX_TASKS  24
+
+#define PROFILER_NAME(id, name) name,
+static const char *const s_probe_names[PROBE_COUNT] = {PROFILER_PROBES(PROFILER_NAME)};
+static const char *const s_counter_names[COUNTER_COUNT] = {PROFILER_COUNTERS(PROFILER_NAME)};
+#undef PROFILER_NAME
+
+static profiler_hist_t s_hist[PROBE_COUNT];
+static portMUX_TYPE s_hist_lock = portMUX_INITIALIZER_UNLOCKED;
+static atomic_uint_fast32_t s_counters[COUNTER_COUNT];
+
+static uint32_t s_period_ms;
+
+// Run time counters of the previous report, for the per-interval CPU share
+static struct {
+    UBaseType_t number;
+    configRUN_TIME_COUNTER_TYPE runtime;
+} s_prev_runtime[PROFILER_MAX_TASKS];
+static configRUN_TIME_COUNTER_TYPE s_prev_total;
+
+void profiler_end(profiler_probe_t probe, uint32_t start) {
+    uint32_t cycles = esp_cpu_get_cycle_count() - start;
+    int bin = cycles ? 31 - __builtin_clz(cycles) : 0;
+    profiler_hist_t *h = &s_hist[probe];
+
+    taskENTER_CRITICAL(&s_hist_lock);
+    h->count++;
+    h->sum += cycles;
+    h->bins[bin]++;
+    if (cycles > h->max) {
+        h->max = cycles;
+    }
+    taskEXIT_CRITICAL(&s_hist_lock);
+}
+
+void profiler_count(profiler_counter_t counter) {
+    atomic_fetch_add(&s_counters[counter], 1);
+}
+
+void profiler_get_hist(profiler_probe_t probe, profiler_hist_t *out) {
+    taskENTER_CRITICAL(&s_hist_lock);
+    *out = s_hist[probe];
+    taskEXIT_CRITICAL(&s_hist_lock);
+}
+
+// snprintf at len, clamped so len never runs past the buffer when an entry is cut
+static size_t append(char *buf, size_t size, size_t len, const char *fmt, ...) {
+    va_list args;
+
+    if (len >= size - 1) {
+        return len;
+    }
+    va_start(args, fmt);
+    int n = vsnprintf(&buf[len], size - len, fmt, args);
+    va_end(args);
+    if (n < 0) {
+        return len;
+    }
+    return len + (size_t)n < size - 1 ? len + (size_t)n : size - 1;
+}
+
+static void dump_probes(void) {
+    char line[160];
+
+    for (int p = 0; p < PROBE_COUNT; p++) {
+        profiler_hist_t h;
+        profiler_get_hist(p, &h);
+        if (h.count == 0) {
+            continue;
+        }
+
+        // Only occupied bins, as log2:count
+        size_t len = 0;
+        line[0] = '\0';
+        for (int b = 0; b < PROFILER_BINS; b++) {
+            if (h.bins[b] != 0) {
+                len = append(line, sizeof(line), len, " %d:%lu", b, (unsigned long)h.bins[b]);
+            }
+        }
+        ESP_LOGI(TAG, "%-14s n=%lu avg=%lu max=%lu cyc |%s", s_probe_names[p], (unsigned long)h.count,
+                 (unsigned long)(h.sum / h.count), (unsigned long)h.max, line);
+    }
+
+    size_t len = 0;
+    line[0] = '\0';
+    for (int c = 0; c < COUNTER_COUNT; c++) {
+        len = append(line, sizeof(line), len, " %s=%lu", s_counter_names[c],
+                     (unsigned long)atomic_load(&s_counters[c]));
+    }
+    ESP_LOGI(TAG, "counters%s binlog_dropped=%lu", line, (unsigned long)binlog_dropped());
+}
+
+static void dump_tasks(void) {
+#if configUSE_TRACE_FACILITY
+    static TaskStatus_t tasks[PROFILER_MAX_TASKS];
+    configRUN_TIME_COUNTER_TYPE total = 0;
+    UBaseType_t n = uxTaskGetSystemState(tasks, PROFILER_MAX_TASKS, &total);
+    configRUN_TIME_COUNTER_TYPE interval = total - s_prev_total;
+
+    if (n == 0) {
+        ESP_LOGW(TAG, "More than %d tasks, no task report", PROFILER_MAX_TASKS);
+        return;
+    }
+    for (UBaseType_t i = 0; i < n; i++) {
+        const TaskStatus_t *t = &tasks[i];
+        configRUN_TIME_COUNTER_TYPE prev = 0;
+        for (int j = 0; j < PROFILER_MAX_TASKS; j++) {
+            if (s_prev_runtime[j].number == t->xTaskNumber) {
+                prev = s_prev_runtime[j].runtime;
+                break;
+            }
+        }
+        // Share of one core, the total counts wall time
+        unsigned long pct10 = interval ? (unsigned long)(((uint64_t)(t->ulRunTimeCounter - prev) * 1000) / interval) : 0;
+        ESP_LOGI(TAG, "task %-16s prio=%2u stack_free=%5lu B cpu=%lu.%lu%%", t->pcTaskName,
+                 (unsigned)t->uxCurrentPriority, (unsigned long)t->usStackHighWaterMark,
+                 pct10 / 10, pct10 % 10);
+    }
+    memset(s_prev_runtime, 0, sizeof(s_prev_runtime));
+    for (UBaseType_t i = 0; i < n; i++) {
+        s_prev_runtime[i].number = tasks[i].xTaskNumber;
+        s_prev_runtime[i].runtime = tasks[i].ulRunTimeCounter;
+    }
+    s_prev_total = total;
+#else
+    // Only our own stack without the trace facility
+    ESP_LOGI(TAG, "task %-16s stack_free=%5lu B", pcTaskGetName(NULL), (unsigned long)uxTaskGetStackHighWaterMark(NULL));
+#endif
+}
+
+void profiler_dump(void) {
+    dump_probes();
+    dump_tasks();
+    i2c_sched_log_stats();
+    alarm_engine_log_stats();
+    motion_log_stats();
+    power_monitor_log_stats();
+    journal_log_stats();
+}
+
+static void profiler_task(void *pvParameters) {
+    while (1) {
+        vTaskDelay(pdMS_TO_TICKS(s_period_ms));
+        profiler_dump();
+    }
+}
+
+bool profiler_start(uint32_t period_ms, UBaseType_t priority) {
+    s_period_ms = period_ms;
+    // Logging dominates the stack, the task report buffer is static
+    return xTaskCreate(&profiler_task, "profiler", 3072, NULL, priority, NULL) == pdPASS;
+}
@@ -0,0 +1,66 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_cpu.h"
+
+// --- Profiler ---
+// Named probes record cycle-counter latencies into log2 histograms, named
+// counters count rare failures. A low-priority task periodically dumps them
+// with per-task stack high-water marks, CPU share and the stats of the other
+// modules. Cycles are CPU cycles, so with DFS they mix 80 and 240 MHz.
+
+#define PROFILER_PROBES(X)                                              \
+    X(DISPLAY_RENDER, "display_render")     /* Frame drawn into the back buffer */ \
+    X(DISPLAY_SWAP,   "display_swap")       /* Waiting for the previous flush */   \
+    X(SENSOR_PUBLISH, "sensor_publish")     /* Compensation, history, alarms */     \
+    X(IMU_DRAIN,      "imu_drain")          /* FIFO status and burst read */
+
+#define PROFILER_COUNTERS(X)                                            \
+    X(SWAP_TIMEOUT,   "swap_timeout")       /* Display frame dropped */            \
+    X(SAMPLE_FAILED,  "sample_failed")      /* BME690 measurement not read */      \
+    X(IMU_READ_FAILED, "imu_read_failed")
+
+#define PROFILER_ENUM(id, name) PROBE_##id,
+typedef enum {
+    PROFILER_PROBES(PROFILER_ENUM)
+    PROBE_COUNT
+} profiler_probe_t;
+#undef PROFILER_ENUM
+
+#define PROFILER_ENUM(id, name) COUNTER_##id,
+typedef enum {
+    PROFILER_COUNTERS(PROFILER_ENUM)
+    COUNTER_COUNT
+} profiler_counter_t;
+#undef PROFILER_ENUM
+
+#define PROFILER_BINS       32      // Bin k holds latencies in [2^k, 2^(k+1)) cycles
+
+typedef struct {
+    uint32_t count;
+    uint32_t max;
+    uint64_t sum;
+    uint32_t bins[PROFILER_BINS];
+} profiler_hist_t;
+
+static inline uint32_t profiler_begin(void) {
+    return esp_cpu_get_cycle_count();
+}
+
+// Records the cycles since start, safe from any task on either core. The cycle
+// counter is per core, so the span must not migrate: pinned tasks or ISRs only.
+void profiler_end(profiler_probe_t probe, uint32_t start);
+
+void profiler_count(profiler_counter_t counter);
+
+void profiler_get_hist(profiler_probe_t probe, profiler_hist_t *out);
+
+// Starts the periodic report
+bool profiler_start(uint32_t period_ms, UBaseType_t priority);
+
+// Logs everything once
+void profiler_dump(void);
+
+#endif // PROFILER_H
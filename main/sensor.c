@@ -7,180 +7,256 @@
 #include "esp_log.h"
 #include "driver/i2c_master.h"
 #include "sensor.h"
+#include "i2c_scheduler.h"
+
+#define TAG "BME690"
 
 i2c_master_bus_handle_t bus;
 i2c_master_dev_handle_t dev;
-int32_t t_fine;
-
-bme_temp_calib_data_t calib;
-bme_humidity_calib_data_t hum_calib;
-bme_gas_calib_data_t gas_calib;
-
 
 esp_err_t write_register(uint8_t reg, uint8_t value) {
     uint8_t buf[2] = {reg, value};
-    return i2c_master_transmit(dev, buf, 2, pdMS_TO_TICKS(100));
+    return i2c_sched_write(dev, I2C_SCHED_CLASS_ENV, buf, 2);
 }
 
 esp_err_t read_registers(uint8_t reg, uint8_t *buf, size_t len) {
-    return i2c_master_transmit_receive(dev, &reg, 1, buf, len, pdMS_TO_TICKS(100));
-}
-
-void configure_sensor(void) {
-    write_register(REG_CTRL_HUM, OVERSAMPLING_H);
-    write_register(REG_CONFIG, (IIR_FILTER << 2));  // 0b00001000
-    write_register(REG_CTRL_MEAS, (OVERSAMPLING_T << 5) | (OVERSAMPLING_P << 2) | 0x01); // Forced mode
+    return i2c_sched_write_read(dev, I2C_SCHED_CLASS_ENV, &reg, 1, buf, len);
 }
 
-void read_raw_data(int32_t *temp_raw, int32_t *press_raw, int32_t *hum_raw, uint16_t *gas_res_adc, uint8_t *gas_range) {
-    uint8_t data[15];
-    read_registers(REG_DATA_START, data, 15);
+// Measurement cycles per oversampling setting, index is the osrs_x register value
+static const uint8_t os_to_meas_cycles[6] = {0, 1, 2, 4, 8, 16};
 
-    *press_raw = ((uint32_t)data[0] << 12) | ((uint32_t)data[1] << 4) | (data[2] >> 4);
-    *temp_raw  = ((uint32_t)data[3] << 12) | ((uint32_t)data[4] << 4) | (data[5] >> 4);
-    *hum_raw   = ((uint32_t)data[6] << 8) | data[7];
+// ctrl_meas oversampling bits, the mode goes in the low two bits
+#define CTRL_MEAS_OSRS     ((OVERSAMPLING_T << 5) | (OVERSAMPLING_P << 2))
 
-    *gas_res_adc = ((uint16_t)data[13] << 2) | ((data[14] & 0xC0) >> 6);
-    *gas_range   = data[14] & 0x0F;
-}
-
-
- void read_temperature_calibration(void) {
-    uint8_t buf_t1[2], buf_t2[2], buf_t3[1];
+#define CTRL_GAS_1_RUN_GAS 0x20  // run_gas for the BME688/690 gas sensor variant
 
-    read_registers(0xE9, buf_t1, 2);  // par_t1
-    read_registers(0x8A, buf_t2, 2);  // par_t2
-    read_registers(0x8C, buf_t3, 1);  // par_t3
+// Writes several registers in one transaction, the BME690 takes address/value pairs
+static esp_err_t write_registers(const uint8_t *regs, const uint8_t *values, size_t len) {
+    uint8_t buf[2 * (2 * BME_HEATER_MAX_STEPS + 2)];
 
-    calib.par_t1 = (uint16_t)((buf_t1[1] << 8) | buf_t1[0]);
-    calib.par_t2 = (int16_t)((buf_t2[1] << 8) | buf_t2[0]);
-    calib.par_t3 = (int8_t)buf_t3[0];
-
-    ESP_LOGI(TAG, "par_t1=%u, par_t2=%d, par_t3=%d", calib.par_t1, calib.par_t2, calib.par_t3);
+    if (len > sizeof(buf) / 2) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    for (size_t i = 0; i < len; i++) {
+        buf[2 * i] = regs[i];
+        buf[2 * i + 1] = values[i];
+    }
+    return i2c_sched_write(dev, I2C_SCHED_CLASS_ENV, buf, 2 * len);
 }
 
- void read_humidity_calibration(void) {
-    uint8_t buf[7];
-    read_registers(0xE1, buf, 7);
-
-    // Extracting all 7 humidity calibration parameters
-    hum_calib.par_h1 = (int16_t)((buf[0] << 4) | (buf[1] & 0x0F));
-    hum_calib.par_h2 = (int16_t)((buf[2] << 4) | (buf[1] >> 4));
-
-    hum_calib.par_h3 = (int8_t)buf[3];
+// One-time setup, ctrl_hum and config keep their values across forced measurements
+esp_err_t configure_sensor(void) {
+    esp_err_t err = write_register(REG_CTRL_HUM, OVERSAMPLING_H);
+    if (err == ESP_OK) {
+        err = write_register(REG_CONFIG, (IIR_FILTER << 2));  // 0b00001000
+    }
+    return err;
+}
 
-    hum_calib.par_h4 = (int8_t)((int8_t)buf[4] << 4 | (buf[5] & 0x0F));
-    hum_calib.par_h5 = (int8_t)((int8_t)buf[5] >> 4 | (buf[6] << 4));
+// TPH conversion time for the configured oversampling (Bosch bme68x_get_meas_dur)
+uint32_t measurement_duration_us(uint8_t mode) {
+    uint32_t meas_cycles = os_to_meas_cycles[OVERSAMPLING_T] +
+                           os_to_meas_cycles[OVERSAMPLING_P] +
+                           os_to_meas_cycles[OVERSAMPLING_H];
+    uint32_t meas_dur = meas_cycles * UINT32_C(1963);
 
-    read_registers(0xE9, &hum_calib.par_h6, 1); // unsigned
-    read_registers(0xEA, (uint8_t*)&hum_calib.par_h7, 1); // signed
+    meas_dur += UINT32_C(477 * 4);  // TPH switching duration
+    meas_dur += UINT32_C(477 * 5);  // Gas measurement duration
+    if (mode != BME_MODE_PARALLEL) {
+        meas_dur += UINT32_C(1000); // Wake up duration of 1ms
+    }
 
-    ESP_LOGI(TAG, "Humidity calibration:");
-    ESP_LOGI(TAG, "par_h1: %d", hum_calib.par_h1);
-    ESP_LOGI(TAG, "par_h2: %d", hum_calib.par_h2);
-    ESP_LOGI(TAG, "par_h3: %d", hum_calib.par_h3);
-    ESP_LOGI(TAG, "par_h4: %d", hum_calib.par_h4);
-    ESP_LOGI(TAG, "par_h5: %d", hum_calib.par_h5);
-    ESP_LOGI(TAG, "par_h6: %u", hum_calib.par_h6);
-    ESP_LOGI(TAG, "par_h7: %d", hum_calib.par_h7);
+    return meas_dur;
 }
 
- void read_gas_calibration(void) {
-    uint8_t buf_g1, buf_g2[2], buf_g3;
-    uint8_t res_heat_val, res_heat_range, range_err;
-
-    read_registers(0xED, &buf_g1, 1);
-    read_registers(0xEC, buf_g2, 2); // LSB first for par_g2
-    read_registers(0xEE, &buf_g3, 1);
-    read_registers(0x00, &res_heat_val, 1); // res_heat_val
-    read_registers(0x02, &res_heat_range, 1); // bits [6:4]
-    read_registers(0x04, &range_err, 1); // bits [6:4]
-
-    gas_calib.par_g1 = (int8_t)buf_g1;
-    gas_calib.par_g2 = (int16_t)((buf_g2[1] << 8) | buf_g2[0]);
-    gas_calib.par_g3 = (int8_t)buf_g3;
-    gas_calib.res_heat_val = (int8_t)res_heat_val;
-    gas_calib.res_heat_range = (res_heat_range & 0x30) >> 4;
-    gas_calib.range_sw_err = (int8_t)((range_err & 0xF0) >> 4);
-
-    ESP_LOGI(TAG, "Gas Calibration: g1=%d g2=%d g3=%d rhr=%d rhv=%d rse=%d",
-             gas_calib.par_g1, gas_calib.par_g2, gas_calib.par_g3,
-             gas_calib.res_heat_range, gas_calib.res_heat_val, gas_calib.range_sw_err);
+esp_err_t set_operating_mode(uint8_t mode) {
+    return write_register(REG_CTRL_MEAS, CTRL_MEAS_OSRS | mode);
 }
 
- float compensate_temperature(int32_t adc_T) {
+esp_err_t trigger_measurement(void) {
+    return set_operating_mode(BME_MODE_FORCED);
+}
 
-    ESP_LOGI(TAG, "Raw temp: %ld", adc_T);
-    float var1 = (((float)adc_T) / 16384.0f - ((float)calib.par_t1) / 1024.0f) * ((float)calib.par_t2);
-    float var2 = ((((float)adc_T) / 131072.0f - ((float)calib.par_t1) / 8192.0f) *
-                  (((float)adc_T) / 131072.0f - ((float)calib.par_t1) / 8192.0f)) * ((float)calib.par_t3);
-    t_fine = (int32_t)(var1 + var2);
-    return (var1 + var2) / 5120.0f;
+// Decodes one 17-byte field, false when its new data flag is clear
+static bool decode_field(const uint8_t *data, bme_raw_data_t *raw) {
+    raw->status = data[0] & STATUS_NEW_DATA;
+    if (!(raw->status & STATUS_NEW_DATA)) {
+        return false;
+    }
+    raw->gas_index = data[0] & STATUS_GAS_INDEX;
+    raw->meas_index = data[1];
+
+    raw->press = ((uint32_t)data[2] << 12) | ((uint32_t)data[3] << 4) | (data[4] >> 4);
+    raw->temp  = ((uint32_t)data[5] << 12) | ((uint32_t)data[6] << 4) | (data[7] >> 4);
+    raw->hum   = ((uint32_t)data[8] << 8) | data[9];
+
+    raw->gas_adc   = ((uint16_t)data[15] << 2) | ((data[16] & 0xC0) >> 6);
+    raw->gas_range = data[16] & 0x0F;
+    raw->status   |= data[16] & (STATUS_GAS_VALID | STATUS_HEAT_STAB);
+    return true;
 }
 
+esp_err_t read_measurement(bme_raw_data_t *raw) {
+    uint8_t data[LEN_FIELD];
+    esp_err_t err = read_registers(REG_MEAS_STATUS, data, LEN_FIELD);
+    if (err != ESP_OK) {
+        return err;
+    }
+    return decode_field(data, raw) ? ESP_OK : ESP_ERR_NOT_FINISHED;
+}
 
- float compensate_pressure(int32_t adc_P) {
-    // Dummy calibration values (replace with real ones after reading from sensor)
-    int64_t var1, var2, p;
-    int64_t par_p1 = 36477, par_p2 = -10685, par_p3 = 3024;
-    int64_t par_p4 = 2855, par_p5 = 140, par_p6 = -7;
-    int64_t par_p7 = 15500, par_p8 = -14600, par_p9 = 6000;
+esp_err_t read_parallel_fields(bme_raw_data_t out[NUM_FIELDS], uint8_t *count) {
+    uint8_t data[NUM_FIELDS * LEN_FIELD];
+    uint8_t n = 0;
+    esp_err_t err = read_registers(REG_MEAS_STATUS, data, sizeof(data));
+
+    *count = 0;
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    for (int i = 0; i < NUM_FIELDS; i++) {
+        bme_raw_data_t field;
+        if (!decode_field(&data[i * LEN_FIELD], &field)) {
+            continue;
+        }
+        // Insert by meas_index, which wraps at 256
+        int j = n;
+        while (j > 0 && (int8_t)(field.meas_index - out[j - 1].meas_index) < 0) {
+            out[j] = out[j - 1];
+            j--;
+        }
+        out[j] = field;
+        n++;
+    }
+
+    *count = n;
+    return ESP_OK;
+}
 
-    var1 = ((int64_t)t_fine) - 128000;
-    var2 = var1 * var1 * par_p6;
-    var2 = var2 + ((var1 * par_p5) << 17);
-    var2 = var2 + ((int64_t)par_p4 << 35);
-    var1 = ((var1 * par_p3) >> 8) + ((par_p2 * var1) << 12);
-    var1 = (((((int64_t)1) << 47) + var1)) * par_p1 >> 33;
+// Heater resistance code for a target temperature (Bosch calc_res_heat, integer variant)
+static uint8_t calc_res_heat(uint16_t temp, int8_t amb_temp) {
+    const bme_calib_data_t *cal = get_calibration();
+    int32_t var1, var2, var3, var4, var5, heatr_res_x100;
 
-    if (var1 == 0) return 0;
+    if (temp > 400) {
+        temp = 400;  // Cap temperature
+    }
 
-    p = 1048576 - adc_P;
-    p = (((p << 31) - var2) * 3125) / var1;
-    var1 = (par_p9 * (p >> 13) * (p >> 13)) >> 25;
-    var2 = (par_p8 * p) >> 19;
+    var1 = (((int32_t)amb_temp * cal->par_g3) / 1000) * 256;
+    var2 = (cal->par_g1 + 784) * (((((cal->par_g2 + 154009) * temp * 5) / 100) + 3276800) / 10);
+    var3 = var1 + (var2 / 2);
+    var4 = (var3 / (cal->res_heat_range + 4));
+    var5 = (131 * cal->res_heat_val) + 65536;
+    heatr_res_x100 = (int32_t)(((var4 / var5) - 250) * 34);
 
-    p = ((p + var1 + var2) >> 8) + ((int64_t)par_p7 << 4);
-    return (float)p / 256.0f;
+    return (uint8_t)((heatr_res_x100 + 50) / 100);
 }
 
- float compensate_humidity(int32_t adc_H) {
-    int32_t v_x1;
-
-    int32_t temp_scaled = ((t_fine * 5) + 128) >> 8;  // temperature in 0.01°C units
-
-    int32_t var1 = adc_H - ((hum_calib.par_h1 * 16)) - (((temp_scaled * hum_calib.par_h3) / 100) >> 1);
-    int32_t var2 = (hum_calib.par_h2 * (((temp_scaled * hum_calib.par_h4) / 100) +
-                   (((temp_scaled * ((temp_scaled * hum_calib.par_h5) / 100)) >> 6) / 100) + (1 << 14))) >> 10;
-    int32_t var3 = var1 * var2;
-    int32_t var4 = ((hum_calib.par_h6 << 7) + ((temp_scaled * hum_calib.par_h7) / 100)) >> 4;
-    int32_t var5 = ((var3 >> 14) * (var3 >> 14)) >> 10;
-    int32_t var6 = (var4 * var5) >> 1;
+// gas_wait_shared encoding, 0.477 ms units with a 2-bit x4 multiplier (Bosch calc_heatr_dur_shared)
+static uint8_t calc_heatr_dur_shared(uint16_t dur_ms) {
+    uint8_t factor = 0;
+    uint32_t dur;
+
+    if (dur_ms >= 0x783) {
+        return 0xFF;  // Max duration
+    }
+    dur = ((uint32_t)dur_ms * 1000) / 477;
+    while (dur > 0x3F) {
+        dur = dur >> 2;
+        factor += 1;
+    }
+    return (uint8_t)(dur + (factor * 64));
+}
 
-    int32_t hum_comp = ((var3 + var6) >> 10);
-    hum_comp = (hum_comp > 100000 ? 100000 : (hum_comp < 0 ? 0 : hum_comp));
+esp_err_t configure_heater_profile(const bme_heater_profile_t *profile, int8_t amb_temp_c) {
+    uint8_t regs[2 * BME_HEATER_MAX_STEPS + 2];
+    uint8_t values[2 * BME_HEATER_MAX_STEPS + 2];
+    size_t n = 0;
+
+    if (profile->len == 0 || profile->len > BME_HEATER_MAX_STEPS) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    for (uint8_t i = 0; i < profile->len; i++) {
+        regs[n] = REG_RES_HEAT_0 + i;
+        values[n++] = calc_res_heat(profile->temp_c[i], amb_temp_c);
+    }
+    for (uint8_t i = 0; i < profile->len; i++) {
+        regs[n] = REG_GAS_WAIT_0 + i;
+        values[n++] = profile->dur_mult[i];
+    }
+    regs[n] = REG_GAS_WAIT_SHARED;
+    values[n++] = calc_heatr_dur_shared(profile->shared_dur_ms);
+    // Heater on is the ctrl_gas_0 reset value, only run_gas and the step count are set
+    regs[n] = REG_CTRL_GAS_1;
+    values[n++] = CTRL_GAS_1_RUN_GAS | profile->len;
+
+    return write_registers(regs, values, n);
+}
 
-    return hum_comp / 1000.0f;  // %RH
+// Decodes raw NVM bytes, indices follow the Bosch BME68x layout of COEFF1 | COEFF2 | COEFF3
+static void decode_calibration(const uint8_t *c, bme_calib_data_t *out) {
+    out->par_t1 = (uint16_t)((c[32] << 8) | c[31]);
+    out->par_t2 = (int16_t)((c[1] << 8) | c[0]);
+    out->par_t3 = (int8_t)c[2];
+
+    out->par_p1 = (uint16_t)((c[5] << 8) | c[4]);
+    out->par_p2 = (int16_t)((c[7] << 8) | c[6]);
+    out->par_p3 = (int8_t)c[8];
+    out->par_p4 = (int16_t)((c[11] << 8) | c[10]);
+    out->par_p5 = (int16_t)((c[13] << 8) | c[12]);
+    out->par_p7 = (int8_t)c[14];
+    out->par_p6 = (int8_t)c[15];
+    out->par_p8 = (int16_t)((c[19] << 8) | c[18]);
+    out->par_p9 = (int16_t)((c[21] << 8) | c[20]);
+    out->par_p10 = c[22];
+
+    // h1 and h2 share the nibbles of byte 24
+    out->par_h1 = (uint16_t)((c[25] << 4) | (c[24] & 0x0F));
+    out->par_h2 = (uint16_t)((c[23] << 4) | (c[24] >> 4));
+    out->par_h3 = (int8_t)c[26];
+    out->par_h4 = (int8_t)c[27];
+    out->par_h5 = (int8_t)c[28];
+    out->par_h6 = c[29];
+    out->par_h7 = (int8_t)c[30];
+
+    out->par_g1 = (int8_t)c[35];
+    out->par_g2 = (int16_t)((c[34] << 8) | c[33]);
+    out->par_g3 = (int8_t)c[36];
+
+    out->res_heat_val = (int8_t)c[37];
+    out->res_heat_range = (c[39] & 0x30) >> 4;
+    out->range_sw_err = ((int8_t)c[41] & (int8_t)0xF0) / 16;
 }
 
- float compensate_gas(uint16_t gas_adc, uint8_t gas_range) {
-     const uint32_t lookupTable1[16] = {
-        2147483647, 2147483647, 2147483647, 2147483647,
-        2147483647, 2126008810, 2147483647, 2130303777,
-        2147483647, 2147483647, 2143188679, 2136746228,
-        2147483647, 2126008810, 2147483647, 2147483647
-    };
-     const uint32_t lookupTable2[16] = {
-        4096000000, 2048000000, 1024000000, 512000000,
-        255744255, 127110228, 64000000, 32258064,
-        16016016, 8000000, 4000000, 2000000,
-        1000000, 500000, 250000, 125000
-    };
-
-    float var1 = (1340.0f + 5.0f * gas_calib.range_sw_err);
-    float var2 = (lookupTable1[gas_range] / 65536.0f);
-    float var3 = 1.0f + (gas_adc / 262144.0f);
-    float gas_res = var2 * var1 * var3;
-
-    return gas_res;  // in Ohms
+esp_err_t load_calibration(void) {
+    uint8_t coeff[LEN_COEFF_ALL];
+    bme_calib_data_t calib;
+    esp_err_t err;
+
+    // Two contiguous NVM regions, plus the small heater block at the start of the map
+    err = read_registers(REG_COEFF1, coeff, LEN_COEFF1);
+    if (err == ESP_OK) {
+        err = read_registers(REG_COEFF2, &coeff[LEN_COEFF1], LEN_COEFF2);
+    }
+    if (err == ESP_OK) {
+        err = read_registers(REG_COEFF3, &coeff[LEN_COEFF1 + LEN_COEFF2], LEN_COEFF3);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Calibration read failed: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    decode_calibration(coeff, &calib);
+    ESP_LOGI(TAG, "Calibration: t1=%u t2=%d t3=%d p1=%u p2=%d p3=%d p4=%d p5=%d p6=%d p7=%d p8=%d p9=%d p10=%u",
+             calib.par_t1, calib.par_t2, calib.par_t3, calib.par_p1, calib.par_p2, calib.par_p3,
+             calib.par_p4, calib.par_p5, calib.par_p6, calib.par_p7, calib.par_p8, calib.par_p9, calib.par_p10);
+    ESP_LOGI(TAG, "Calibration: h1=%u h2=%u h3=%d h4=%d h5=%d h6=%u h7=%d g1=%d g2=%d g3=%d rhr=%u rhv=%d rse=%d",
+             calib.par_h1, calib.par_h2, calib.par_h3, calib.par_h4, calib.par_h5, calib.par_h6, calib.par_h7,
+             calib.par_g1, calib.par_g2, calib.par_g3, calib.res_heat_range, calib.res_heat_val, calib.range_sw_err);
+
+    set_calibration(&calib);
+    return ESP_OK;
 }
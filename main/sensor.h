@@ -9,10 +9,9 @@
 #include "freertos/task.h"
 #include "esp_log.h"
 #include "driver/i2c_master.h"
-#include "sensor.h"
+#include "bme_compensation.h"
 
 // Constants
-#define TAG "BME690"
 #define I2C_PORT 0
 #define SDA_PIN 21
 #define SCL_PIN 22
@@ -23,53 +22,80 @@
 #define REG_CTRL_HUM       0x72
 #define REG_CTRL_MEAS      0x74
 #define REG_CONFIG         0x75
-#define REG_DATA_START     0x1F
+#define REG_MEAS_STATUS    0x1D  // Start of the status + data field
+#define LEN_FIELD          17
+#define NUM_FIELDS         3     // Parallel mode fills fields at 0x1D, 0x2E and 0x3F
+#define REG_RES_HEAT_0     0x5A
+#define REG_GAS_WAIT_0     0x64
+#define REG_GAS_WAIT_SHARED 0x6E
+#define REG_CTRL_GAS_1     0x71
+
+// Operating mode, low bits of ctrl_meas
+#define BME_MODE_SLEEP     0x00
+#define BME_MODE_FORCED    0x01
+#define BME_MODE_PARALLEL  0x02
+
+// bme_raw_data_t.status, new_data from meas_status_0, the rest from gas_r_lsb
+#define STATUS_NEW_DATA      0x80
+#define STATUS_GAS_INDEX     0x0F  // Heater step of the field, in meas_status_0
+#define STATUS_GAS_VALID     0x20  // Only set with run_gas
+#define STATUS_HEAT_STAB     0x10
 
 #define OVERSAMPLING_T     0x02  // x2
 #define OVERSAMPLING_P     0x05  // x16
 #define OVERSAMPLING_H     0x01  // x1
 #define IIR_FILTER         0x02  // filter coefficient = 3
 
-// Calibration data structures
-typedef struct {
-    uint16_t par_t1;
-    int16_t par_t2;
-    int8_t par_t3;
-} bme_temp_calib_data_t;
+// Calibration NVM regions
+#define REG_COEFF1         0x8A
+#define LEN_COEFF1         23
+#define REG_COEFF2         0xE1
+#define LEN_COEFF2         14
+#define REG_COEFF3         0x00  // Heater calibration
+#define LEN_COEFF3         5
+#define LEN_COEFF_ALL      (LEN_COEFF1 + LEN_COEFF2 + LEN_COEFF3)
+
+// Heater profile for parallel mode. Step i heats to temp_c[i] for dur_mult[i]
+// TPHG cycles, each cycle being the TPH conversion plus shared_dur_ms.
+#define BME_HEATER_MAX_STEPS 10
 
 typedef struct {
-    int16_t par_h1;
-    int16_t par_h2;
-    int8_t  par_h3;
-    int8_t  par_h4;
-    int8_t  par_h5;
-    uint8_t par_h6;
-    int8_t  par_h7;
-} bme_humidity_calib_data_t;
+    uint8_t len;                                // Steps in use, 1..BME_HEATER_MAX_STEPS
+    uint16_t shared_dur_ms;                     // gas_wait_shared
+    uint16_t temp_c[BME_HEATER_MAX_STEPS];      // Target °C, capped at 400
+    uint8_t dur_mult[BME_HEATER_MAX_STEPS];     // gas_wait_x
+} bme_heater_profile_t;
 
+// Uncompensated ADC values of one field, as read in a single burst
 typedef struct {
-    int8_t par_g1;
-    int16_t par_g2;
-    int8_t par_g3;
-    uint8_t res_heat_range;
-    int8_t res_heat_val;
-    int8_t range_sw_err;
-} bme_gas_calib_data_t;
+    uint8_t status;             // STATUS_* flags
+    uint8_t gas_index;          // Heater profile step that produced the field
+    uint8_t meas_index;         // Increments per measurement, orders parallel fields
+    int32_t temp;
+    int32_t press;
+    int32_t hum;
+    uint16_t gas_adc;
+    uint8_t gas_range;
+} bme_raw_data_t;
 
 // Function declarations
 esp_err_t write_register(uint8_t reg, uint8_t value);
 esp_err_t read_registers(uint8_t reg, uint8_t *buf, size_t len);
 
-void configure_sensor(void);
-void read_raw_data(int32_t *temp_raw, int32_t *press_raw, int32_t *hum_raw, uint16_t *gas_res_adc, uint8_t *gas_range);
+esp_err_t configure_sensor(void);
+uint32_t measurement_duration_us(uint8_t mode);
+esp_err_t set_operating_mode(uint8_t mode);
+esp_err_t trigger_measurement(void);
+// Returns ESP_ERR_NOT_FINISHED while the new data flag is still clear
+esp_err_t read_measurement(bme_raw_data_t *raw);
 
-void read_temperature_calibration(void);
-void read_humidity_calibration(void);
-void read_gas_calibration(void);
+// Programs heater steps for parallel mode, codes are computed for amb_temp_c.
+// The sensor must be in sleep mode.
+esp_err_t configure_heater_profile(const bme_heater_profile_t *profile, int8_t amb_temp_c);
+// Reads all three fields in one burst, returns the new ones in measurement order
+esp_err_t read_parallel_fields(bme_raw_data_t out[NUM_FIELDS], uint8_t *count);
 
-float compensate_temperature(int32_t adc_T);
-float compensate_pressure(int32_t adc_P);
-float compensate_humidity(int32_t adc_H);
-float compensate_gas(uint16_t gas_adc, uint8_t gas_range);
+// Burst-reads the calibration NVM and decodes it, three short reads on every boot
+esp_err_t load_calibration(void);
 
 #endif // SENSOR_H
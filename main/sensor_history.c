@@ -0,0 +1,256 @@
+#include "sensor_history.h"
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#define HIST_MASK (SENSOR_HISTORY_CAPACITY - 1)
+
+// Regression time unit, keeps the 64-bit sums far from overflow
+#define HIST_SLOPE_UNIT_MS 100
+#define HIST_SLOPE_UNITS_PER_MIN (60000 / HIST_SLOPE_UNIT_MS)
+
+typedef struct {
+    uint32_t t_ms;
+    int16_t value[HIST_CH_COUNT];   // Delta from s_base
+} history_record_t;
+
+// Ring of record sequence numbers with monotonic values, front is the extreme
+typedef struct {
+    uint16_t seq[SENSOR_HISTORY_CAPACITY];
+    uint16_t head;
+    uint16_t tail;
+} history_deque_t;
+
+typedef struct {
+    uint32_t duration_ms;
+    uint32_t first;                 // Sequence number of the oldest record inside
+    uint16_t count;
+    uint32_t origin_ms;             // Regression time origin, moves in whole HIST_SLOPE_UNIT_MS
+    int64_t sum_t;
+    int64_t sum_tt;
+    int64_t sum_y[HIST_CH_COUNT];
+    int64_t sum_ty[HIST_CH_COUNT];
+    history_deque_t min_dq[HIST_CH_COUNT];
+    history_deque_t max_dq[HIST_CH_COUNT];
+} history_window_t;
+
+static history_record_t s_ring[SENSOR_HISTORY_CAPACITY];
+static uint32_t s_next_seq;         // Sequence number of the next record
+static int32_t s_base[HIST_CH_COUNT];
+static uint32_t s_min_interval_ms;
+
+static history_window_t s_windows[SENSOR_HISTORY_MAX_WINDOWS];
+static int s_window_count;
+
+// Queries come from other tasks, every section below is O(1) amortized
+static portMUX_TYPE s_history_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static inline const history_record_t *record_at(uint32_t seq) {
+    return &s_ring[seq & HIST_MASK];
+}
+
+// Regression time of a record, in units from the window origin. Relative to
+// the origin so it stays continuous when the millisecond clock wraps.
+static inline int32_t slope_time(const history_window_t *w, uint32_t t_ms) {
+    int32_t d = (int32_t)(t_ms - w->origin_ms);
+    return d >= 0 ? d / HIST_SLOPE_UNIT_MS : -((HIST_SLOPE_UNIT_MS - 1 - d) / HIST_SLOPE_UNIT_MS);
+}
+
+// --- Monotonic deque ---
+
+static inline bool dq_empty(const history_deque_t *dq) {
+    return dq->head == dq->tail;
+}
+
+static inline uint16_t dq_front(const history_deque_t *dq) {
+    return dq->seq[dq->head & HIST_MASK];
+}
+
+static inline uint16_t dq_back(const history_deque_t *dq) {
+    return dq->seq[(uint16_t)(dq->tail - 1) & HIST_MASK];
+}
+
+// Drops back entries that can no longer be the extreme, then appends seq.
+// keep_min selects a min deque (values increase from front to back).
+static void dq_push(history_deque_t *dq, uint32_t seq, int ch, bool keep_min) {
+    int16_t v = record_at(seq)->value[ch];
+
+    while (!dq_empty(dq)) {
+        int16_t back = record_at(dq_back(dq))->value[ch];
+        if (keep_min ? back < v : back > v) {
+            break;
+        }
+        dq->tail--;
+    }
+    dq->seq[dq->tail & HIST_MASK] = (uint16_t)seq;
+    dq->tail++;
+}
+
+static inline void dq_evict(history_deque_t *dq, uint32_t seq) {
+    if (!dq_empty(dq) && dq_front(dq) == (uint16_t)seq) {
+        dq->head++;
+    }
+}
+
+// --- Window maintenance ---
+
+static void window_remove_oldest(history_window_t *w) {
+    const history_record_t *r = record_at(w->first);
+    int64_t t = slope_time(w, r->t_ms);
+
+    w->sum_t -= t;
+    w->sum_tt -= t * t;
+    for (int ch = 0; ch < HIST_CH_COUNT; ch++) {
+        w->sum_y[ch] -= r->value[ch];
+        w->sum_ty[ch] -= t * r->value[ch];
+        dq_evict(&w->min_dq[ch], w->first);
+        dq_evict(&w->max_dq[ch], w->first);
+    }
+    w->first++;
+    w->count--;
+}
+
+// Moves the regression origin to the newest record so sums stay small
+static void window_rebase(history_window_t *w, uint32_t t_ms) {
+    int64_t d = slope_time(w, t_ms);
+
+    w->sum_tt += -2 * d * w->sum_t + (int64_t)w->count * d * d;
+    w->sum_t -= (int64_t)w->count * d;
+    for (int ch = 0; ch < HIST_CH_COUNT; ch++) {
+        w->sum_ty[ch] -= d * w->sum_y[ch];
+    }
+    w->origin_ms += (uint32_t)(d * HIST_SLOPE_UNIT_MS);
+}
+
+static void window_add(history_window_t *w, uint32_t seq) {
+    const history_record_t *r = record_at(seq);
+
+    if (w->count == 0) {
+        w->first = seq;
+        w->origin_ms = r->t_ms;
+    } else {
+        window_rebase(w, r->t_ms);
+    }
+
+    // t is 0 at the new origin
+    w->count++;
+    for (int ch = 0; ch < HIST_CH_COUNT; ch++) {
+        w->sum_y[ch] += r->value[ch];
+        dq_push(&w->min_dq[ch], seq, ch, true);
+        dq_push(&w->max_dq[ch], seq, ch, false);
+    }
+
+    while (w->count > 0 && (uint32_t)(r->t_ms - record_at(w->first)->t_ms) > w->duration_ms) {
+        window_remove_oldest(w);
+    }
+}
+
+// --- Public API ---
+
+void sensor_history_init(uint32_t min_interval_ms) {
+    taskENTER_CRITICAL(&s_history_lock);
+    s_min_interval_ms = min_interval_ms;
+    s_next_seq = 0;
+    s_window_count = 0;
+    memset(s_windows, 0, sizeof(s_windows));
+    taskEXIT_CRITICAL(&s_history_lock);
+}
+
+int sensor_history_add_window(uint32_t duration_ms) {
+    int id = -1;
+
+    taskENTER_CRITICAL(&s_history_lock);
+    if (s_window_count < SENSOR_HISTORY_MAX_WINDOWS) {
+        id = s_window_count++;
+        memset(&s_windows[id], 0, sizeof(s_windows[id]));
+        s_windows[id].duration_ms = duration_ms;
+    }
+    taskEXIT_CRITICAL(&s_history_lock);
+    return id;
+}
+
+static inline int16_t clamp_delta(int32_t v) {
+    return (int16_t)(v > INT16_MAX ? INT16_MAX : (v < INT16_MIN ? INT16_MIN : v));
+}
+
+void sensor_history_push(const bme_sample_t *sample) {
+    uint32_t t_ms = (uint32_t)(sample->timestamp_us / 1000);
+    int32_t v[HIST_CH_COUNT] = {
+        [HIST_CH_TEMPERATURE] = sample->reading.temperature,
+        [HIST_CH_PRESSURE] = (int32_t)sample->reading.pressure,
+        [HIST_CH_HUMIDITY] = (int32_t)(sample->reading.humidity / 10),
+    };
+
+    taskENTER_CRITICAL(&s_history_lock);
+    if (s_next_seq > 0 && (uint32_t)(t_ms - record_at(s_next_seq - 1)->t_ms) < s_min_interval_ms) {
+        taskEXIT_CRITICAL(&s_history_lock);
+        return;
+    }
+    if (s_next_seq == 0) {
+        memcpy(s_base, v, sizeof(s_base));
+    }
+
+    // The slot is about to be reused, drop it from any window still holding it
+    for (int i = 0; i < s_window_count; i++) {
+        history_window_t *w = &s_windows[i];
+        if (w->count > 0 && w->first == s_next_seq - SENSOR_HISTORY_CAPACITY) {
+            window_remove_oldest(w);
+        }
+    }
+
+    history_record_t *r = &s_ring[s_next_seq & HIST_MASK];
+    r->t_ms = t_ms;
+    for (int ch = 0; ch < HIST_CH_COUNT; ch++) {
+        r->value[ch] = clamp_delta(v[ch] - s_base[ch]);
+    }
+    for (int i = 0; i < s_window_count; i++) {
+        window_add(&s_windows[i], s_next_seq);
+    }
+    s_next_seq++;
+    taskEXIT_CRITICAL(&s_history_lock);
+}
+
+bool sensor_history_query(int window, sensor_history_channel_t ch, sensor_history_stats_t *out) {
+    if (window < 0 || window >= s_window_count || ch >= HIST_CH_COUNT) {
+        return false;
+    }
+
+    taskENTER_CRITICAL(&s_history_lock);
+    const history_window_t *w = &s_windows[window];
+    if (w->count == 0) {
+        taskEXIT_CRITICAL(&s_history_lock);
+        return false;
+    }
+
+    int64_t n = w->count;
+    int64_t den = n * w->sum_tt - w->sum_t * w->sum_t;
+    int64_t num = n * w->sum_ty[ch] - w->sum_t * w->sum_y[ch];
+
+    out->min = s_base[ch] + record_at(dq_front(&w->min_dq[ch]))->value[ch];
+    out->max = s_base[ch] + record_at(dq_front(&w->max_dq[ch]))->value[ch];
+    out->mean = s_base[ch] + (int32_t)(w->sum_y[ch] / n);
+    out->slope_per_min = den != 0 ? (int32_t)((num * HIST_SLOPE_UNITS_PER_MIN) / den) : 0;
+    out->count = w->count;
+    out->span_ms = record_at(s_next_seq - 1)->t_ms - record_at(w->first)->t_ms;
+    taskEXIT_CRITICAL(&s_history_lock);
+    return true;
+}
+
+uint16_t sensor_history_recent(sensor_history_channel_t ch, int32_t *out, uint16_t max) {
+    uint16_t n;
+
+    if (ch >= HIST_CH_COUNT) {
+        return 0;
+    }
+
+    taskENTER_CRITICAL(&s_history_lock);
+    n = s_next_seq < SENSOR_HISTORY_CAPACITY ? (uint16_t)s_next_seq : SENSOR_HISTORY_CAPACITY;
+    if (n > max) {
+        n = max;
+    }
+    for (uint16_t i = 0; i < n; i++) {
+        out[i] = s_base[ch] + record_at(s_next_seq - n + i)->value[ch];
+    }
+    taskEXIT_CRITICAL(&s_history_lock);
+    return n;
+}
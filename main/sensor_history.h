@@ -0,0 +1,49 @@
+#ifndef SENSOR_HISTORY_H
+#define SENSOR_HISTORY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "sensor_snapshot.h"
+
+// --- Sensor history ---
+// Fixed ring of compact records (16-bit deltas from the first sample plus a
+// 32-bit millisecond timestamp). Sliding time windows keep running sums and
+// monotonic min/max deques, so every query is O(1) and a push is O(1)
+// amortized. All storage is static.
+
+#define SENSOR_HISTORY_CAPACITY    256  // Records, power of two
+#define SENSOR_HISTORY_MAX_WINDOWS 3
+
+typedef enum {
+    HIST_CH_TEMPERATURE = 0,    // 0.01 °C
+    HIST_CH_PRESSURE,           // Pa
+    HIST_CH_HUMIDITY,           // 0.01 %RH
+    HIST_CH_COUNT
+} sensor_history_channel_t;
+
+typedef struct {
+    int32_t min;
+    int32_t max;
+    int32_t mean;
+    int32_t slope_per_min;      // Least-squares trend, channel units per minute
+    uint16_t count;             // Records in the window
+    uint32_t span_ms;           // Newest minus oldest timestamp
+} sensor_history_stats_t;
+
+// Samples closer than min_interval_ms to the previous record are not stored
+void sensor_history_init(uint32_t min_interval_ms);
+
+// Adds a window covering the last duration_ms, returns its id or -1 when full.
+// Call before the first push; a window never holds more than the ring capacity.
+int sensor_history_add_window(uint32_t duration_ms);
+
+// Feeds one sample, called by the acquisition task only
+void sensor_history_push(const bme_sample_t *sample);
+
+// Stats of one channel over a window, false while the window is empty
+bool sensor_history_query(int window, sensor_history_channel_t ch, sensor_history_stats_t *out);
+
+// Copies up to max most recent values of a channel, oldest first, returns the count
+uint16_t sensor_history_recent(sensor_history_channel_t ch, int32_t *out, uint16_t max);
+
+#endif // SENSOR_HISTORY_H
@@ -1,64 +1,247 @@
 #include "sensor_logic.h" // Includes global_vars.h and common_types.h
+#include "sensor_history.h"
+#include "alarm_engine.h"
+#include "display_logic.h"
+#include "profiler.h"
+#include "binlog.h"
+#include "journal.h"
 #include <stdio.h>
 #include "esp_log.h"
-// freertos/semphr.h is included via global_vars.h -> freertos/FreeRTOS.h or directly if needed
+#include "esp_timer.h"
 
 static const char *TAG = "SENSOR_LOGIC";
 
-// --- Configuration (copied from original main.c, can be centralized if needed) ---
-#define SENSOR_UPDATE_INTERVAL_MS 5000
-#define EMERGENCY_SIM_INTERVAL_COUNT 3
-#define EMERGENCY_DURATION_SENSOR_CYCLES 2
+// Re-polls when new_data is not yet set at the computed end of conversion
+#define SENSOR_ACQ_POLL_US      1000
+#define SENSOR_ACQ_POLL_RETRIES 5
 
-void sensor_simulation_task(void *pvParameters) {
-    uint8_t trigger_counter = 0;
-    uint8_t emergency_active_duration_counter = 0;
-    emergency_type_t next_emergency_to_simulate = EMERGENCY_TYPE_DANGER;
+// Journal keeps one sample per interval, from the heater step of the last
+// one, so successive gas values compare; after two intervals without that
+// step any sample goes. Blocks go to the journal once they span a minute,
+// about 8 bytes per sample. Each continues from the one before, only every
+// SENSOR_JOURNAL_KEY_BLOCKS-th carries full values. A power loss takes at most
+// that minute with the RAM block, plus JOURNAL_FLUSH_MS.
+#define SENSOR_JOURNAL_INTERVAL_MS 10000
+#define SENSOR_JOURNAL_BLOCK_MS    60000
+#define SENSOR_JOURNAL_KEY_BLOCKS  10
 
-    ESP_LOGI(TAG, "Sensor simulation task started.");
+static TaskHandle_t s_acq_task;
+static esp_timer_handle_t s_acq_timer;
+static uint32_t s_acq_period_ms;
+static bme_heater_profile_t s_heater_profile;   // len 0 runs plain forced mode
+static int64_t s_journal_last_us;
+static int8_t s_journal_step;
+static codec_encoder_t s_journal_block;
+static emergency_type_t s_journal_emergency;
+
+static void acq_timer_cb(void *arg) {
+    xTaskNotifyGive(s_acq_task);
+}
+
+// Sleeps for us microseconds with esp_timer resolution instead of the 10 ms tick
+static void acq_sleep_us(uint32_t us) {
+    // A timer that fired after the last wait timed out left a notification behind
+    ulTaskNotifyTake(pdTRUE, 0);
+    if (esp_timer_start_once(s_acq_timer, us) != ESP_OK) {
+        vTaskDelay(pdMS_TO_TICKS(us / 1000) + 1);
+        return;
+    }
+    if (ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(us / 1000) + 2) == 0) {
+        esp_timer_stop(s_acq_timer);
+    }
+}
+
+static esp_err_t acquire_sample(uint32_t meas_us, bme_raw_data_t *raw) {
+    esp_err_t err = trigger_measurement();
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    acq_sleep_us(meas_us);
+    for (int i = 0; i < SENSOR_ACQ_POLL_RETRIES; i++) {
+        err = read_measurement(raw);
+        if (err != ESP_ERR_NOT_FINISHED) {
+            break;
+        }
+        acq_sleep_us(SENSOR_ACQ_POLL_US);
+    }
+    return err;
+}
+
+static void journal_flush_samples(void) {
+    uint8_t block[JOURNAL_MAX_PAYLOAD];
+    size_t len = codec_encoder_finish(&s_journal_block, block, sizeof(block));
+
+    // Continued blocks after a dropped one would not decode, start over
+    if (len > 0 && !journal_append(JOURNAL_REC_SAMPLES, block, len)) {
+        codec_encoder_chain(&s_journal_block, SENSOR_JOURNAL_KEY_BLOCKS - 1);
+    }
+}
+
+static void journal_sample(const bme_sample_t *sample) {
+    int32_t values[JOURNAL_CH_COUNT] = {
+        [JOURNAL_CH_STEP] = sample->heater_step,
+        [JOURNAL_CH_STATUS] = sample->status,
+        [JOURNAL_CH_TEMPERATURE] = sample->reading.temperature,
+        [JOURNAL_CH_PRESSURE] = (int32_t)sample->reading.pressure,
+        [JOURNAL_CH_HUMIDITY] = (int32_t)sample->reading.humidity,
+        [JOURNAL_CH_GAS] = (int32_t)sample->reading.gas_resistance,
+    };
+    uint32_t time_ms = (uint32_t)(sample->timestamp_us / 1000);
+    emergency_type_t emergency = atomic_load(&g_current_emergency_type);
+    bool alarm_changed = emergency != s_journal_emergency;
+    int64_t since_us = sample->timestamp_us - s_journal_last_us;
+    bool due = since_us >= SENSOR_JOURNAL_INTERVAL_MS * 1000LL &&
+               (sample->heater_step == s_journal_step || since_us >= 2 * SENSOR_JOURNAL_INTERVAL_MS * 1000LL);
+
+    if (sample->seq == 1 || alarm_changed || due) {
+        if (!codec_encoder_add(&s_journal_block, time_ms, values)) {
+            journal_flush_samples();
+            codec_encoder_add(&s_journal_block, time_ms, values);
+        }
+        if (sample->seq == 1 || due) {
+            s_journal_step = sample->heater_step;
+        }
+        s_journal_last_us = sample->timestamp_us;
+        if (time_ms - s_journal_block.time0 >= SENSOR_JOURNAL_BLOCK_MS) {
+            journal_flush_samples();
+        }
+    }
+
+    // The lead-up to an alarm must reach flash without waiting for the block
+    if (alarm_changed) {
+        s_journal_emergency = emergency;
+        journal_flush_samples();
+    }
+}
+
+static void publish_raw(bme_sample_t *sample, const bme_raw_data_t *raw, int8_t step) {
+    uint32_t start = profiler_begin();
+
+    sample->timestamp_us = esp_timer_get_time();
+    sample->seq++;
+    sample->heater_step = step;
+    sample->status = raw->status;
+    compensate_reading(raw->temp, raw->press, raw->hum, raw->gas_adc, raw->gas_range, &sample->reading);
+    sensor_snapshot_publish(sample);
+    sensor_history_push(sample);
+    alarm_engine_evaluate(sample);
+    display_request_refresh();
+    if (sample->seq == 1) {
+        xEventGroupSetBits(g_boot_events, BOOT_BIT_FIRST_SAMPLE);
+    }
+    profiler_end(PROBE_SENSOR_PUBLISH, start);
+
+    BINLOG(SAMPLE, step, sample->reading.temperature, sample->reading.pressure,
+           sample->reading.humidity, sample->reading.gas_resistance);
+    journal_sample(sample);
+}
+
+static void run_forced_mode(bme_sample_t *sample) {
+    const uint32_t meas_us = measurement_duration_us(BME_MODE_FORCED);
+    TickType_t last_wake = xTaskGetTickCount();
+    bme_raw_data_t raw;
+
+    ESP_LOGI(TAG, "Forced mode, conversion %lu us every %lu ms.",
+             (unsigned long)meas_us, (unsigned long)s_acq_period_ms);
 
     while (1) {
-        vTaskDelay(pdMS_TO_TICKS(SENSOR_UPDATE_INTERVAL_MS));
-
-        g_temperature += 0.5f;
-        if (g_temperature > 40.0f) g_temperature = 20.0f;
-        g_pressure -= 1.0f;
-        if (g_pressure < 980.0f) g_pressure = 1012.5f;
-        g_humidity += 2.0f;
-        if (g_humidity > 90.0f) g_humidity = 50.0f;
-
-        ESP_LOGI(TAG, "Simulated sensor update: T=%.1f, P=%.1f, H=%.0f", g_temperature, g_pressure, g_humidity);
-
-        if (xSemaphoreTake(g_display_mutex, pdMS_TO_TICKS(100)) == pdTRUE) {
-            if (emergency_active_duration_counter > 0) {
-                emergency_active_duration_counter--;
-                if (emergency_active_duration_counter == 0) {
-                    ESP_LOGI(TAG, "Clearing simulated emergency.");
-                    g_current_emergency_type = EMERGENCY_TYPE_NONE;
-                }
-            } else {
-                trigger_counter++;
-                if (trigger_counter >= EMERGENCY_SIM_INTERVAL_COUNT) {
-                    trigger_counter = 0;
-                    if (g_current_emergency_type == EMERGENCY_TYPE_NONE) {
-                        g_current_emergency_type = next_emergency_to_simulate;
-                        emergency_active_duration_counter = EMERGENCY_DURATION_SENSOR_CYCLES;
-                        ESP_LOGW(TAG, "Simulating EMERGENCY: %s for %d sensor cycles",
-                                 (g_current_emergency_type == EMERGENCY_TYPE_DANGER) ? "DANGER" : "FALL",
-                                 EMERGENCY_DURATION_SENSOR_CYCLES);
-
-                        if (next_emergency_to_simulate == EMERGENCY_TYPE_DANGER) {
-                            next_emergency_to_simulate = EMERGENCY_TYPE_FALL;
-                        } else {
-                            next_emergency_to_simulate = EMERGENCY_TYPE_DANGER;
-                        }
-                    }
-                }
-            }
-            xSemaphoreGive(g_display_mutex);
+        esp_err_t err = acquire_sample(meas_us, &raw);
+        if (err == ESP_OK) {
+            publish_raw(sample, &raw, -1);
         } else {
-            ESP_LOGW(TAG, "Sensor task could not acquire mutex for emergency simulation.");
+            profiler_count(COUNTER_SAMPLE_FAILED);
+            BINLOG(SAMPLE_FAILED, err);
         }
+
+        vTaskDelayUntil(&last_wake, pdMS_TO_TICKS(s_acq_period_ms));
     }
 }
 
+// The sensor walks the heater profile by itself, the task only collects finished fields.
+// Three fields buffer about three TPHG cycles, so polling once per cycle never loses one.
+static void run_parallel_mode(bme_sample_t *sample, int8_t amb_temp_c) {
+    const uint32_t poll_us = measurement_duration_us(BME_MODE_PARALLEL) +
+                             (uint32_t)s_heater_profile.shared_dur_ms * 1000;
+    bme_raw_data_t fields[NUM_FIELDS];
+    uint8_t count, last_index = 0;
+    bool have_last = false;
+    esp_err_t err;
+
+    err = configure_heater_profile(&s_heater_profile, amb_temp_c);
+    if (err == ESP_OK) {
+        err = set_operating_mode(BME_MODE_PARALLEL);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Heater profile setup failed: %s", esp_err_to_name(err));
+        return;
+    }
+    ESP_LOGI(TAG, "Parallel mode, %u heater steps, polling every %lu us.",
+             s_heater_profile.len, (unsigned long)poll_us);
+
+    while (1) {
+        acq_sleep_us(poll_us);
+
+        err = read_parallel_fields(fields, &count);
+        if (err != ESP_OK) {
+            profiler_count(COUNTER_SAMPLE_FAILED);
+            BINLOG(SAMPLE_FAILED, err);
+            continue;
+        }
+        for (uint8_t i = 0; i < count; i++) {
+            // A field may still flag new_data on the next poll, skip the ones already published
+            if (have_last && (int8_t)(fields[i].meas_index - last_index) <= 0) {
+                continue;
+            }
+            last_index = fields[i].meas_index;
+            have_last = true;
+            publish_raw(sample, &fields[i], (int8_t)fields[i].gas_index);
+        }
+    }
+}
+
+static void sensor_acquisition_task(void *pvParameters) {
+    bme_sample_t sample = {0};
+    bme_raw_data_t raw;
+
+    if (s_heater_profile.len > 0) {
+        // One forced TPH measurement gives the ambient temperature for the heater codes
+        int8_t amb_temp_c = 25;
+        if (acquire_sample(measurement_duration_us(BME_MODE_FORCED), &raw) == ESP_OK) {
+            publish_raw(&sample, &raw, -1);
+            amb_temp_c = (int8_t)(sample.reading.temperature / 100);
+        }
+        run_parallel_mode(&sample, amb_temp_c);
+        ESP_LOGW(TAG, "Falling back to forced mode without heater.");
+    }
+    run_forced_mode(&sample);
+}
+
+bool sensor_acquisition_start(uint32_t period_ms, const bme_heater_profile_t *profile,
+                              UBaseType_t priority, BaseType_t core) {
+    const esp_timer_create_args_t timer_args = {
+        .callback = acq_timer_cb,
+        .name = "sensor_acq",
+    };
+
+    if (profile != NULL && (profile->len == 0 || profile->len > BME_HEATER_MAX_STEPS)) {
+        return false;
+    }
+    s_acq_period_ms = period_ms;
+    if (!codec_encoder_init(&s_journal_block, &(codec_layout_t)JOURNAL_SAMPLE_LAYOUT, JOURNAL_MAX_PAYLOAD)) {
+        return false;
+    }
+    codec_encoder_chain(&s_journal_block, SENSOR_JOURNAL_KEY_BLOCKS - 1);
+    if (profile != NULL) {
+        s_heater_profile = *profile;
+    }
+    if (esp_timer_create(&timer_args, &s_acq_timer) != ESP_OK) {
+        return false;
+    }
+    if (xTaskCreatePinnedToCore(&sensor_acquisition_task, "sensor_acq_task", 4096, NULL,
+                                priority, &s_acq_task, core) != pdPASS) {
+        esp_timer_delete(s_acq_timer);
+        return false;
+    }
+    return true;
+}
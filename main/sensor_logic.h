@@ -4,9 +4,14 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "global_vars.h" // For global variable extern declarations and common_types.h
+#include "sensor.h"
+#include "sensor_snapshot.h"
 
-// Task function declaration
-void sensor_simulation_task(void *pvParameters);
+// Starts acquisition, the sensor must be configured and calibrated. Without a heater
+// profile it runs a forced TPH measurement every period_ms, with one it runs parallel
+// mode continuously and period_ms is unused. Samples go to sensor_snapshot_publish().
+bool sensor_acquisition_start(uint32_t period_ms, const bme_heater_profile_t *profile,
+                              UBaseType_t priority, BaseType_t core);
 
 #endif // SENSOR_LOGIC_H
 
@@ -0,0 +1,46 @@
+#include "sensor_snapshot.h"
+#include <stdatomic.h>
+#include <string.h>
+
+// Latched sequence lock: the writer updates the two copies in turn and bumps
+// the sequence before each one, so the copy selected by (seq & 1) is never
+// the one being written. A reader preempted by the writer, or racing it from
+// the other core, sees the sequence move and copies again.
+static struct {
+    atomic_uint_fast32_t seq;   // Even: copy 0 is stable, odd: copy 1 is stable
+    bme_sample_t copy[2];
+} s_snapshot;
+
+static atomic_bool s_snapshot_valid;
+
+void sensor_snapshot_publish(const bme_sample_t *sample) {
+    uint_fast32_t seq = atomic_load_explicit(&s_snapshot.seq, memory_order_relaxed);
+
+    // Readers move to copy 1 before copy 0 is touched
+    atomic_store_explicit(&s_snapshot.seq, seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    memcpy(&s_snapshot.copy[0], sample, sizeof(*sample));
+
+    // And back to copy 0 before copy 1 is touched
+    atomic_store_explicit(&s_snapshot.seq, seq + 2, memory_order_release);
+    atomic_thread_fence(memory_order_release);
+    memcpy(&s_snapshot.copy[1], sample, sizeof(*sample));
+
+    atomic_store_explicit(&s_snapshot_valid, true, memory_order_release);
+}
+
+bool sensor_snapshot_read(bme_sample_t *out) {
+    uint_fast32_t seq;
+
+    if (!atomic_load_explicit(&s_snapshot_valid, memory_order_acquire)) {
+        return false;
+    }
+
+    do {
+        seq = atomic_load_explicit(&s_snapshot.seq, memory_order_acquire);
+        memcpy(out, &s_snapshot.copy[seq & 1], sizeof(*out));
+        atomic_thread_fence(memory_order_acquire);
+    } while (atomic_load_explicit(&s_snapshot.seq, memory_order_relaxed) != seq);
+
+    return true;
+}
@@ -0,0 +1,28 @@
+#ifndef SENSOR_SNAPSHOT_H
+#define SENSOR_SNAPSHOT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "sensor.h"
+
+// One compensated BME690 measurement
+typedef struct {
+    int64_t timestamp_us;       // esp_timer time the data was read
+    uint32_t seq;               // Increments per published sample
+    int8_t heater_step;         // Heater profile step, -1 for forced TPH-only samples
+    uint8_t status;             // STATUS_GAS_VALID / STATUS_HEAT_STAB, gas is usable with both
+    bme_reading_t reading;
+} bme_sample_t;
+
+// --- Latest-sample snapshot ---
+// Single writer (the acquisition task), any number of readers on either core.
+// Readers never block and never wait for the writer, they retry only if a new
+// sample lands while they copy.
+
+// Publishes a sample, must only be called from one task
+void sensor_snapshot_publish(const bme_sample_t *sample);
+
+// Copies the latest consistent sample, false until the first one is published
+bool sensor_snapshot_read(bme_sample_t *out);
+
+#endif // SENSOR_SNAPSHOT_H